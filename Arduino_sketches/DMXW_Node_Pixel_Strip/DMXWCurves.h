@@ -0,0 +1,83 @@
+/* DMXWCurves.h */
+#ifndef DMXWCurves_h
+#define DMXWCurves_h
+
+/*************************************************************************
+ * Output response curves for DMXW node analog (PWM) ports.
+ *
+ * Each table maps a DMX-512 value (0..255) to a PWM value (0..255) and is
+ * stored in flash. The tables were generated offline (256 entries each)
+ * from the following formulas, with v = DMX-512 value / 255:
+ *   curveLogTable   - floor(a * exp(b * v) + 0.5) - 1,
+ *                       a = 9.7758463166360387E-01,
+ *                       b = 5.5498961535023345E-00
+ *                     (the original linearLedValue() curve)
+ *   curveGammaTable - round(255 * v^2.2)
+ *   curveSTable     - round(255 * v^2 * (3 - 2v))   (smoothstep)
+ * CURVE_LINEAR needs no table and CURVE_USER is held in EEPROM.
+ *************************************************************************/
+
+#include <avr/pgmspace.h>
+#include "DMXWNet.h"
+
+const Uint8 curveLogTable[256] PROGMEM =
+{
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  //   0
+    0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,  //  16
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,  //  32
+    2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,   3,  //  48
+    3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   4,   4,   4,   4,  //  64
+    5,   5,   5,   5,   5,   5,   5,   5,   6,   6,   6,   6,   6,   6,   7,   7,  //  80
+    7,   7,   7,   7,   8,   8,   8,   8,   8,   9,   9,   9,   9,   9,  10,  10,  //  96
+   10,  10,  11,  11,  11,  11,  12,  12,  12,  13,  13,  13,  14,  14,  14,  15,  // 112
+   15,  15,  16,  16,  16,  17,  17,  17,  18,  18,  19,  19,  20,  20,  20,  21,  // 128
+   21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,  29,  30,  // 144
+   31,  32,  32,  33,  34,  34,  35,  36,  37,  38,  39,  39,  40,  41,  42,  43,  // 160
+   44,  45,  46,  47,  48,  49,  50,  51,  53,  54,  55,  56,  57,  59,  60,  61,  // 176
+   63,  64,  66,  67,  69,  70,  72,  73,  75,  77,  78,  80,  82,  84,  86,  87,  // 192
+   89,  91,  93,  96,  98, 100, 102, 104, 107, 109, 111, 114, 116, 119, 122, 124,  // 208
+  127, 130, 133, 136, 139, 142, 145, 148, 151, 155, 158, 162, 165, 169, 173, 177,  // 224
+  180, 184, 188, 193, 197, 201, 206, 210, 215, 220, 225, 229, 235, 240, 245, 250   // 240
+};
+
+const Uint8 curveGammaTable[256] PROGMEM =
+{
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,  //   0
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,  //  16
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,  //  32
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,  //  48
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,  //  64
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,  //  80
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,  //  96
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,  // 112
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,  // 128
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,  // 144
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,  // 160
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,  // 176
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,  // 192
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,  // 208
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,  // 224
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255   // 240
+};
+
+const Uint8 curveSTable[256] PROGMEM =
+{
+    0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   2,   2,   2,   3,  //   0
+    3,   3,   4,   4,   4,   5,   5,   6,   6,   7,   7,   8,   9,   9,  10,  10,  //  16
+   11,  12,  12,  13,  14,  15,  15,  16,  17,  18,  18,  19,  20,  21,  22,  23,  //  32
+   24,  25,  26,  27,  27,  28,  29,  30,  31,  33,  34,  35,  36,  37,  38,  39,  //  48
+   40,  41,  42,  44,  45,  46,  47,  48,  50,  51,  52,  53,  54,  56,  57,  58,  //  64
+   60,  61,  62,  63,  65,  66,  67,  69,  70,  72,  73,  74,  76,  77,  78,  80,  //  80
+   81,  83,  84,  85,  87,  88,  90,  91,  93,  94,  96,  97,  98, 100, 101, 103,  //  96
+  104, 106, 107, 109, 110, 112, 113, 115, 116, 118, 119, 121, 122, 124, 125, 127,  // 112
+  128, 130, 131, 133, 134, 136, 137, 139, 140, 142, 143, 145, 146, 148, 149, 151,  // 128
+  152, 154, 155, 157, 158, 159, 161, 162, 164, 165, 167, 168, 170, 171, 172, 174,  // 144
+  175, 177, 178, 179, 181, 182, 183, 185, 186, 188, 189, 190, 192, 193, 194, 195,  // 160
+  197, 198, 199, 201, 202, 203, 204, 205, 207, 208, 209, 210, 211, 213, 214, 215,  // 176
+  216, 217, 218, 219, 220, 221, 222, 224, 225, 226, 227, 228, 228, 229, 230, 231,  // 192
+  232, 233, 234, 235, 236, 237, 237, 238, 239, 240, 240, 241, 242, 243, 243, 244,  // 208
+  245, 245, 246, 246, 247, 248, 248, 249, 249, 250, 250, 251, 251, 251, 252, 252,  // 224
+  252, 253, 253, 253, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255   // 240
+};
+
+#endif
@@ -23,7 +23,8 @@
  * Port Definitions:
  * ----------------
  *
- *   Port 1  - Delay (in milliseconds; 0=LEDs off; 255=hold current settings)
+ *   Port 1  - Delay (milliseconds per effect step; 0=LEDs off; 255=hold
+ *             current settings)
  *   Port 2  - Effect:
  *               (Decade bands are used in order to ease manual config via
  *                potentiometers (e.g. on the DMXW Gateway))
@@ -40,6 +41,8 @@
  *   Port 6   - Argument #4
  *   Port 7   - Argument #5
  *   Port 7   - Argument #6
+ *   Port 37  - Brightness (all strip outputs; full brightness if the port
+ *              isn't mapped)
  *   (All other ports are undefined. DMX512 values assigned to those ports are
  *   ignored.)
  *
@@ -86,13 +89,192 @@
  *         0      Firmware Version
  *         1      Node ID (recorded in myNodeId)
  *         2      Mapping data validity (1=valid; 0=invalid)
- *         3      Addressable LED strip frequency (8 = 800 KHz, 4 = 400 KHz)
- *         4      Addressable LED strip LED wiring order (1 = GRB, 2 = RGB)
- *         5      Addressable LED strip length (# controlled tricolour
- *                  LED elements)
+ *         3      Addressable LED strip control pin
+ *         4      Addressable LED strip frequency (8 = 800 KHz, 4 = 400 KHz)
+ *         5      Addressable LED strip LED wiring order (1 = GRB, 2 = RGB)
+ *       6 - 7    Addressable LED strip length (# controlled tricolour
+ *                  LED elements; low byte first)
+ *       8 - 9    Segment map logical length (0 = no segment map; low
+ *                  byte first)
+ *        10      Segment map repeat count (0 = as many as fit)
+ *        11      Segment map flags (SEG_MIRROR, SEG_REVERSE)
+ *     12 - 20    Strip outputs 2 - 4: control pin, then length (low byte
+ *                  first), for each
+ *     21 - 22    Power budget (mA; 0 = no limit; low byte first)
+ *        23      Current (mA) per LED colour channel at full level
  *   Arduino Serial Monitor settings for console I/O:
  *     - 9600 baud
  *     - "Carriage return" as line ending
+ *   Telemetry (CMD_TREQ):
+ *     - The gateway polls each node in turn for its supply voltage
+ *       (measured against the internal bandgap), the mean and weakest
+ *       RSSI of gateway packets, run frames received and missed, and its
+ *       longest loop() pass (which includes the strip effect updates).
+ *       The record is returned in the ACK.
+ *   Strip updates:
+ *     - strip->show() disables interrupts for ~30us per LED, long enough
+ *       to miss a radio packet. The effects only modify the pixel data
+ *       (through stripSetPixel(), which notes whether a pixel actually
+ *       changed), and loop() sends a frame to the strip only when its
+ *       pixel data changed. A static state (e.g. effects off) is
+ *       rendered once.
+ *     - The serial "loop" command shows the loop() rate and the rate
+ *       and duration of show() calls.
+ *     - The rainbow effects look their colours up in a colour wheel table
+ *       in flash (PixelWheel.h) and write them straight into the strip's
+ *       pixel buffer, in its wire order.
+ *   Effect engine:
+ *     - The effects are listed in fxTable[] (in flash): each entry has the
+ *       effect's render function, its step rate and name. An effect keeps
+ *       its state in its output's StripOut_t, not in static variables.
+ *     - An effect's step count is derived from the time since it started
+ *       (fxClock(); [Delay] ms per step, or [Delay]/4 for Theatre Chase
+ *       Rainbow, in 24.8 fixed point), and the render function draws the
+ *       frame for the current step. If loop() falls behind (e.g. a long
+ *       strip's show(), or several outputs), steps are skipped rather
+ *       than the effect slowing down: Colour Wipe and Water and Embers
+ *       catch up on the LEDs due, and the others jump to the step's frame.
+ *     - A frame is only rendered when the step changes. A [Delay] change
+ *       carries on from the current step at the new speed.
+ *     - Render budget: the render and show() time of each output's frames
+ *       is measured, and the output's frame interval is stretched so that
+ *       the frames of all the outputs leave at least FX_RADIO_DUTY_PCT of
+ *       the time to the radio. (The effects keep their speed; they just
+ *       skip more steps.) An effect catching up on several steps stops
+ *       once its frame has taken FX_RENDER_BUDGET_US.
+ *     - The serial "loop" command shows the effect frame rate, the frames
+ *       over budget, and each output's frame cost and interval.
+ *     - Tools/PixelFxRender builds this sketch on a Linux host, to render
+ *       the effects to images and time them without a node. (Keep
+ *       function definitions in the form its prototype generator expects:
+ *       return type at the start of the line, brace on the next.)
+ *   Pixel streaming (CMD_PIX):
+ *     - The gateway can stream a block of DMX-512 channels to the node as
+ *       frames of pixel data (see the gateway's "pix" command). Strip
+ *       output 1 then shows the streamed pixels in place of its effect,
+ *       until no page has arrived for PIX_TIMEOUT_MS.
+ *     - Each page's pixels are written straight into the strip's pixel
+ *       buffer (through the segment map), and the frame is shown after its
+ *       last page, in the next quiet time on the radio. A lost page just
+ *       leaves those pixels as they were.
+ *     - With the palette framebuffer, the pixels are kept as 3-3-2
+ *       colours.
+ *     - The serial "loop" command shows the pages, frames and pixels per
+ *       second received, and the frames that had pages lost.
+ *   Effect timebase:
+ *     - The gateway's run frames carry its millis() count (after the
+ *       schedule trailer), and the effects run on a copy of the gateway's
+ *       clock (tbNow()) rather than the node's own millis(): a phase and
+ *       frequency locked loop (tbRunFrame()) pulls it in a little with
+ *       every run frame, and keeps it running at the learned rate across
+ *       lost frames. Effect changes take effect at the time of the run
+ *       frame that carried them. So nodes running the same effect at the
+ *       same [Delay] stay in step with each other.
+ *     - The first timebase received (or a jump, e.g. after the gateway
+ *       restarts) steps the clock, and restarts the effects.
+ *     - The serial "loop" command shows whether the timebase is locked,
+ *       the drift it corrects for, and how often it was stepped.
+ *   Palette framebuffer (PALETTE_FB_ENABLED):
+ *     - An 800 KHz strip is rendered into a framebuffer of one palette
+ *       index per pixel, rather than the library's 3 bytes per pixel, and
+ *       palShow() expands the indices to colours while streaming them to
+ *       the strip. The same RAM then drives a strip 3 times as long (up
+ *       to STRIP_MAX_LEN LEDs).
+ *     - Index 0 is black. The rainbow effects use the other indices as
+ *       colour wheel positions (PixelWheel.h; wheel position 0 is the
+ *       same colour as 255). The other effects use a palette of
+ *       PAL_RAM_LEN colours in RAM. Water and Embers fills the palette
+ *       with colours from its ranges when it starts (or its parameters
+ *       change) and gives each LED the nearest one, so that lit LEDs keep
+ *       their colour.
+ *     - palShow() is cycle-counted for a 16 MHz CPU. 400 KHz strips are
+ *       still driven through the library.
+ *   Output stage (brightness, gamma and dithering):
+ *     - Each colour value is gamma corrected (PixelGamma.h, in flash) and
+ *       scaled by the node's brightness (port PIXEL_PORT_BRIGHTNESS) in
+ *       8.8 fixed point, and the fraction is dithered over successive
+ *       frames: it's rounded up when it's above a threshold that runs
+ *       through 16 evenly spaced levels from frame to frame (offset from
+ *       pixel to pixel). So a slow fade at a low level steps smoothly
+ *       rather than in visible jumps of one level.
+ *     - This is done as the pixel is written (stripSetPixel(),
+ *       pixSetWheel(), pixSetRgb()), or, with the palette framebuffer, as
+ *       palShow() expands it; there is no extra pass over the pixels.
+ *     - Dithering in time needs the frame re-shown at a steady rate, each
+ *       pixel at its next dither level, whether or not the effect has
+ *       moved on. Only the palette framebuffer is expanded afresh by
+ *       every show(): a lit frame is re-shown every DITHER_US, in the
+ *       show windows, if its show() takes at most DITHER_MAX_SHOW_US
+ *       (outDithers()). Otherwise (and in the library's pixel buffer) the
+ *       fraction is rounded to the nearest level, so that pixels don't
+ *       flicker at the effect's step rate.
+ *   Power limiter (serial "ledPwr" command):
+ *     - For a battery-powered node, the current drawn by the strips is
+ *       estimated from the sum of their colour channel levels (each
+ *       output's levelSum), at pwrMaPerChan mA per channel at full level.
+ *       It is kept up to date as pixels are written. In the palette
+ *       framebuffer it's the sum of its indices' colours at full scale
+ *       (palLevels()), which the output stage's scale is applied to; it's
+ *       recounted when the colours the indices stand for change.
+ *     - Before a round of show()s, if the estimate for all the outputs
+ *       exceeds the budget (pwrBudget mA), every output's frame is scaled
+ *       down by the one factor that makes the total fit it, in 8.8 fixed
+ *       point (pwrLimit()): the library's pixel buffers in place, before
+ *       any of them is shown. The output stage then applies the same
+ *       scale (pwrScale) to the pixels written after it, and to the
+ *       whole frame as palShow() expands it.
+ *     - The scale is eased back up, a step every PWR_RISE_MS whether or
+ *       not any frame has changed (pwrEase()), as long as the estimate
+ *       stays within the budget. The palette framebuffers are resent at
+ *       each step; the library's pixel buffers, scaled in place, recover
+ *       as their pixels are rewritten.
+ *     - The serial "loop" command shows the estimated current, the
+ *       limiter scale and the frames limited.
+ *   Strip outputs (serial "ledOut" command):
+ *     - Up to MAX_STRIP_OUTPUTS strips, each on its own pin, run their own
+ *       effects. Output s is controlled by its own block of
+ *       PIXEL_BLOCK_PORTS ports (ports 1 - 9 for output 1, 10 - 18 for
+ *       output 2, ...). Output 1 is the strip set up with "led" and
+ *       "ledCtrl"; the first unconfigured output (length 0) ends the list.
+ *     - The outputs share the strip frequency, colour wiring and segment
+ *       map, and each has its own pixel buffer (or palette framebuffer),
+ *       palette and effect state.
+ *     - Changed frames are sent round robin, each subject to the show()
+ *       scheduling below. While run frames arrive, at most SHOW_BUDGET_US
+ *       of show() time (with interrupts off) is spent per run frame period;
+ *       the other outputs wait for the next gap. (An output that can't
+ *       fit in the budget on its own is still shown, alone.)
+ *   Segment map (serial "ledSeg" command):
+ *     - The effects render only the segment's logical pixels (numPix),
+ *       and the output stage repeats them along the strip: palShow()
+ *       replicates the framebuffer while streaming it, and in the
+ *       library's pixel buffer each pixel write is copied to every
+ *       repeat. With the palette framebuffer, only the logical pixels
+ *       take RAM.
+ *     - Every other repeat is mirrored if SEG_MIRROR (e.g. a rainbow
+ *       running out from the middle of the strip), and the whole run is
+ *       reversed if SEG_REVERSE (e.g. for a strip fed from its far end).
+ *       LEDs past the last whole repeat stay dark.
+ *     - For a 12V strip, the logical pixels are WS2811 drivers (3 LEDs
+ *       each), as for the strip length.
+ *   Radio-aware show() scheduling:
+ *     - The node learns the gateway's run frame period from the arrival
+ *       times of CMD_RUN frames (seeded from the frame's schedule
+ *       trailer), and holds a changed frame back until the quiet gap
+ *       after a run frame: it's only sent if show() will be done
+ *       SHOW_GUARD_US before the next run frame is due. After a run
+ *       frame flagged with DMXW_HDR_POLL, the node also waits for the
+ *       telemetry poll (or SHOW_POLL_WAIT_US) to go by.
+ *     - The effects keep running while a frame is held back; the strip
+ *       just shows their latest state in the next gap.
+ *     - A strip too long for show() to fit in a gap is shown at the start
+ *       of every other gap instead, so that at most every second run
+ *       frame is lost.
+ *     - Without run frames (for SHOW_IDLE_MS), frames are shown at once.
+ *     - The serial "loop" command also shows the run frames received,
+ *       those missed (the telemetry's count, since its last report), the
+ *       learned period, and the frames held back and shown across a run
+ *       frame.
  *   LED strip wiring:
  *     The LED strips typically require a 5 Vdc signal voltage on the
  *     digital output control pin (ledStripCtrlPin). You should be able to get
@@ -156,18 +338,22 @@
 #include <RFM69.h>
 #include <SPI.h>
 #include "DMXWNet.h"
+#include "DMXWCurves.h"
+#include "PixelWheel.h"
+#include "PixelGamma.h"
 #include <avr/pgmspace.h>
 #include <EEPROM.h>
 #include <Adafruit_NeoPixel.h>
 
 #define COPYRIGHT     "(C)2020, A.J. van Schouwen"
 #define SW_VERSION_c  "1.1 (2020-03-13)"
-#define FW_VERSION_c  7   // Increment (with wraparound) for new F/W;
+#define FW_VERSION_c  12  // Increment (with wraparound) for new F/W;
                           //   clears EEPROM.
 
 //#define DEBUG_ON            // Uncomment to turn off debug output to serial port.
 #define LOGGING_ON          // Uncomment to turn off packet logging to serial port.
 #define SERIAL_CMDS_ENABLED // Enables command line at serial port
+//#define PALETTE_FB_ENABLED  // 1 byte/pixel framebuffer for 800 KHz strips
 
 #define PIN_LOCATE    9   // Pin number of digital port connected to
                           // onboard LED (for location purposes)
@@ -175,6 +361,7 @@
                           // (overidden by ledStripCtrlPin)
 
 #define MAX_SERIAL_BUF_LEN  20
+#define TXBUF_LEN  (RF69_MAX_DATA_LEN - DMXW_HDR_LEN)  // Max TX payload
 #define EEPROM_FW_ADDR             0
 #define EEPROM_NODEID_ADDR         1
 #define EEPROM_VALIDITY_ADDR       2
@@ -182,7 +369,28 @@
 #define EEPROM_STRIP_FREQ_ADDR     4
 #define EEPROM_STRIP_WIRING_ADDR   5
 #define EEPROM_STRIP_LEN_ADDR      6
-#define EEPROM_FIRST_OPEN_ADDR     7
+#define EEPROM_STRIP_LEN_HI_ADDR   7
+#define EEPROM_SEG_LEN_ADDR        8
+#define EEPROM_SEG_LEN_HI_ADDR     9
+#define EEPROM_SEG_REPEAT_ADDR    10
+#define EEPROM_SEG_FLAGS_ADDR     11
+#define EEPROM_OUT_ADDR           12   // Outputs 2.. (pin, len low, len high)
+#define EEPROM_OUT_REC_LEN         3
+#define EEPROM_PWR_BUDGET_ADDR \
+          (EEPROM_OUT_ADDR + (MAX_STRIP_OUTPUTS - 1) * EEPROM_OUT_REC_LEN)
+#define EEPROM_PWR_BUDGET_HI_ADDR (EEPROM_PWR_BUDGET_ADDR + 1)
+#define EEPROM_PWR_MA_ADDR        (EEPROM_PWR_BUDGET_ADDR + 2)
+#define EEPROM_FIRST_OPEN_ADDR    (EEPROM_PWR_BUDGET_ADDR + 3)
+
+#define STRIP_MAX_LEN_RGB        255   // Max LEDs in the library's buffer
+#ifdef PALETTE_FB_ENABLED
+  #define STRIP_MAX_LEN  (3 * STRIP_MAX_LEN_RGB)  // Palette framebuffer
+#else
+  #define STRIP_MAX_LEN  STRIP_MAX_LEN_RGB
+#endif
+#define PAL_RAM_LEN               16   // # of colours in palette[] (power of 2)
+#define PAL_LATCH_US              50   // Low time for the strip to latch
+#define NUM_PIXEL_PORTS  MAX_NODE_PORTS  // Port blocks, and Brightness
 
 #define SERIAL_BAUD                4800
 
@@ -210,8 +418,6 @@
 #endif
 
 
-Adafruit_NeoPixel *strip;
-
 // IMPORTANT [Adafruit note]: To reduce NeoPixel burnout risk, add 1000 uF
 // capacitor across pixel power leads, add 300 - 500 Ohm resistor on first
 // pixel's data input and minimize distance between Arduino and first pixel.
@@ -231,34 +437,60 @@ Uint8   srcNodeId;
 bool    resetEeprom = false;
 bool    handleInput = false;
 bool    ackRequested = false;
+Uint8   rxHdr = 0;          // Header of the packet being handled
+Uint8   lastGwSeq = 0xFF;   // Seq # of the last packet handled from gateway
+AckCode_t lastAckCode = ACK_NULL;  // ... and the ACK code it got
+Uint8   lastAckLen = 1;     // ... and the length of that ACK
+Uint8   txSeq = 0;          // Sequence # of the next packet sent
 bool    dataToSend = false;
 bool    requestAck = true;
 bool    saveMappings = false;
 Uint8   currReadPos = 0;
 Uint8   command = 0;
-Uint8   buffer[RF69_MAX_DATA_LEN];
-Uint8   ackBuf[1];
+// Received packets are decoded in place, through rxBuf, straight out of
+// the radio's receive buffer. (It isn't touched again until the next
+// receiveDone() or send.) Outgoing packets are built in buffer[], which
+// is preceded by DMXW_HDR_LEN bytes of headroom for sendBuffer()'s header.
+const Uint8 *rxBuf = NULL;
+Uint8   rxSize = 0;
+Uint8   txPkt[RF69_MAX_DATA_LEN];
+Uint8 * const buffer = &txPkt[DMXW_HDR_LEN];
+Uint8   ackBuf[1 + TELEM_LEN];  // ACK code, plus telemetry for CMD_TREQ
+Uint8   ackLen = 1;
 Uint8   bufSize = 0;
 char    serialBuffer[MAX_SERIAL_BUF_LEN];
 Uint8   serialBufSize = 0;
 Uint8   serialPos = 0;
 long    rxTime = 0;
 long    ackTime = 0;
+
+// Telemetry reported to the gateway (CMD_TREQ). Reset after each report.
+#define TELEM_IDLE_MS  5000  // Longer run frame gaps: gateway idle, not loss
+typedef struct telemetry_t {
+  unsigned long  rssiTotal;     // Sum of gateway packet RSSIs (-dBm)
+  Uint16         rssiCount;     // # of RSSIs summed
+  Uint8          rssiWorst;     // Weakest gateway packet RSSI (-dBm)
+  unsigned long  frames;        // Run frames received
+  unsigned long  missed;        // Run frames missed (gaps in the cadence)
+  unsigned long  loopMax;       // Longest loop() pass (us)
+  unsigned long  lastRun;       // millis() of the last run frame
+} Telemetry_t;
+Telemetry_t telem;
 bool    nodeIdValid = false;
 unsigned long rxCount = 0;
 Uint8   resetCount;
 Uint16  badAddr = 0;
-long    nextFxTime = 0;
 long    currentTime = 0;
 
 
-// Port to I/O pin mapping
-NodePortMapRecord_t portMap[MAX_PORTS] =
+// Port to I/O pin mapping of a strip output's block of ports (constant;
+// kept in flash--use the portXxx() accessors below to read it)
+const NodePortMapRecord_t portMap[PIXEL_BLOCK_PORTS] PROGMEM =
 {
   //JVS: Pins are now disconnected from nodeMap[]--i.e. no direct DMXW control
   //     Control the LED strip parameters through the DMXW ports
-  //     Below, the outPin assignments are the default (NEO_PIN); these
-  //     get altered in EepromLoad().
+  //     Below, the outPin assignments are the default (NEO_PIN); the ports
+  //     actually use their strip output's control pin (see portOutPin()).
   //
   //         conflict   is
   //{ outPin,  Port,  Analog, name}
@@ -277,27 +509,200 @@ NodePortMapRecord_t portMap[MAX_PORTS] =
     { NEO_PIN,   -1,   false, "Arg #5" }, // Port 7   - Argument #5
     { NEO_PIN,   -1,   false, "Arg #6" }, // Port 8   - Argument #6
     { NEO_PIN,   -1,   false, "Arg #7" }, // Port 9   - Argument #7
-    { NEO_PIN,   -1,   false, " -"     }, // Port 10
-    { NEO_PIN,   -1,   false, " -"     }, // Port 11
-    { NEO_PIN,   -1,   false, " -"     }, // Port 12
-    { NEO_PIN,   -1,   false, " -"     }, // Port 13
-    { NEO_PIN,   -1,   false, " -"     }, // Port 14
-    { NEO_PIN,   -1,   false, " -"     }, // Port 15
-    { NEO_PIN,   -1,   false, " -"     }, // Port 16
 };
 
-const Uint8 stripLastPortNum = 9; // Last port # actually used above
 
-
-// LED strip parameters
-Uint8   stripDelay, stripEffect;
-Uint8   stripArg1, stripArg2, stripArg3, stripArg4;
-Uint8   stripArg5, stripArg6, stripArg7;
-Uint8   oldStripEffect = 0;
-bool    stripParamChange = false;
-bool    newEffect = false;
-bool    disableEffects = false;
 Uint8   ledStripFlags;
+bool    disableEffects = false;
+
+// Offsets of the red, green and blue bytes of a pixel in the strip's pixel
+// buffer (its wire order), found by probing the strip in setup(). Used by
+// the effects that write straight into the buffer.
+Uint8   pixOffsRed = 0;
+Uint8   pixOffsGreen = 1;
+Uint8   pixOffsBlue = 2;
+
+// Output stage: brightness scale (0..256) of the colour levels, from the
+// Brightness port, and the dither thresholds the fraction of a level is
+// compared with, spread evenly over 16 frames.
+Uint16  outScale = 256;
+#define DITHER_US          16000  // Dither step period (re-shown frames)
+#define DITHER_MAX_SHOW_US  4000  // Longest show() dithered in time
+const Uint8 ditherTable[16] PROGMEM =
+{
+    8, 136,  72, 200,  40, 168, 104, 232,
+   24, 152,  88, 216,  56, 184, 120, 248
+};
+
+// Power limiter (serial "ledPwr" command)
+#define PWR_MA_PER_CHAN   20    // Default mA per colour channel at full level
+#define PWR_MAX_BUDGET 20000    // Max budget (mA)
+#define PWR_RISE           2    // Limiter scale eased up by this ...
+#define PWR_RISE_MS       20    //   ... every this many ms
+Uint16  pwrBudget = 0;          // Current budget (mA) of all the outputs
+                                //   (0 = no limit)
+Uint8   pwrMaPerChan = PWR_MA_PER_CHAN;
+Uint16  pwrScale = 256;         // Limiter scale (0..256) of all the levels
+unsigned long pwrLimited = 0;   // Rounds of frames scaled down to fit
+
+// A strip output: its strip, its effect and the pixels it renders.
+typedef struct stripOut_t {
+  Adafruit_NeoPixel *strip;
+  Int8    pin;                  // Control pin
+
+  // Effect parameters, from the output's block of ports
+  Uint8   stripDelay, stripEffect;
+  Uint8   stripArg1, stripArg2, stripArg3, stripArg4;
+  Uint8   stripArg5, stripArg6, stripArg7;
+  Uint8   oldStripEffect;
+  bool    stripParamChange;
+  bool    newEffect;
+
+  // Effect timebase (see fxClock()): the effect is at step fxStep, having
+  // been at step fxBase + fxFrac/256 at time fxStart.
+  unsigned long fxStart;        // millis() at the last rebase
+  unsigned long fxBase;         // Whole steps at fxStart
+  Uint8   fxFrac;               // Fraction of a step at fxStart (/256)
+  unsigned long fxStep;         // Current step
+  unsigned long fxLastStep;     // Step last rendered
+
+  // Adaptive frame rate (see fxFrameDone())
+  unsigned long fxLastFrame;    // millis() when the last frame was rendered
+  unsigned long fxCost;         // Render + show() time (us) of a frame
+  Uint16  fxInterval;           // Min time (ms) between frames
+
+  // Frame-dirty tracking. stripShow() only sends a frame to the strip
+  // when the pixel data changed since the last one.
+  bool    stripDirty;           // Pixel data changed since the last show()
+  bool    stripBlank;           // Strip blanked while effects are off?
+
+  // Pixels rendered by the effects, and the palette framebuffer (1 palette
+  // index per pixel) they're rendered into instead of the library's pixel
+  // buffer, if PALETTE_FB_ENABLED (else NULL). Index 0 is black; the
+  // others are colour wheel positions if palWheel, else palette[] entries
+  // (or, while pixels are streamed in, 3-3-2 colours).
+  Uint16  numPix;
+  Uint8  *palFb;
+  bool    palWheel;
+  bool    palRgb;               // Indices are r:3 g:3 b:2 colours (CMD_PIX)?
+  Uint8   palette[PAL_RAM_LEN][3];   // { r, g, b }; entry 0 is black
+  unsigned long palLatchTime;        // micros() at the end of palShow()
+  Uint8   ditherFrame;          // Output stage dither step (see outLevel())
+
+  // Power limiter (see pwrLimit())
+  unsigned long levelSum;       // Sum of the frame's colour channel levels
+                                //   (palette framebuffer: at full scale)
+  bool    levelStale;           // Recount the palette framebuffer's levels?
+  Uint16  scale;                // Output stage scale: brightness x limiter
+
+  // Segment map in use (see segConfigure()): the strip's stripPix pixels
+  // show segCopies repeats of the numPix logical pixels, which span
+  // segSpan pixels from the start of the strip.
+  Uint16  stripPix;
+  Uint8   segCopies;
+  Uint16  segSpan;
+
+  // show() scheduling (see showWindowOpen())
+  unsigned long showTime;       // Longest show() measured
+  unsigned long showLast;       // Last show() time (us)
+  unsigned long lastShowFrame;  // showWin.frames when show() was last called
+  bool    waiting;              // Is a frame being held back?
+
+  union {                       // State of the running effect
+    struct { uint16_t i, j, numSimultaneous; long delayEnd;
+             bool newIteration; Uint8 phase; }                twinkle;
+    struct { int16_t r, g, b, led, level, changeCount;
+             Uint8 idx; int8_t levelDirection;
+             Uint8 palArgs; }                                 water;
+    struct { uint16_t i; Uint8 idx; }                         wipe;
+  } fx;
+} StripOut_t;
+
+StripOut_t *outs[MAX_STRIP_OUTPUTS];  // Strip outputs (calloc'd in setup())
+Uint8   numOuts = 0;
+StripOut_t *so = NULL;                 // Output being rendered or shown
+
+// Effect registry (fxTable[], in flash), indexed by effect number.
+#define NUM_STRIP_FX     9
+#define FX_NAME_LEN     22
+#define FX_REBASE_MS    60000UL  // Max time between effect clock rebases
+#define FX_RENDER_BUDGET_US  4000  // Max time to render a frame
+#define FX_RADIO_DUTY_PCT      50  // Min share of time left to the radio
+#define FX_MAX_INTERVAL_MS   1000  // Longest (stretched) frame interval
+
+typedef void (*FxRender_t)(unsigned long now);
+
+typedef struct fxDef_t {
+  FxRender_t render;            // Renders so's frame at time now (or NULL)
+  Uint8   rate;                 // Steps per [Delay] ms
+  bool    restart;              // Restart on any parameter change?
+  char    name[FX_NAME_LEN];
+} FxDef_t;
+
+// Radio-aware show() scheduling. Times are micros().
+#define SHOW_GUARD_US       2000  // Margin to leave before the next run frame
+#define SHOW_POLL_WAIT_US   6000  // Max wait for the poll after a POLL frame
+#define SHOW_IDLE_MS        1000  // Show at once after this long w/o frames
+#define SHOW_US_PER_LED       30  // show() time per LED, until measured
+#define SHOW_BUDGET_US      8000  // Max show() time per run frame period
+typedef struct showWindow_t {
+  unsigned long  lastRun;       // Arrival of the last run frame
+  unsigned long  period;        // Learned run frame period (0 = unknown)
+  unsigned long  holdOff;       // No show() until this long after lastRun
+  unsigned long  frames;        // Run frames received
+  unsigned long  budgetUsed;    // show() time (us) since the last run frame
+  unsigned long  deferred;      // Frames held back for a gap
+  unsigned long  overlaps;      // Frames shown across a run frame
+} ShowWindow_t;
+ShowWindow_t showWin;
+
+// Gateway timebase: an estimate of the gateway's millis() clock, locked to
+// the timebase in its run frames (see tbRunFrame()), that the effects run
+// on. Until the first timebase arrives, it's our own millis().
+#define TB_SLEW_MS         100  // Larger errors step the timebase
+#define TB_COAST_MS      10000  // Max time to extrapolate the drift over
+#define TB_MAX_DRIFT     16777  // Max drift correction (1000 ppm)
+
+typedef struct timebase_t {
+  unsigned long  offset;        // Gateway time - millis(), whole ms
+  long           frac;          // ... plus frac/256 ms (0 - 255)
+  long           drift;         // Gateway ms gained per local ms (x 2^24)
+  unsigned long  lastLocal;     // millis() at the last timebase received
+  unsigned long  frameTime;     // Gateway time of the last run frame
+  bool           locked;        // Timebase received?
+  unsigned long  steps;         // Times the timebase was stepped
+} Timebase_t;
+Timebase_t tb;
+
+// Pixel streaming (CMD_PIX): frames of pixels sent by the gateway, shown
+// on strip output 1 in place of its effect.
+#define PIX_TIMEOUT_MS  1000  // Effect resumes this long after the last page
+
+typedef struct pixStream_t {
+  bool           active;        // Streaming (effect suspended)?
+  unsigned long  lastPage;      // millis() when the last page arrived
+  Uint16         pagesSeen;     // Pages received of the current frame
+  unsigned long  pages;         // Pages received ...
+  unsigned long  frames;        // ... frames shown ...
+  unsigned long  partial;       // ... of which some pages were lost ...
+  unsigned long  pixels;        // ... and pixels received
+} PixStream_t;
+PixStream_t pixStream;
+
+// Expand the colours of a r:3 g:3 b:2 pixel to 8 bits
+#define pixRgb332Red(v)    ( ((v) & 0xE0) | (((v) >> 3) & 0x1C) | ((v) >> 6) )
+#define pixRgb332Green(v)  ( (((v) << 3) & 0xE0) | ((v) & 0x1C) | \
+                             (((v) >> 3) & 0x03) )
+#define pixRgb332Blue(v)   ( ((v) & 0x03) * 0x55 )
+
+// Loop and strip update statistics (serial "loop" command)
+unsigned long loopCount = 0;    // # of loop() passes
+unsigned long showCount = 0;    // # of strip->show() calls
+unsigned long showTotal = 0;    // Time (us) spent in strip->show()
+unsigned long statsStart = 0;   // millis() at stats reset
+unsigned long fxFrames = 0;     // # of effect frames rendered
+unsigned long fxOverruns = 0;   // # of frames over FX_RENDER_BUDGET_US
+unsigned long fxRenderStart;    // micros() at the start of the current frame
 
 // LED strip configuration settings
 Int8   ledStripCtrlPin;  // Configured output pin for LED strip control
@@ -313,19 +718,24 @@ Uint8   ledStripWiring;  // Configured LED strip colour wiring order
   //     JVS: On the 12V strip that I have, change the colour order in functions
   //          calls from R/G/B to R/B/G
 
-Uint8   ledStripLen;     // # of LED triplets (12V strip has 3 tricolour
+Uint16  ledStripLen;     // # of LED triplets (12V strip has 3 tricolour
                          //   LEDs per WS2811 driver). So the LEDs, in this
                          //   configuration, aren't really individually
                          //   addressable.
-                        
-
-// Array, indexed by port # (0 = port #1), mapping port # to DMXW channel #.
-Uint8 portToDmxwMap[MAX_PORTS];
 
+Int8    ledOutPin[MAX_STRIP_OUTPUTS - 1];  // Outputs 2.. control pins
+Uint16  ledOutLen[MAX_STRIP_OUTPUTS - 1];  //   and lengths (0 = unused)
 
+Uint16  segLen;          // Segment map: logical length (0 = whole strip)
+Uint8   segRepeat;       //   # of repeats (0 = as many as fit)
+Uint8   segFlags;        //   SEG_xxx flags
+#define SEG_MIRROR   0x01  // Mirror every other repeat
+#define SEG_REVERSE  0x02  // Reverse the whole run
+                        
 
-// List of defined ports indexed by DMXW channel # (-1 = not used; 0 = chan #1)
-DmxwNodeMapRecord_t nodeMap[MAX_DMXW_CHANS];
+// DMXW channel mapping of each port, indexed by port # - 1
+// (dmxwChan 0 = port not mapped)
+DmxwNodeMapRecord_t nodeMap[NUM_PIXEL_PORTS];
 
 Uint8 node;
 
@@ -335,10 +745,52 @@ long lastTime = 0;
 
 
 
+// Accessors for the port table in flash, which describes one output's
+// block of ports. A port's output pin is its strip output's control pin
+// (-1 if the output isn't configured).
+Int8 portOutPin(Uint8 portIdx)
+{
+  Uint8 s = portIdx / PIXEL_BLOCK_PORTS;
+
+  return (s < numOuts) ? outs[s]->pin : -1;
+}
+
+Int8 portConflict(Uint8 portIdx)
+{
+  return (Int8)pgm_read_byte(&portMap[portIdx % PIXEL_BLOCK_PORTS].conflictPort);
+}
+
+bool portIsAnalog(Uint8 portIdx)
+{
+  if (portIdx == PIXEL_PORT_BRIGHTNESS - 1)
+    return true;
+  return pgm_read_byte(&portMap[portIdx % PIXEL_BLOCK_PORTS].isAnalog);
+}
+
+const __FlashStringHelper *portName(Uint8 portIdx)
+{
+  if (portIdx == PIXEL_PORT_BRIGHTNESS - 1)
+    return FLASH("Brightness");
+  return (const __FlashStringHelper *)portMap[portIdx % PIXEL_BLOCK_PORTS].name;
+}
+
+// Value of port index, portIdx (0 if the port isn't mapped).
+Uint8 portValue(Uint8 portIdx)
+{
+  return (nodeMap[portIdx].dmxwChan == 0) ? 0 : nodeMap[portIdx].value;
+}
+
+
+// The EEPROM keeps the mappings in their original format, (port, curve)
+// for each DMXW channel followed by the DMXW channel of each port, so
+// existing configurations load unchanged. They're converted to/from the
+// per-port nodeMap[] here.
 void EepromLoad()
 {
   int addr;
   bool dataIsValid;
+  Int8 port;
+  Uint8 curve;
 
   dataIsValid = EEPROM.read(EEPROM_VALIDITY_ADDR);
   ledStripCtrlPin = NEO_PIN;
@@ -349,50 +801,77 @@ void EepromLoad()
   ledStripCtrlPin = EEPROM.read(EEPROM_STRIP_CTRL_PIN);
   ledStripFreq    = EEPROM.read(EEPROM_STRIP_FREQ_ADDR);
   ledStripWiring  = EEPROM.read(EEPROM_STRIP_WIRING_ADDR);
-  ledStripLen     = EEPROM.read(EEPROM_STRIP_LEN_ADDR);
-      
-  for (Uint8 i = 0; i < MAX_PORTS; i++)
+  ledStripLen     = EEPROM.read(EEPROM_STRIP_LEN_ADDR) |
+                    (EEPROM.read(EEPROM_STRIP_LEN_HI_ADDR) << 8);
+  segLen          = EEPROM.read(EEPROM_SEG_LEN_ADDR) |
+                    (EEPROM.read(EEPROM_SEG_LEN_HI_ADDR) << 8);
+  segRepeat       = EEPROM.read(EEPROM_SEG_REPEAT_ADDR);
+  segFlags        = EEPROM.read(EEPROM_SEG_FLAGS_ADDR);
+  addr = EEPROM_OUT_ADDR;
+  for (Uint8 i = 0; i < MAX_STRIP_OUTPUTS - 1; i++)
   {
-    portMap[i].outPin = ledStripCtrlPin;
-  }
+    ledOutPin[i] = EEPROM.read(addr++);
+    ledOutLen[i] = EEPROM.read(addr++);
+    ledOutLen[i] |= EEPROM.read(addr++) << 8;
+  }
+  pwrBudget       = EEPROM.read(EEPROM_PWR_BUDGET_ADDR) |
+                    (EEPROM.read(EEPROM_PWR_BUDGET_HI_ADDR) << 8);
+  pwrMaPerChan    = EEPROM.read(EEPROM_PWR_MA_ADDR);
+  if (pwrMaPerChan == 0)
+    pwrMaPerChan = PWR_MA_PER_CHAN;
   
   addr = EEPROM_FIRST_OPEN_ADDR;
   for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
   {
-    nodeMap[i].port          = EEPROM.read(addr++);
-    nodeMap[i].isLogarithmic = EEPROM.read(addr++);
-    //nodeMap[i].value       = EEPROM.read(addr++); // Don't store the value
-    nodeMap[i].value         = 0;
-  }
-  
-  for (Uint8 i = 0; i < MAX_PORTS; i++)
-  {
-    portToDmxwMap[i] = EEPROM.read(addr++);
-  }
+    port  = EEPROM.read(addr++);
+    curve = EEPROM.read(addr++);
+    if ( (port <= 0) || (port > NUM_PIXEL_PORTS) )
+      continue;
+    nodeMap[port - 1].dmxwChan = i + 1;
+    nodeMap[port - 1].flags    = curve;
+    nodeMap[port - 1].value    = 0;
+  }
+  // (The trailing port --> DMXW channel table is redundant.)
   pinMode(ledStripCtrlPin, OUTPUT);
 }
 
 void EepromSave()
 {
   const Uint8 dataIsValid = 1;
+  Int8 port;
   int addr;
 
   EEPROM.write(EEPROM_VALIDITY_ADDR,     dataIsValid);
   EEPROM.write(EEPROM_STRIP_CTRL_PIN,    ledStripCtrlPin);
   EEPROM.write(EEPROM_STRIP_FREQ_ADDR,   ledStripFreq);
   EEPROM.write(EEPROM_STRIP_WIRING_ADDR, ledStripWiring);
-  EEPROM.write(EEPROM_STRIP_LEN_ADDR,    ledStripLen);
+  EEPROM.write(EEPROM_STRIP_LEN_ADDR,    ledStripLen & 0xFF);
+  EEPROM.write(EEPROM_STRIP_LEN_HI_ADDR, ledStripLen >> 8);
+  EEPROM.write(EEPROM_SEG_LEN_ADDR,      segLen & 0xFF);
+  EEPROM.write(EEPROM_SEG_LEN_HI_ADDR,   segLen >> 8);
+  EEPROM.write(EEPROM_SEG_REPEAT_ADDR,   segRepeat);
+  EEPROM.write(EEPROM_SEG_FLAGS_ADDR,    segFlags);
+  addr = EEPROM_OUT_ADDR;
+  for (Uint8 i = 0; i < MAX_STRIP_OUTPUTS - 1; i++)
+  {
+    EEPROM.write(addr++, ledOutPin[i]);
+    EEPROM.write(addr++, ledOutLen[i] & 0xFF);
+    EEPROM.write(addr++, ledOutLen[i] >> 8);
+  }
+  EEPROM.write(EEPROM_PWR_BUDGET_ADDR,    pwrBudget & 0xFF);
+  EEPROM.write(EEPROM_PWR_BUDGET_HI_ADDR, pwrBudget >> 8);
+  EEPROM.write(EEPROM_PWR_MA_ADDR,        pwrMaPerChan);
 
   addr = EEPROM_FIRST_OPEN_ADDR;
   for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
   {
-    EEPROM.write(addr++, nodeMap[i].port);
-    EEPROM.write(addr++, nodeMap[i].isLogarithmic);
-    //EEPROM.write(addr++, nodeMap[i].value); // Don't store the value
+    port = findPortByDmxwChan(i + 1);
+    EEPROM.write(addr++, (port == -1) ? -1 : port + 1);
+    EEPROM.write(addr++, (port == -1) ? CURVE_LINEAR : nodeMap[port].flags);
   }
-  for (Uint8 i = 0; i < MAX_PORTS; i++)
+  for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
   {
-    EEPROM.write(addr++, portToDmxwMap[i]);
+    EEPROM.write(addr++, nodeMap[i].dmxwChan);
   }
 }
 
@@ -401,48 +880,43 @@ bool isPortMapValid(Uint8 port)
 {
   Int8 conflictPort;
   
-  if ( (port == 0) || (port > MAX_PORTS) )
+  if ( (port == 0) ||
+       ( (port > numOuts * PIXEL_BLOCK_PORTS) &&
+         (port != PIXEL_PORT_BRIGHTNESS) ) )
   {
     logPrint(FLASH("*** Port # out of range - "));
     logPrintln(port);
     return false;
   }
 
-  // Check for a conflict
-  conflictPort = portMap[port - 1].conflictPort;
+  // Check for a conflict (within the output's block of ports)
+  conflictPort = portConflict(port - 1);
   if (conflictPort != -1)
+    conflictPort += (port - 1) - (port - 1) % PIXEL_BLOCK_PORTS;
+  if ( (conflictPort != -1) && (nodeMap[conflictPort - 1].dmxwChan != 0) )
   {
-    // We have a potential conflict ... but only if both ports are
-    // output ports.
-    for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-    {
-      if (nodeMap[i].port == conflictPort)
-      {
-        logPrint(FLASH("*** DMXW Channel "));
-        logPrint(i+1);
-        logPrint(FLASH(" is mapped to conflicting output port "));
-        logPrintln(conflictPort);
-        return false;
-      }
-    }
+    logPrint(FLASH("*** DMXW Channel "));
+    logPrint(nodeMap[conflictPort - 1].dmxwChan);
+    logPrint(FLASH(" is mapped to conflicting output port "));
+    logPrintln(conflictPort);
+    return false;
   }
   
   // Check for a duplicated port
-  for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-    if (nodeMap[i].port == port)
-    {
-      logPrint(FLASH("*** DMXW Channel "));
-      logPrint(i+1);
-      logPrint(FLASH(" already uses port #"));
-      logPrintln(port);
-      return false;
-    }
+  if (nodeMap[port - 1].dmxwChan != 0)
+  {
+    logPrint(FLASH("*** DMXW Channel "));
+    logPrint(nodeMap[port - 1].dmxwChan);
+    logPrint(FLASH(" already uses port #"));
+    logPrintln(port);
+    return false;
+  }
 
   return true;
 }
 
 
-bool addNodeMap(Uint8 dmxwChan, Uint8 port, bool logarithmic)
+bool addNodeMap(Uint8 dmxwChan, Uint8 port, Uint8 curve)
 {
   DmxwNodeMapRecord_t *tmpMap;
   
@@ -452,35 +926,39 @@ bool addNodeMap(Uint8 dmxwChan, Uint8 port, bool logarithmic)
     logPrintln(dmxwChan);
     return false;
   }
-  dmxwChan--;
   if (!isPortMapValid(port))
     return false;
+  if (curve == CURVE_USER)
+  {
+    // This node doesn't store a user curve (see curveValue()).
+    logPrintln(FLASH("*** User curve not supported"));
+    return false;
+  }
     
-  if (nodeMap[dmxwChan].port != -1)
+  if (findPortByDmxwChan(dmxwChan) != -1)
   {
     logPrint(FLASH("*** DMXW Chan already mapped to port ["));
     logPrint(dmxwChan);
     logPrint(FLASH(" / "));
-    logPrint(port);
+    logPrint(findPortByDmxwChan(dmxwChan) + 1);
     logPrintln(FLASH("]"));
     return false;
   }
   
-  tmpMap = &nodeMap[dmxwChan];
-  tmpMap->port          = port;
-  if (portMap[port-1].isAnalog)
-    tmpMap->isLogarithmic = logarithmic;
+  tmpMap = &nodeMap[port - 1];
+  tmpMap->dmxwChan      = dmxwChan;
+  if (portIsAnalog(port - 1) && (curve < NUM_CURVES))
+    tmpMap->flags = curve;
   else
-    tmpMap->isLogarithmic = 0;
+    tmpMap->flags = CURVE_LINEAR;
   tmpMap->value         = 0;
-  portToDmxwMap[port-1] = dmxwChan + 1;
   
   return true;
 }
 
 bool delNodeMap(Uint8 dmxwChan)
 {
-  Uint8 port;
+  Int8 port;
   
   if ( (dmxwChan == 0) || (dmxwChan > MAX_DMXW_CHANS))
   {
@@ -488,44 +966,46 @@ bool delNodeMap(Uint8 dmxwChan)
     logPrintln(dmxwChan);
     return false;
   }
-  dmxwChan--;
   
-  if (nodeMap[dmxwChan].port == -1)
-  {
+  port = findPortByDmxwChan(dmxwChan);
+  if (port == -1)
     return false;
-  }
-  port = nodeMap[dmxwChan].port;
-  nodeMap[dmxwChan].port = -1;
-  portToDmxwMap[port-1] = 0;
+  nodeMap[port].dmxwChan = 0;
+  nodeMap[port].value    = 0;
+  outBrightness();
   return true;
 }
 
 
-Int8 getPortMapIdxByDmxwChan(int dmxwChan)
+// Returns the index (port # - 1) of the port mapped to DMXW channel,
+// dmxwChan, or -1 if there's none.
+Int8 findPortByDmxwChan(int dmxwChan)
 {
-  Uint8 port;
-  
   if ( (dmxwChan < 1) || (dmxwChan > MAX_DMXW_CHANS))
     return -1;
-  port = nodeMap[dmxwChan - 1].port;
-  if (port == -1)
-    return -1;
-  return (port - 1);
+  for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
+    if (nodeMap[i].dmxwChan == dmxwChan)
+      return i;
+  return -1;
 }
 
 
-// Returns an adjusted PWM value (0..255) that provides a provides a
-// perceived linear LED brightness relationship relative to the
-// linearity assumed by lighting consoles generating DMX values in
-// the range 0..255.
-Uint8 linearLedValue(Uint8 dmx512Val)
+// Returns the PWM value (0..255) for DMX-512 value, dmx512Val, shaped by
+// response curve, curve. CURVE_LOG provides a perceived linear LED
+// brightness relationship relative to the linearity assumed by lighting
+// consoles generating DMX values in the range 0..255.
+// (This node doesn't store a user curve; addNodeMap() rejects CURVE_USER.)
+Uint8 curveValue(Uint8 curve, Uint8 dmx512Val)
 {
-  // coefficients
-  double percentage = (double)dmx512Val/(double)255.0;
-  double a = 9.7758463166360387E-01;
-  double b = 5.5498961535023345E-00;
-
-  return floor((a * exp(b*percentage) + 0.5)) - 1;
+  switch (curve)
+  {
+    case CURVE_LOG:     return pgm_read_byte(&curveLogTable[dmx512Val]);
+    case CURVE_GAMMA:   return pgm_read_byte(&curveGammaTable[dmx512Val]);
+    case CURVE_SCURVE:  return pgm_read_byte(&curveSTable[dmx512Val]);
+    default:
+      break;
+  }
+  return dmx512Val;
 }
 
 
@@ -533,10 +1013,11 @@ AckCode_t handleCmdRun()
 {
   DmxwNodeMapRecord_t *currNodeMap = NULL;
   Uint8 value, oldValue;
-  Int8 port;
   Int8 pin;
 
-  if (bufSize != (MAX_DMXW_CHANS + 1))
+  if ( (rxSize != (MAX_DMXW_CHANS + 1)) &&
+       (rxSize != (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN)) &&
+       (rxSize != (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN + RUN_TB_LEN)) )
   {
     logPrintln(FLASH("CMD_RUN: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -546,23 +1027,20 @@ AckCode_t handleCmdRun()
     logPrint("RUN: [");
     for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
     {
-      logPrint(buffer[currReadPos + i]);
+      logPrint(rxBuf[currReadPos + i]);
       logPrint(" ");
     }
     logPrintln();
   #endif
 
-  stripParamChange = false;
-  for (Uint8 dmxwChan = 1; dmxwChan <= MAX_DMXW_CHANS; dmxwChan++)
+  for (Uint8 s = 0; s < numOuts; s++)
+    outs[s]->stripParamChange = false;
+  for (Uint8 port = 1; port <= numOuts * PIXEL_BLOCK_PORTS; port++)
   {
-    //Serial.print("DMXW:"); Serial.print(dmxwChan);
-    currNodeMap = &nodeMap[dmxwChan - 1]; // Chan map for DMXW chan, dmxwChan
-    port = currNodeMap->port;  // Port assigned to dmxwChan
-    //Serial.print(", Port:");  Serial.print(port);
-    if (port > 0)
+    currNodeMap = &nodeMap[port - 1]; // Chan map for port
+    if (currNodeMap->dmxwChan != 0)
     {
-      pin = portMap[port - 1].outPin;
-      //Serial.print(", Pin:"); Serial.print(pin);
+      pin = portOutPin(port - 1);
       if ( (pin == PIN_LOCATE) && blinkState )
       {
         logPrint(FLASH("\n*** Warning: skipping pin "));
@@ -576,25 +1054,22 @@ AckCode_t handleCmdRun()
          * a change, set a flag to trigger subsequent handling of
          * effect and parameters changes.
          */
-        value = buffer[dmxwChan];
-        currReadPos++;  // Not really necessary, but good to keep it updated.
-        //Serial.print(", Value:"); Serial.print(value);
+        value = rxBuf[currNodeMap->dmxwChan];
         oldValue = currNodeMap->value;
         currNodeMap->value = value;
-        if (port <= stripLastPortNum)
+        if (oldValue != value)
         {
-          if (oldValue != value)
-          {
-            //Serial.println("Value changed");
-            stripParamChange = true;
-            disableEffects = false;
-          }
+          outs[(port - 1) / PIXEL_BLOCK_PORTS]->stripParamChange = true;
+          disableEffects = false;
         }
-          
       }
     }
-    //Serial.println();
   }
+  currNodeMap = &nodeMap[PIXEL_PORT_BRIGHTNESS - 1];
+  if (currNodeMap->dmxwChan != 0)
+    currNodeMap->value = rxBuf[currNodeMap->dmxwChan];
+  outBrightness();
+  currReadPos += MAX_DMXW_CHANS;
   return ACK_OK;
 }
 
@@ -618,17 +1093,17 @@ AckCode_t handleCmdPong()
 
 AckCode_t handleCmdMap()
 {
-  Int8  dmxwChan    = buffer[currReadPos++];
-  Int8  port        = buffer[currReadPos++];
-  Uint8 logarithmic = buffer[currReadPos++];
+  Int8  dmxwChan    = rxBuf[currReadPos++];
+  Int8  port        = rxBuf[currReadPos++];
+  Uint8 curve       = rxBuf[currReadPos++];
   
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_MAP: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
   }
   
-  if (addNodeMap(dmxwChan, port, logarithmic))
+  if (addNodeMap(dmxwChan, port, curve))
   {
     return ACK_OK;
   }
@@ -638,9 +1113,9 @@ AckCode_t handleCmdMap()
 
 AckCode_t handleCmdMapR()
 {
-  Int8 dmxwChan = buffer[currReadPos++];
+  Int8 dmxwChan = rxBuf[currReadPos++];
   
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_MAPR: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -653,40 +1128,38 @@ AckCode_t handleCmdMapR()
 
 AckCode_t handleCmdClrAll()
 {
-  DmxwNodeMapRecord_t tmpRec;
-  
-  tmpRec.port     = -1;
-  tmpRec.value    = 0;
-  for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-    nodeMap[i] = tmpRec;
-  for (Uint8 i = 0; i < MAX_PORTS; i++)
-    portToDmxwMap[i] = 0;
+  for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
+  {
+    nodeMap[i].dmxwChan = 0;
+    nodeMap[i].value    = 0;
+  }
+  outBrightness();
   return ACK_OK;
 }
 
 AckCode_t handleCmdEcho()
 {
-  Int8 dmxwChan = buffer[currReadPos++];
+  Int8 dmxwChan = rxBuf[currReadPos++];
   Int8 portIdx;
 
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_ECHO: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
   }
 
-  portIdx = getPortMapIdxByDmxwChan(dmxwChan);
+  portIdx = findPortByDmxwChan(dmxwChan);
   if (portIdx == -1)
     return ACK_EPORT;
   bufSize = 0;
   buffer[bufSize++] = CMD_CHAN;
   buffer[bufSize++] = dmxwChan;
   buffer[bufSize++] = portIdx + 1;
-  buffer[bufSize++] = portMap[portIdx].outPin;
-  buffer[bufSize++] = portMap[portIdx].conflictPort;
-  buffer[bufSize++] = portMap[portIdx].isAnalog;
-  buffer[bufSize++] = nodeMap[dmxwChan - 1].value;
-  buffer[bufSize++] = nodeMap[dmxwChan - 1].isLogarithmic;
+  buffer[bufSize++] = portOutPin(portIdx);
+  buffer[bufSize++] = portConflict(portIdx);
+  buffer[bufSize++] = portIsAnalog(portIdx);
+  buffer[bufSize++] = nodeMap[portIdx].value;
+  buffer[bufSize++] = nodeMap[portIdx].flags;
   node = BROADCASTID;
   dataToSend = true;
   return ACK_OK;
@@ -721,19 +1194,19 @@ AckCode_t handleCmdOff()
 
 AckCode_t handleCmdPort()
 {
-  Uint8 port   = buffer[currReadPos++];
-  Uint8 value  = buffer[currReadPos++];
+  Uint8 port   = rxBuf[currReadPos++];
+  Uint8 value  = rxBuf[currReadPos++];
   Int8  pin;
 
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_PORT: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
   }
 
-  if ( (port > 0) && (port <= MAX_PORTS) )
+  if ( (port > 0) && (port <= NUM_PIXEL_PORTS) )
   {
-    pin = portMap[port - 1].outPin;
+    pin = portOutPin(port - 1);
     if ( (pin == PIN_LOCATE) && blinkState )
       blinkState = -1;
   }
@@ -745,13 +1218,12 @@ AckCode_t handleCmdPort()
 
 AckCode_t handleCmdCtrl()
 {
-  Uint8 dmxwChan = buffer[currReadPos++];
-  Uint8 value    = buffer[currReadPos++];
+  Uint8 dmxwChan = rxBuf[currReadPos++];
+  Uint8 value    = rxBuf[currReadPos++];
   Int8  port;
   Int8  pin;
-  DmxwNodeMapRecord_t *currNodeMap = NULL;
 
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_CTRL: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -764,25 +1236,21 @@ AckCode_t handleCmdCtrl()
     return ACK_EDMXW;
   }
 
-  currNodeMap = &nodeMap[dmxwChan - 1]; // Chan map for DMXW chan, dmxwChan
-  port = currNodeMap->port;  // Port assigned to dmxwChan
-  if (port > 0)
+  port = findPortByDmxwChan(dmxwChan);  // Port assigned to dmxwChan
+  if (port != -1)
   {
-    pin = portMap[port - 1].outPin;
+    pin = portOutPin(port);
     if ( (pin == PIN_LOCATE) && blinkState )
       blinkState = -1;
 
-    memset(buffer, 0, sizeof(buffer));
-    bufSize = 0;
+    memset(buffer, 0, TXBUF_LEN);
     command = CMD_RUN;
-    buffer[bufSize++] = command;
-    for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-    {
-      if (i == (dmxwChan - 1))
-        buffer[bufSize++] = value;
-      else
-        buffer[bufSize++] = nodeMap[i].value;
-    }
+    buffer[0] = command;
+    for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
+      if (nodeMap[i].dmxwChan != 0)
+        buffer[nodeMap[i].dmxwChan] = nodeMap[i].value;
+    buffer[dmxwChan] = value;
+    bufSize = 1 + MAX_DMXW_CHANS;
     logPrintln(FLASH("Exec CMD_RUN"));        
     logPrint(FLASH("Buffer: Size["));
     logPrint(bufSize);
@@ -793,19 +1261,20 @@ AckCode_t handleCmdCtrl()
       logPrint(" ");
     }
     logPrintln("] ");
+    rxBuf  = buffer;
+    rxSize = bufSize;
     handleNetRxMessage(command);
   }
   else
     return ACK_EPORT;
 /*JVS
-  currNodeMap = &nodeMap[dmxwChan - 1]; // Chan map for DMXW chan, dmxwChan
-  port = currNodeMap->port;  // Port assigned to dmxwChan
-  if (port > 0)
+  port = findPortByDmxwChan(dmxwChan);  // Port assigned to dmxwChan
+  if (port != -1)
   {
-    pin = portMap[port - 1].outPin;
+    pin = portOutPin(port);
     if ( (pin == PIN_LOCATE) && blinkState )
       blinkState = -1;
-    currNodeMap->value = value;
+    nodeMap[port].value = value;
   }
   else
     return ACK_EPORT;
@@ -814,6 +1283,163 @@ AckCode_t handleCmdCtrl()
   return ACK_OK;
 }
 
+// Measure the supply voltage (mV) by reading the internal 1.1V bandgap
+// reference against AVcc.
+Uint16 readVcc()
+{
+  Uint16 adc;
+
+  ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+  delay(2);                           // Let the reference settle
+  ADCSRA |= _BV(ADSC);
+  while (ADCSRA & _BV(ADSC))
+    ;
+  adc = ADC;
+  return adc ? 1125300UL / adc : 0;   // 1.1V * 1023 * 1000 / adc
+}
+
+// Store v, clamped to 16 bits, MSB first.
+Uint8 *putTelem16(Uint8 *p, unsigned long v)
+{
+  if (v > 0xFFFF)
+    v = 0xFFFF;
+  *p++ = v >> 8;
+  *p++ = v;
+  return p;
+}
+
+AckCode_t handleCmdTreq()
+{
+  Uint8 *p = &ackBuf[1];
+  Uint16 vcc;
+
+  if (rxSize != 1)
+  {
+    logPrintln(FLASH("CMD_TREQ: Packet dropped--corrupted"));
+    return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
+  }
+
+  vcc = readVcc() / 20;
+  *p++ = (vcc > 255) ? 255 : vcc;
+  *p++ = telem.rssiCount ? telem.rssiTotal / telem.rssiCount : 0;
+  *p++ = telem.rssiWorst;
+  p = putTelem16(p, telem.frames);
+  p = putTelem16(p, telem.missed);
+  p = putTelem16(p, telem.loopMax);
+  ackLen = p - ackBuf;
+
+  telem.rssiTotal = telem.rssiCount = telem.rssiWorst = 0;
+  telem.frames = telem.missed = telem.loopMax = 0;
+  return ACK_OK;
+}
+
+// Account for a packet from the gateway in the telemetry.
+void telemGatewayPkt()
+{
+  unsigned long now = millis();
+  Uint8 rssi = -radio.RSSI;
+  Uint8 period;
+  unsigned long gap;
+
+  telem.rssiTotal += rssi;
+  telem.rssiCount++;
+  if (rssi > telem.rssiWorst)
+    telem.rssiWorst = rssi;
+  if (command != CMD_RUN)
+    return;
+
+  telem.frames++;
+  if ( (rxSize >= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN)) &&
+       (telem.lastRun != 0) )
+  {
+    // Count the frame periods elapsed since the last run frame
+    period = rxBuf[1 + MAX_DMXW_CHANS];
+    gap = now - telem.lastRun;
+    if ( (period != 0) && (gap < TELEM_IDLE_MS) )
+    {
+      gap = (gap + period / 2) / period;
+      if (gap > 1)
+        telem.missed += gap - 1;
+    }
+  }
+  telem.lastRun = now;
+}
+
+AckCode_t handleCmdPix()
+{
+  Uint8 page, mode, len;
+  Uint16 n;               // First pixel of the page
+  const Uint8 *d;
+
+  if ( (rxSize < 3) || (numOuts == 0) )
+  {
+    logPrintln(FLASH("CMD_PIX: Packet dropped"));
+    return ACK_NULL;
+  }
+  page = rxBuf[currReadPos++];
+  mode = rxBuf[currReadPos++];
+  d    = &rxBuf[currReadPos];
+  len  = rxSize - currReadPos;
+  n    = (page & PIX_PAGE_MASK) * PIX_PAGE_PIXELS(mode);
+
+  so = outs[0];
+  if (!pixStream.active)
+  {
+    logPrintln(FLASH("Pixel streaming started on output 1"));
+    pixStream.active = true;
+    pixStream.pagesSeen = 0;
+  }
+  if (!so->palRgb)
+  {
+    so->palRgb = true;
+    so->levelStale = true;
+  }
+  pixStream.lastPage = millis();
+  pixStream.pages++;
+
+  // Write the page's pixels straight into the strip's pixel buffer
+  switch (mode)
+  {
+    case PIX_RGB:
+      for (Uint8 i = 0; i + 3 <= len; i += 3)
+        pixSetRgb(n++, d[i], d[i + 1], d[i + 2]);
+      break;
+
+    case PIX_RGB444:
+      for (Uint8 i = 0; i + 2 <= len; i += 3)
+      {
+        pixSetRgb(n++, (d[i] >> 4) * 17, (d[i] & 0x0F) * 17,
+                  (d[i + 1] >> 4) * 17);
+        if (i + 3 <= len)
+          pixSetRgb(n++, (d[i + 1] & 0x0F) * 17, (d[i + 2] >> 4) * 17,
+                    (d[i + 2] & 0x0F) * 17);
+      }
+      break;
+
+    case PIX_RGB332:
+      for (Uint8 i = 0; i < len; i++)
+        pixSetRgb(n++, pixRgb332Red(d[i]), pixRgb332Green(d[i]),
+                  pixRgb332Blue(d[i]));
+      break;
+
+    default:
+      return ACK_ECMD;
+  }
+  pixStream.pixels += n - (page & PIX_PAGE_MASK) * PIX_PAGE_PIXELS(mode);
+  pixStream.pagesSeen |= 1 << (page & 0x0F);
+
+  // Show the frame on its last page (in the next quiet time on the radio)
+  if (page & PIX_LAST)
+  {
+    pixStream.frames++;
+    if (pixStream.pagesSeen != (Uint16)((2 << (page & 0x0F)) - 1))
+      pixStream.partial++;
+    pixStream.pagesSeen = 0;
+    so->stripDirty = true;
+  }
+  return ACK_OK;
+}
+
 AckCode_t handleCmdTest()
 {
   logPrintln(FLASH("Test command received. Nothing to do."));
@@ -822,7 +1448,7 @@ AckCode_t handleCmdTest()
 
 AckCode_t handleCmdSave()
 {
-  if (bufSize != 1)
+  if (rxSize != 1)
   {
     logPrintln(FLASH("CMD_SAVE: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -860,6 +1486,8 @@ AckCode_t handleNetRxMessage(Uint8 command)
     case CMD_OFF:    ret = handleCmdOff();       break;
     case CMD_PORT:   ret = handleCmdPort();      break;
     case CMD_CTRL:   ret = handleCmdCtrl();      break;
+    case CMD_TREQ:   ret = handleCmdTreq();      break;
+    case CMD_PIX:    ret = handleCmdPix();       break;
     case CMD_TEST:   ret = handleCmdTest();      break;
     case CMD_SAVE:   ret = handleCmdSave();      break;
     case CMD_UNDEF:  ret = handleCmdUndef();     break;
@@ -893,6 +1521,8 @@ void printCommand(Uint8 command)
     case CMD_OFF:    dbgPrint(FLASH("CMD_OFF"));     break;
     case CMD_PORT:   dbgPrint(FLASH("CMD_PORT"));    break;
     case CMD_CTRL:   dbgPrint(FLASH("CMD_CTRL"));    break;
+    case CMD_TREQ:   dbgPrint(FLASH("CMD_TREQ"));    break;
+    case CMD_PIX:    dbgPrint(FLASH("CMD_PIX"));     break;
     case CMD_TEST:   dbgPrint(FLASH("CMD_TEST"));    break;
     case CMD_SAVE:   dbgPrint(FLASH("CMD_SAVE"));    break;
     case CMD_UNDEF:  dbgPrint(FLASH("CMD_UNDEF"));   break;
@@ -908,9 +1538,9 @@ if (command != CMD_RUN)
   logPrint(FLASH("RX cmd["));
   logPrint(command);
   logPrint(FLASH("]  ["));
-  for (int i = 0; i < bufSize; i++)
+  for (int i = 0; i < rxSize; i++)
   {
-    logPrint(buffer[i]);
+    logPrint(rxBuf[i]);
     logPrint(FLASH("  "));
   }
   logPrintln(FLASH("]"));
@@ -938,7 +1568,8 @@ void printAckResult(Uint8 ackResult)
 }
 
 
-// Send a message to a node on the wireless network
+// Send a message to a node on the wireless network. The packet header is
+// written into the DMXW_HDR_LEN bytes of headroom in front of payload.
 AckCode_t sendBuffer(int dst, Uint8 *payload, int sendSize, bool requestAck)
 {
   long sentTime;
@@ -958,8 +1589,13 @@ AckCode_t sendBuffer(int dst, Uint8 *payload, int sendSize, bool requestAck)
 
   if (dst == BROADCASTID)
     requestAck = false;
+  payload -= DMXW_HDR_LEN;
+  sendSize += DMXW_HDR_LEN;
+  payload[0] = DMXW_HDR(0, txSeq++);
   for (byte i = 0; i <= TX_NUM_RETRIES; i++)
   { 
+    if (i > 0)
+      payload[0] |= DMXW_HDR_RETRY;
     radio.send(dst, payload, sendSize, requestAck);
     sentTime = millis();
     if (requestAck)
@@ -1019,15 +1655,34 @@ void showSerialHelp()
   logPrintln(FLASH("                        <l> = number of tricolour LEDs"));
   logPrint(  FLASH("                              - ganged triples (12Vdc), "));
   logPrintln(FLASH(                                "singles (5Vdc)"));
+  logPrint(  FLASH("                              - max 255 (765 for "));
+  logPrintln(FLASH(                                "800KHz, with PALETTE_FB)"));
   logPrint(  FLASH("                        <f> = 8(800KHz, WS2812 LEDs), "));
   logPrintln(FLASH(                              "4(400KHz, WS2811 drivers)"));
   logPrint(  FLASH("                        <c> = 1(GRB colour wiring), "));
   logPrintln(FLASH(                              "2(RGB colour wiring)"));
   logPrintln(FLASH("  ledCtrl <n>       - Change default output pin for LED "
                                           "ctrl [n in {3-9, 14-21}]"));
-  logPrintln(FLASH("  n <d>, <p>, <l>   - Map DMXW chan d to port p, with "
-                                         "values to be scaled "));
-  logPrintln(FLASH("                       logarithmically if l=1"));
+  logPrintln(FLASH("  ledOut <s>, <n>, <l> - Configure strip output s, "
+                                          "2 - 4, on pin n"));
+  logPrint(  FLASH("                        with <l> LEDs (0 = unused); "));
+  logPrintln(FLASH(                              "ports 9s-8 - 9s"));
+  logPrintln(FLASH("  ledSeg <l>, <r>, <m>, <v> - Configure segment map:"));
+  logPrintln(FLASH("                        <l> = logical length (0 = off)"));
+  logPrint(  FLASH("                        <r> = # of repeats "));
+  logPrintln(FLASH(                              "(0 = as many as fit)"));
+  logPrint(  FLASH("                        <m> = 1 to mirror every "));
+  logPrintln(FLASH(                              "other repeat"));
+  logPrintln(FLASH("                        <v> = 1 to reverse the strip"));
+  logPrintln(FLASH("  ledPwr <b>, <m>   - Limit the strips to b mA (0 = no "
+                                         "limit),"));
+  logPrintln(FLASH("                        at m mA per LED colour at full "
+                                         "level"));
+  logPrintln(FLASH("  loop              - Show loop() and strip show() rates."));
+  logPrintln(FLASH("  n <d>, <p>, <c>   - Map DMXW chan d to port p, with "
+                                         "values shaped by curve c"));
+  logPrintln(FLASH("                       (0=linear, 1=log, 2=gamma 2.2, "
+                                         "3=S-curve)"));
   logPrintln(FLASH("  p                 - Display the Port Mapping."));
   logPrintln(FLASH("  r <d>             - Remove map for DMXW chan d."));
   logPrintln(FLASH("  s                 - Show DMXW channel mapping."));
@@ -1068,11 +1723,16 @@ void getSerialCommand()
   Uint8  port = 0;
   Uint8  val = 0;
   Uint8  dmxwChan = 0;
-  Uint8  logarithmic = 0;
+  Uint8  curve = 0;
   Uint8  idx = 0;
-  Uint8  stripLen;
+  Int8   portIdx;
+  Uint16 stripLen;
   Uint8  stripFreq;
   Uint8  stripCol;
+  int    segRep;
+  Uint8  segMir, segRev;
+  Uint8  outNum;
+  int    pwrMa, pwrChan;
   bool   cmdToProcess = false;
   bool   cmdInvalid = false;
   DmxwNodeMapRecord_t *tmp;
@@ -1141,16 +1801,14 @@ void getSerialCommand()
           logPrintln(FLASH("*** Chan # out of range"));
           break;
         }
-        memset(buffer, 0, sizeof(buffer));
+        memset(buffer, 0, TXBUF_LEN);
         command = CMD_RUN;
         buffer[bufSize++] = command;
-        for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-        {
-          if (i == (dmxwChan - 1))
-            buffer[bufSize++] = val;
-          else
-            buffer[bufSize++] = nodeMap[i].value;
-        }
+        for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
+          if (nodeMap[i].dmxwChan != 0)
+            buffer[nodeMap[i].dmxwChan] = nodeMap[i].value;
+        buffer[dmxwChan] = val;
+        bufSize += MAX_DMXW_CHANS;
         logPrint(FLASH("Buffer: Size["));
         logPrint(bufSize);
         logPrint(FLASH("]  ["));
@@ -1160,13 +1818,26 @@ void getSerialCommand()
           logPrint(" ");
         }
         logPrintln("] ");
+        rxBuf  = buffer;
+        rxSize = bufSize;
         handleNetRxMessage(command);
         logPrintln(FLASH("CMD_RUN command simulated"));
         break;
         
       case 'f':
         if (strstr(serialBuffer, "free") != null)
+        {
           CheckRam();
+          // The per-channel map (3 bytes per DMXW channel), the port to
+          // DMXW channel table and the port table used to be held in RAM.
+          logPrint(FLASH("  Channel map: "));
+          logPrint(sizeof(nodeMap));
+          logPrint(FLASH(" bytes (was "));
+          logPrint(MAX_DMXW_CHANS * 3 + MAX_PORTS);
+          logPrint(FLASH("); port table: "));
+          logPrint(sizeof(portMap));
+          logPrintln(FLASH(" bytes in flash"));
+        }
         break;
          
       case 'h':
@@ -1176,6 +1847,14 @@ void getSerialCommand()
         break;
         
       case 'l':
+        if (strstr(serialBuffer, "loop") != null)
+        {
+          // loop
+          // Show the loop() and strip show() statistics
+          showLoopStats();
+          break;
+        }
+
         // ledCtrl <n>
         // Change default output pin for LED strip control
         if (strstr(serialBuffer, "ledCtrl") != null)
@@ -1186,10 +1865,6 @@ void getSerialCommand()
                ((val >= 14) && (val <= 21)) )
           {
             ledStripCtrlPin = (Int8)val;
-            for (Uint8 i = 0; i < MAX_PORTS; i++)
-            {
-              portMap[i].outPin = ledStripCtrlPin;
-            }
             logPrint(FLASH("  Output pin "));
             logPrint(ledStripCtrlPin);
             logPrintln(FLASH(" controls the addressable LED strip."));
@@ -1203,6 +1878,101 @@ void getSerialCommand()
           break;
         }
         
+        // ledOut <s>, <n>, <l>
+        // Configure strip output s (2..MAX_STRIP_OUTPUTS)
+        if (strstr(serialBuffer, "ledOut") != null)
+        {
+          serialPos += 5;
+          outNum   = serialParseInt();
+          val      = serialParseInt();
+          stripLen = serialParseInt();
+          if ( (outNum < 2) || (outNum > MAX_STRIP_OUTPUTS) )
+          {
+            logPrint(FLASH("ERROR: Invalid strip output #"));
+            logPrintln(outNum);
+            break;
+          }
+          if ( (stripLen != 0) &&
+               !( ((val >=  3) && (val <=  9)) ||
+                  ((val >= 14) && (val <= 21)) ) )
+          {
+            logPrint(FLASH("ERROR: Invalid output pin, "));
+            logPrintln(val);
+            break;
+          }
+          if ( (stripLen > STRIP_MAX_LEN) ||
+               ((ledStripFreq != 8) && (stripLen > STRIP_MAX_LEN_RGB)) )
+          {
+            logPrint(FLASH("ERROR: Invalid LED strip length: "));
+            logPrintln(stripLen);
+            break;
+          }
+          ledOutPin[outNum - 2] = (Int8)val;
+          ledOutLen[outNum - 2] = stripLen;
+          logPrintln(FLASH("SAVE CONFIGURATION AND POWER CYCLE THE NODE"));
+          break;
+        }
+
+        // ledSeg <l>, <r>, <m>, <v>
+        // Configure the segment map
+        if (strstr(serialBuffer, "ledSeg") != null)
+        {
+          serialPos += 5;
+          stripLen = serialParseInt();
+          segRep   = serialParseInt();
+          segMir   = serialParseInt();
+          segRev   = serialParseInt();
+          if (stripLen > STRIP_MAX_LEN)
+          {
+            logPrint(FLASH("ERROR: Invalid segment length: "));
+            logPrintln(stripLen);
+            break;
+          }
+          if ( (segRep < 0) || (segRep > 255) )
+          {
+            logPrint(FLASH("ERROR: Invalid segment repeat count: "));
+            logPrintln(segRep);
+            break;
+          }
+          segLen    = stripLen;
+          segRepeat = segRep;
+          segFlags  = (segMir ? SEG_MIRROR : 0) | (segRev ? SEG_REVERSE : 0);
+          logPrintln(FLASH("SAVE CONFIGURATION AND POWER CYCLE THE NODE"));
+          break;
+        }
+
+        // ledPwr <b>, <m>
+        // Configure the power limiter
+        if (strstr(serialBuffer, "ledPwr") != null)
+        {
+          serialPos += 5;
+          pwrMa   = serialParseInt();
+          pwrChan = serialParseInt();
+          if ( (pwrMa < 0) || (pwrMa > PWR_MAX_BUDGET) )
+          {
+            logPrint(FLASH("ERROR: Invalid power budget: "));
+            logPrintln(pwrMa);
+            break;
+          }
+          if ( (pwrChan < 1) || (pwrChan > 255) )
+          {
+            logPrint(FLASH("ERROR: Invalid current per channel: "));
+            logPrintln(pwrChan);
+            break;
+          }
+          pwrBudget    = pwrMa;
+          pwrMaPerChan = pwrChan;
+          pwrScale     = 256;
+          for (Uint8 s = 0; s < numOuts; s++)
+            outs[s]->scale = outScale;
+          logPrint(FLASH("  Power budget "));
+          logPrint(pwrBudget);
+          logPrint(FLASH("mA (0 = no limit), "));
+          logPrint(pwrMaPerChan);
+          logPrintln(FLASH("mA per LED colour at full level"));
+          break;
+        }
+
         // led <l>, <f>, <c>
         // Configure addressable LED strip
         if (strstr(serialBuffer, "led") != null)
@@ -1223,6 +1993,13 @@ void getSerialCommand()
             logPrintln(stripCol);
             break;
           }
+          if ( (stripLen > STRIP_MAX_LEN) ||
+               ((stripFreq != 8) && (stripLen > STRIP_MAX_LEN_RGB)) )
+          {
+            logPrint(FLASH("ERROR: Invalid LED strip length: "));
+            logPrintln(stripLen);
+            break;
+          }
           ledStripLen    = stripLen;
           ledStripFreq   = stripFreq;
           ledStripWiring = stripCol;
@@ -1254,12 +2031,12 @@ void getSerialCommand()
         }
         else
         {
-          // n <d>, <p>
-          // Map DMXW chan d to port p.
+          // n <d>, <p>, <c>
+          // Map DMXW chan d to port p, using response curve c.
           dmxwChan    = serialParseInt();
           port        = serialParseInt();
-          logarithmic = serialParseInt();
-          if (addNodeMap(dmxwChan, port, logarithmic))
+          curve       = serialParseInt();
+          if (addNodeMap(dmxwChan, port, curve))
           {
             logPrint(FLASH("Channel "));
             logPrint(dmxwChan);
@@ -1283,27 +2060,30 @@ void getSerialCommand()
         logPrintln(FLASH("Port #\tOut Pin\tConflict  Analog?\tDMX Chan\tName"));
         logPrintln(FLASH("------\t-------\t--------  -------\t--------"
                          "\t--------"));
-        for (Uint8 i = 0; i < MAX_PORTS; i++)
+        for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
         {
+          if ( (i >= numOuts * PIXEL_BLOCK_PORTS) &&
+               (i != PIXEL_PORT_BRIGHTNESS - 1) )
+            continue;
           logPrint(i + 1); logPrint(tabChar);
-          logPrint(portMap[i].outPin); logPrint(tabChar);
-          if (portMap[i].conflictPort != -1)
+          logPrint(portOutPin(i)); logPrint(tabChar);
+          if (portConflict(i) != -1)
           {
-            logPrint(portMap[i].conflictPort);
+            logPrint(portConflict(i));
           }
           else
           {
             logPrint(FLASH("   -"));
           }
           logPrint(tabChar); logPrint("  ");
-          logPrint(portMap[i].isAnalog ? "Y" : "N");
+          logPrint(portIsAnalog(i) ? "Y" : "N");
           logPrint(tabChar); logPrint(tabChar);
-          if (portToDmxwMap[i] != 0)
-            logPrint(portToDmxwMap[i]);
+          if (nodeMap[i].dmxwChan != 0)
+            logPrint(nodeMap[i].dmxwChan);
           else
             logPrint("  -");
           logPrint(tabChar); logPrint(tabChar);
-          logPrintln(portMap[i].name);
+          logPrintln(portName(i));
         }
         logPrintln(FLASH("----------------------------------------------"
                          "------------------"));
@@ -1335,19 +2115,20 @@ void getSerialCommand()
         logPrintln();
         logPrint(FLASH("DMX Channel Mapping for Node #"));
         logPrintln(myNodeId);
-        logPrintln(FLASH("DMXW Chan\tPort\tOut Pin\tAnalog?\tLog?\tValue"));
-        logPrintln(FLASH("---------\t----\t-------\t-------\t----\t-----"));
+        logPrintln(FLASH("DMXW Chan\tPort\tOut Pin\tAnalog?\tCurve\tValue"));
+        logPrintln(FLASH("---------\t----\t-------\t-------\t-----\t-----"));
         for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
         {
-          if (nodeMap[i].port != -1)
+          portIdx = findPortByDmxwChan(i + 1);
+          if (portIdx != -1)
           {
-            port = nodeMap[i].port - 1;
+            port = portIdx;
             logPrint(i + 1); logPrint(tabChar); logPrint(tabChar);
             logPrint(port + 1); logPrint(tabChar);
-            logPrint(portMap[port].outPin); logPrint(tabChar);
-            logPrint(portMap[port].isAnalog ? "Y" : "N"); logPrint(tabChar);
-            logPrint(nodeMap[i].isLogarithmic ? "Y" : "N"); logPrint(tabChar);
-            logPrintln(nodeMap[i].value);
+            logPrint(portOutPin(port)); logPrint(tabChar);
+            logPrint(portIsAnalog(port) ? "Y" : "N"); logPrint(tabChar);
+            logPrint(nodeMap[port].flags); logPrint(tabChar);
+            logPrintln(nodeMap[port].value);
           }
         }
         logPrintln(FLASH("-----------------------------------------------------"));
@@ -1376,74 +2157,806 @@ void getSerialCommand()
  ************************   Effects Functions   ****************************
  ***************************************************************************/
 
+// Set up the segment map for a strip of len pixels: the # of logical
+// pixels the effects render (numPix) and the # of repeats output.
+void segConfigure(Uint16 len)
+{
+  so->stripPix  = len;
+  so->numPix    = len;
+  so->segCopies = 1;
+  if ( (segLen >= 1) && (segLen <= len) )
+  {
+    so->numPix    = segLen;
+    so->segCopies = ((len / segLen) > 255) ? 255 : (len / segLen);
+    if ( (segRepeat >= 1) && (segRepeat < so->segCopies) )
+      so->segCopies = segRepeat;
+  }
+  so->segSpan = so->numPix * so->segCopies;
+}
 
+// Strip pixel showing repeat k of logical pixel n.
+uint16_t segPixel(uint16_t n, Uint8 k)
+{
+  uint16_t pos = k * so->numPix;
 
-// Twinkle effect
-// Arguments:
-//   backgroundColor:I  - Background colour
-//   minDelay:I         - Min delay (ms) before next twinkle
-//   maxDelay:I         - Max delay (ms) before next twinkle
-//   maxSimultaneous:I  - Max # of LEDs (triples) allowed to twinkle
-//                          simultaneously
-//   holdTime:I         - Duration (ms) for which twinkle is held
-void twinkle(uint32_t backgroundColor,
-             uint16_t minDelay,
-             uint16_t maxDelay,
-             uint8_t maxSimultaneous,
-             uint8_t holdTime)
-{
-  static uint16_t i = 0;
-  static uint16_t j = 0;
-  static boolean newIteration = false;
-  static Uint8 phase = 0;
-  static long delayEnd = 0;
-  static uint16_t numSimultaneous;
-  long currTime = 0;
-  uint16_t k;
-  
-  if (newEffect)
+  if ( (segFlags & SEG_MIRROR) && (k & 1) )
+    pos += so->numPix - 1 - n;
+  else
+    pos += n;
+  if (segFlags & SEG_REVERSE)
+    pos = so->segSpan - 1 - pos;
+  return pos;
+}
+
+// Set the node's brightness from the Brightness port (full if it isn't
+// mapped). The palette framebuffers are redrawn at once; the library's
+// pixel buffers take it up as their pixels are rewritten.
+void outBrightness()
+{
+  Uint8  bright = 255;
+  Uint16 scale;
+
+  if (nodeMap[PIXEL_PORT_BRIGHTNESS - 1].dmxwChan != 0)
+    bright = nodeMap[PIXEL_PORT_BRIGHTNESS - 1].value;
+  scale = bright + (bright >> 7);  // 0..255 --> 0..256
+  if (scale == outScale)
+    return;
+  outScale = scale;
+  for (Uint8 s = 0; s < numOuts; s++)
   {
-    for (i = 0; i < strip->numPixels(); i++)
-    {
-      strip->setPixelColor(i, backgroundColor);
-    }
-    strip->show();
-    newIteration = true;
+    outs[s]->scale = ((unsigned long)outScale * pwrScale) >> 8;
+    if (outs[s]->palFb != NULL)
+      outs[s]->stripDirty = true;
   }
-  
-  if (newIteration)
+}
+
+// Does so's output stage dither in time? Only a palette framebuffer
+// whose show() is short enough is re-shown at the dither rate (see
+// stripShow()); the others round to the nearest level.
+inline bool outDithers()
+{
+  return (so->palFb != NULL) && (so->showTime != 0) &&
+         (so->showTime <= DITHER_MAX_SHOW_US);
+}
+
+// Dither threshold for pixel n of so's next frame.
+Uint8 outDither(uint16_t n)
+{
+  if (!outDithers())
+    return 128;
+  return pgm_read_byte(&ditherTable[(so->ditherFrame + n) & 15]);
+}
+
+// Output level of colour value v: gamma corrected and scaled by so's
+// brightness and power limit in 8.8 fixed point, then rounded up if the
+// fraction is above dither threshold thr, else down. (At most 255: full
+// scale is 255.0.)
+inline Uint8 outLevel(Uint8 v, Uint8 thr)
+{
+  uint16_t level;
+
+  level = ((uint32_t)pgm_read_word(&gammaTable[v]) * so->scale) >> 8;
+  return (level >> 8) + ((Uint8)level > thr);
+}
+
+// Write colour (r, g, b) through the output stage into a pixel, in the
+// strip's wire order.
+inline void outPixel(Uint8 *pixel, Uint8 r, Uint8 g, Uint8 b, Uint8 thr)
+{
+  pixel[pixOffsRed]   = outLevel(r, thr);
+  pixel[pixOffsGreen] = outLevel(g, thr);
+  pixel[pixOffsBlue]  = outLevel(b, thr);
+}
+
+// Sum of a pixel's colour channel levels (for so->levelSum).
+inline Uint16 pixLevels(const Uint8 *pixel)
+{
+  return pixel[0] + pixel[1] + pixel[2];
+}
+
+// Set pixel n to colour c, marking the frame dirty if that changes it.
+// The effects use this rather than strip->setPixelColor(), and leave it
+// to stripShow() to send the frame.
+void stripSetPixel(uint16_t n, uint32_t c)
+{
+  Uint8 *pixels = so->strip->getPixels();
+  Uint8 *pixel = &pixels[segPixel(n, 0) * 3];
+  Uint8 out[3];
+
+  outPixel(out, (Uint8)(c >> 16), (Uint8)(c >> 8), (Uint8)c, outDither(n));
+  if (memcmp(pixel, out, 3) != 0)
   {
-    newIteration = false;
-    i = 0;
-    phase = 1;
-    numSimultaneous = random(1, maxSimultaneous);
+    so->levelSum -= (unsigned long)pixLevels(pixel) * so->segCopies;
+    so->levelSum += (unsigned long)pixLevels(out) * so->segCopies;
+    for (Uint8 k = 0; k < so->segCopies; k++)
+      memcpy(&pixels[segPixel(n, k) * 3], out, 3);
+    so->stripDirty = true;
   }
-  else if (i < 10)
+}
+
+// Write colour wheel position, pos, through the output stage (with dither
+// threshold thr) straight into a pixel of the strip's pixel buffer. The
+// caller marks the frame dirty.
+void wheelToPixel(Uint8 *pixel, Uint8 pos, Uint8 thr)
+{
+  const Uint8 *colour = wheelTable[pos];
+
+  outPixel(pixel, pgm_read_byte(&colour[WHEEL_RED]),
+                  pgm_read_byte(&colour[WHEEL_GREEN]),
+                  pgm_read_byte(&colour[WHEEL_BLUE]), thr);
+}
+
+// The effects render through the pixXxx() functions below, so that they
+// work with either the library's pixel buffer or the palette framebuffer.
+
+// Select colour wheel (rainbow effects) or palette[] colours for the
+// palette framebuffer's indices.
+void pixUseWheel(bool wheel)
+{
+  if (wheel != so->palWheel)
   {
-    switch (phase)
-    {
-      case 1:
-        // Set white pixels randomly
-        for (j = 0; j < numSimultaneous; j++)
-        {
-          k = (uint16_t)random(0, strip->numPixels());
-          strip->setPixelColor(k, strip->Color(255,255,255));
-        }
-        strip->show();
-        phase = 2;
-        delayEnd = millis() + holdTime;
-        break;
-      
-      case 2:
-        // Hold the twinkle; account for timer wraparound
-        currTime = millis();
-        if (delayEnd >= holdTime)
-        {
-          if (currTime < delayEnd)
-            break;
-        }
-        else
-        {
+    so->palWheel = wheel;
+    if (so->palFb != NULL)
+      so->stripDirty = so->levelStale = true;
+  }
+}
+
+// Set palette[] entry idx (1..PAL_RAM_LEN-1) to colour c.
+void palSet(Uint8 idx, uint32_t c)
+{
+  Uint8 *colour = so->palette[idx];
+  Uint8 r = (Uint8)(c >> 16);
+  Uint8 g = (Uint8)(c >> 8);
+  Uint8 b = (Uint8)c;
+
+  if ( (colour[0] != r) || (colour[1] != g) || (colour[2] != b) )
+  {
+    colour[0] = r;
+    colour[1] = g;
+    colour[2] = b;
+    if (so->palFb != NULL)
+      so->stripDirty = so->levelStale = true;  // Pixels of this colour too
+  }
+}
+
+// Sum of the colour channel levels of palette framebuffer index idx, at
+// full scale: gamma corrected, before the output stage's scale.
+Uint16 palLevels(Uint8 idx)
+{
+  const Uint8 *colour;
+  Uint8 r, g, b;
+
+  if (idx == 0)
+    return 0;
+  if (so->palRgb)
+  {
+    r = pixRgb332Red(idx);
+    g = pixRgb332Green(idx);
+    b = pixRgb332Blue(idx);
+  }
+  else if (so->palWheel)
+  {
+    colour = wheelTable[idx];
+    r = pgm_read_byte(&colour[WHEEL_RED]);
+    g = pgm_read_byte(&colour[WHEEL_GREEN]);
+    b = pgm_read_byte(&colour[WHEEL_BLUE]);
+  }
+  else
+  {
+    colour = so->palette[idx & (PAL_RAM_LEN - 1)];
+    r = colour[0];
+    g = colour[1];
+    b = colour[2];
+  }
+  return ((uint32_t)pgm_read_word(&gammaTable[r]) +
+          pgm_read_word(&gammaTable[g]) + pgm_read_word(&gammaTable[b])) >> 8;
+}
+
+// Set palette framebuffer pixel n to index idx, keeping so->levelSum.
+inline void palFbSet(uint16_t n, Uint8 idx)
+{
+  so->levelSum -= (unsigned long)palLevels(so->palFb[n]) * so->segCopies;
+  so->levelSum += (unsigned long)palLevels(idx) * so->segCopies;
+  so->palFb[n] = idx;
+}
+
+// Estimated sum of the colour channel levels of so's frame, as it will
+// be sent. (The palette framebuffer's is recounted first if the colours
+// its indices stand for have changed.)
+unsigned long outLevelSum()
+{
+  unsigned long levels = 0;
+
+  if (so->palFb == NULL)
+    return so->levelSum;
+  if (so->levelStale)
+  {
+    for (Uint16 n = 0; n < so->numPix; n++)
+      levels += palLevels(so->palFb[n]);
+    so->levelSum = levels * so->segCopies;
+    so->levelStale = false;
+  }
+  return (so->levelSum * so->scale) >> 8;
+}
+
+// Set pixel n to palette[] colour idx, marking the frame dirty if that
+// changes it.
+void pixSetPal(uint16_t n, Uint8 idx)
+{
+  if (so->palFb != NULL)
+  {
+    if (so->palFb[n] != idx)
+    {
+      palFbSet(n, idx);
+      so->stripDirty = true;
+    }
+  }
+  else
+    stripSetPixel(n, so->strip->Color(so->palette[idx][0],
+                                      so->palette[idx][1],
+                                      so->palette[idx][2]));
+}
+
+// Set pixel n to colour wheel position pos. The caller marks the frame
+// dirty.
+void pixSetWheel(uint16_t n, Uint8 pos)
+{
+  Uint8 *pixel;
+  Uint8 thr;
+
+  if (so->palFb != NULL)
+    palFbSet(n, pos ? pos : 255);  // (Index 0 is black; 255 = 0's colour)
+  else
+  {
+    thr = outDither(n);
+    for (Uint8 k = 0; k < so->segCopies; k++)
+    {
+      pixel = &so->strip->getPixels()[segPixel(n, k) * 3];
+      so->levelSum -= pixLevels(pixel);
+      wheelToPixel(pixel, pos, thr);
+      so->levelSum += pixLevels(pixel);
+    }
+  }
+}
+
+// Set pixel n to black, without marking the frame dirty.
+void pixClear(uint16_t n)
+{
+  Uint8 *pixel;
+
+  if (so->palFb != NULL)
+    palFbSet(n, 0);
+  else
+    for (Uint8 k = 0; k < so->segCopies; k++)
+    {
+      pixel = &so->strip->getPixels()[segPixel(n, k) * 3];
+      so->levelSum -= pixLevels(pixel);
+      pixel[0] = pixel[1] = pixel[2] = 0;
+    }
+}
+
+// Set pixel n (if there is one) to colour (r, g, b), straight into the
+// strip's pixel buffer (or, as a 3-3-2 colour, into the palette
+// framebuffer), without marking the frame dirty. (For CMD_PIX.)
+void pixSetRgb(uint16_t n, Uint8 r, Uint8 g, Uint8 b)
+{
+  Uint8 *pixel;
+  Uint8 thr;
+
+  if (n >= so->numPix)
+    return;
+  if (so->palFb != NULL)
+    palFbSet(n, (r & 0xE0) | ((g >> 3) & 0x1C) | (b >> 6));
+  else
+  {
+    thr = outDither(n);
+    for (Uint8 k = 0; k < so->segCopies; k++)
+    {
+      pixel = &so->strip->getPixels()[segPixel(n, k) * 3];
+      so->levelSum -= pixLevels(pixel);
+      outPixel(pixel, r, g, b, thr);
+      so->levelSum += pixLevels(pixel);
+    }
+  }
+}
+
+#ifdef PALETTE_FB_ENABLED
+// Send the 3 bytes at ptr to the strip on port, MSB first, at 800 KHz
+// with a 16 MHz clock: 20 cycles per bit, high for 5 (0 bit) or 13 (1 bit)
+// cycles. (This is the bit loop of Adafruit_NeoPixel::show().) hi and lo
+// are the port values with the strip's pin high and low; the pin is left
+// low. Interrupts must be disabled.
+void palSendPixel(volatile Uint8 *port, Uint8 hi, Uint8 lo, const Uint8 *ptr)
+{
+  Uint8  b = *ptr++;
+  Uint8  next = lo;
+  Uint8  bit = 8;
+  Uint16 i = 3;
+
+  asm volatile(
+   "1:"                         "\n\t" // Clk  Pseudocode    (T =  0)
+    "st   %a[port],  %[hi]"    "\n\t" // 2    PORT = hi     (T =  2)
+    "sbrc %[byte],  7"         "\n\t" // 1-2  if(b & 128)
+     "mov  %[next], %[hi]"     "\n\t" // 0-1   next = hi    (T =  4)
+    "dec  %[bit]"              "\n\t" // 1    bit--         (T =  5)
+    "st   %a[port],  %[next]"  "\n\t" // 2    PORT = next   (T =  7)
+    "mov  %[next] ,  %[lo]"    "\n\t" // 1    next = lo     (T =  8)
+    "breq 2f"                  "\n\t" // 1-2  if(bit == 0) (from dec above)
+    "rol  %[byte]"             "\n\t" // 1    b <<= 1       (T = 10)
+    "rjmp .+0"                 "\n\t" // 2    nop nop       (T = 12)
+    "nop"                      "\n\t" // 1    nop           (T = 13)
+    "st   %a[port],  %[lo]"    "\n\t" // 2    PORT = lo     (T = 15)
+    "nop"                      "\n\t" // 1    nop           (T = 16)
+    "rjmp .+0"                 "\n\t" // 2    nop nop       (T = 18)
+    "rjmp 1b"                  "\n\t" // 2    -> 1 (next bit out)
+   "2:"                         "\n\t" //                    (T = 10)
+    "ldi  %[bit]  ,  8"        "\n\t" // 1    bit = 8       (T = 11)
+    "ld   %[byte] ,  %a[ptr]+" "\n\t" // 2    b = *ptr++    (T = 13)
+    "st   %a[port], %[lo]"     "\n\t" // 2    PORT = lo     (T = 15)
+    "nop"                      "\n\t" // 1    nop           (T = 16)
+    "sbiw %[count], 1"         "\n\t" // 2    i--           (T = 18)
+     "brne 1b"                 "\n"    // 2    if(i != 0) -> 1 (next byte)
+    : [port]  "+e" (port),
+      [byte]  "+r" (b),
+      [bit]   "+r" (bit),
+      [next]  "+r" (next),
+      [count] "+w" (i),
+      [ptr]   "+e" (ptr)
+    : [hi]    "r" (hi),
+      [lo]    "r" (lo));
+}
+
+// Expand palette framebuffer index idx to its colour, through the output
+// stage (with dither threshold thr), in the strip's wire order.
+inline void palExpand(Uint8 idx, Uint8 *pixel, Uint8 thr)
+{
+  const Uint8 *colour;
+
+  if (idx == 0)
+    pixel[0] = pixel[1] = pixel[2] = 0;
+  else if (so->palRgb)
+    outPixel(pixel, pixRgb332Red(idx), pixRgb332Green(idx),
+                    pixRgb332Blue(idx), thr);
+  else if (so->palWheel)
+    wheelToPixel(pixel, idx, thr);
+  else
+  {
+    colour = so->palette[idx & (PAL_RAM_LEN - 1)];
+    outPixel(pixel, colour[0], colour[1], colour[2], thr);
+  }
+}
+
+// Send the palette framebuffer to the strip, expanding each index to its
+// colour, in the strip's wire order, on the fly. The segment map's
+// repeats are streamed from the one copy in the framebuffer, walking it
+// forwards or backwards as the repeat is mirrored and/or reversed; the
+// rest of the strip is sent black. Interrupts are off throughout, as in
+// strip->show(): a pause of PAL_LATCH_US would latch a partial frame.
+// (The few us spent between pixels only stretch a bit's low time.)
+void palShow()
+{
+  volatile Uint8 *port = portOutputRegister(digitalPinToPort(so->pin));
+  Uint8 pinMask = digitalPinToBitMask(so->pin);
+  const Uint8 *fb;
+  Uint8 pixel[3];
+  Uint8 dither = so->ditherFrame;  // Dither step of the pixel going out
+  bool  dithers = outDithers();
+  Uint8 hi, lo, k;
+  bool  up;
+  Uint8 oldSREG;
+
+  while ((micros() - so->palLatchTime) < PAL_LATCH_US)
+    ;  // Let the strip latch the previous frame
+
+  oldSREG = SREG;
+  cli();
+  hi = *port |  pinMask;
+  lo = *port & ~pinMask;
+  for (Uint8 c = 0; c < so->segCopies; c++)
+  {
+    // Repeat k goes out c-th; walk it up or down the framebuffer
+    k  = (segFlags & SEG_REVERSE) ? so->segCopies - 1 - c : c;
+    up = !(segFlags & SEG_REVERSE) != ((segFlags & SEG_MIRROR) && (k & 1));
+    fb = up ? so->palFb : &so->palFb[so->numPix - 1];
+    for (Uint16 n = 0; n < so->numPix; n++)
+    {
+      palExpand(up ? *fb++ : *fb--, pixel,
+                dithers ? pgm_read_byte(&ditherTable[dither++ & 15]) : 128);
+      palSendPixel(port, hi, lo, pixel);
+    }
+  }
+  pixel[0] = pixel[1] = pixel[2] = 0;
+  for (Uint16 n = so->segSpan; n < so->stripPix; n++)
+    palSendPixel(port, hi, lo, pixel);
+  SREG = oldSREG;
+  so->palLatchTime = micros();
+}
+#endif
+
+// Power limiter, run before a round of show()s: scale all the outputs'
+// frames down by one factor, so that their estimated current fits in
+// pwrBudget mA.
+void pwrLimit()
+{
+  StripOut_t *cur = so;     // (so is the output about to be shown)
+  unsigned long limit;      // Budget, in channel levels
+  unsigned long total = 0;  // Channel levels of all the outputs' frames
+  Uint16 factor;            // Scale to fit the budget (0..255)
+  Uint8 *pixel;
+  Uint8 s;
+
+  if (pwrBudget == 0)
+    return;
+  limit = ((unsigned long)pwrBudget * 255) / pwrMaPerChan;
+  for (s = 0; s < numOuts; s++)
+  {
+    so = outs[s];
+    total += outLevelSum();
+  }
+  so = cur;
+
+  if (total <= limit)
+    return;
+  factor = (limit << 8) / total;
+  for (s = 0; s < numOuts; s++)
+  {
+    so = outs[s];
+    if (so->levelSum == 0)
+      continue;
+    if (so->palFb == NULL)
+    {
+      // Scale the pixel buffer in place (palShow() scales as it expands)
+      pixel = so->strip->getPixels();
+      so->levelSum = 0;
+      for (Uint16 i = 0; i < so->stripPix * 3; i++)
+      {
+        pixel[i] = (pixel[i] * factor) >> 8;
+        so->levelSum += pixel[i];
+      }
+    }
+    so->stripDirty = true;  // Resend it limited, in this round if it can
+  }
+  so = cur;
+  pwrScale = (pwrScale * factor) >> 8;
+  pwrLimited++;
+  for (s = 0; s < numOuts; s++)
+    outs[s]->scale = ((unsigned long)outScale * pwrScale) >> 8;
+}
+
+// Power limiter: every PWR_RISE_MS, ease the limiter scale back up a
+// step if the estimated current leaves room for it, and resend the
+// palette framebuffers at the new scale. (The library's pixel buffers
+// take it up as their pixels are rewritten.)
+void pwrEase()
+{
+  static unsigned long lastRise = 0;  // millis() of the last step
+  StripOut_t *cur = so;
+  unsigned long limit;      // Budget, in channel levels
+  unsigned long total = 0;  // Channel levels of all the outputs' frames
+  Uint8 s;
+
+  if ( (pwrBudget == 0) || (pwrScale >= 256) ||
+       ((millis() - lastRise) < PWR_RISE_MS) )
+    return;
+  lastRise = millis();
+  limit = ((unsigned long)pwrBudget * 255) / pwrMaPerChan;
+  for (s = 0; s < numOuts; s++)
+  {
+    so = outs[s];
+    total += outLevelSum();
+  }
+  if (total * (pwrScale + PWR_RISE) <= limit * pwrScale)
+  {
+    pwrScale += PWR_RISE;
+    if (pwrScale > 256)
+      pwrScale = 256;
+    for (s = 0; s < numOuts; s++)
+    {
+      so = outs[s];
+      so->scale = ((unsigned long)outScale * pwrScale) >> 8;
+      if ( (so->palFb != NULL) && (so->levelSum != 0) )
+        so->stripDirty = true;
+    }
+  }
+  so = cur;
+}
+
+// Send each output's frame to its strip, if its pixel data changed and
+// show() can be done before the next run frame is due (see
+// showWindowOpen()). The outputs take turns to go first, so that one
+// that keeps changing can't hold the others off.
+void stripShow()
+{
+  static Uint8 first = 0;  // Output to consider first
+  unsigned long showStart;
+  bool  limited = false;   // pwrLimit() run for this round?
+  Uint8 s;
+
+  pwrEase();
+
+  for (Uint8 n = 0; n < numOuts; n++)
+  {
+    s = first + n;
+    if (s >= numOuts)
+      s -= numOuts;
+    so = outs[s];
+    if ( !so->stripDirty &&
+         ( !outDithers() || (so->levelSum == 0) ||
+           ((micros() - so->palLatchTime) < DITHER_US) ) )
+      continue;  // (A lit dithered frame is re-shown every DITHER_US)
+    if (!showWindowOpen())
+    {
+      if (!so->waiting && so->stripDirty)
+        showWin.deferred++;
+      so->waiting = so->stripDirty;
+      continue;
+    }
+    so->waiting = false;
+    if (!limited)
+    {
+      pwrLimit();
+      limited = true;
+    }
+    showStart = micros();
+    #ifdef PALETTE_FB_ENABLED
+      if (so->palFb != NULL)
+        palShow();
+      else
+        so->strip->show();
+    #else
+      so->strip->show();
+    #endif
+    showStart = micros() - showStart;
+    if (showStart > so->showTime)
+      so->showTime = showStart;
+    so->showLast = showStart;
+    so->ditherFrame++;
+    showWin.budgetUsed += showStart;
+    showTotal += showStart;
+    showCount++;
+    so->lastShowFrame = showWin.frames;
+    so->stripDirty = false;
+    first = s + 1;
+  }
+  if (first >= numOuts)
+    first = 0;
+}
+
+// Record the arrival, at time rxTimeUs, of a run frame from the gateway:
+// learn the frame period.
+void showWinRunFrame(unsigned long rxTimeUs)
+{
+  unsigned long gap = rxTimeUs - showWin.lastRun;
+  Uint8 period;
+
+  if ( (showWin.frames == 0) || (gap >= SHOW_IDLE_MS * 1000UL) )
+  {
+    // (Re)start: seed the period from the schedule trailer.
+    showWin.period = 0;
+    if (rxSize >= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN))
+    {
+      period = rxBuf[1 + MAX_DMXW_CHANS];
+      showWin.period = period * 1000UL;
+    }
+  }
+  else if (showWin.period == 0)
+    showWin.period = gap;
+  else if (gap < showWin.period + showWin.period / 2)
+  {
+    // Smooth the period, following slow drift
+    if (gap > showWin.period)
+      showWin.period += (gap - showWin.period) / 8;
+    else
+      showWin.period -= (showWin.period - gap) / 8;
+  }
+  // (Longer gaps are missed frames: see telem.missed.)
+
+  showWin.frames++;
+  showWin.lastRun = rxTimeUs;
+  showWin.budgetUsed = 0;
+  showWin.holdOff = (rxHdr & DMXW_HDR_POLL) ? SHOW_POLL_WAIT_US : 0;
+}
+
+// Gateway time (see Timebase_t) at local time local (millis()).
+unsigned long tbAt(unsigned long local)
+{
+  return local + tb.offset + (tbFrac(local) >> 8);
+}
+
+// Gateway time now.
+unsigned long tbNow()
+{
+  return tbAt(millis());
+}
+
+// Fractional part of the timebase offset (in 1/256 ms, and possibly over
+// a ms) at local time local: the offset drifts on from the last timebase.
+long tbFrac(unsigned long local)
+{
+  unsigned long since = local - tb.lastLocal;
+
+  if (since > TB_COAST_MS)
+    since = TB_COAST_MS;
+  return tb.frac + ((tb.drift * (long)since) >> 16);
+}
+
+// Lock the timebase to the gateway's timebase in the run frame received at
+// local time local (millis()). A phase and frequency locked loop: each
+// timebase moves our estimate 1/8 of the way to the gateway's time, and
+// corrects the drift by 1/16 of the rate error since the last one, which
+// rides out packet timing jitter and keeps time across lost frames. A
+// large error (first timebase, gateway restart) steps the timebase
+// instead, and restarts the effects.
+void tbRunFrame(unsigned long local)
+{
+  unsigned long gw = 0;
+  unsigned long since = local - tb.lastLocal;
+  long f = tbFrac(local);
+  long err;  // Gateway time - our estimate of it
+
+  if (rxSize >= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN + RUN_TB_LEN))
+  {
+    for (Int8 i = RUN_TB_LEN - 1; i >= 0; i--)
+      gw = (gw << 8) | rxBuf[1 + MAX_DMXW_CHANS + RUN_SCHED_LEN + i];
+    err = (long)(gw - local - tb.offset);  // (ms)
+
+    if ( !tb.locked || (err > TB_SLEW_MS) || (err < -TB_SLEW_MS) )
+    {
+      tb.offset = gw - local;
+      f = 0;
+      tb.locked = true;
+      tb.steps++;
+      for (Uint8 s = 0; s < numOuts; s++)
+      {
+        so = outs[s];
+        fxRestart(gw);
+      }
+    }
+    else
+    {
+      err = (err << 8) - f;  // (1/256 ms)
+      f += err / 8;
+      if ( (since > 0) && (since < TB_COAST_MS) )
+        tb.drift = constrain(tb.drift + (err << 12) / (long)since,
+                             -TB_MAX_DRIFT, TB_MAX_DRIFT);
+    }
+    tb.offset += f >> 8;
+    tb.frac = f & 0xFF;
+    tb.lastLocal = local;
+  }
+  tb.frameTime = tbAt(local);
+}
+
+// Is this a quiet time on the radio, in which show() of output so can be
+// done without overlapping the next run frame, or going over the run
+// frame's show() budget?
+bool showWindowOpen()
+{
+  unsigned long since = micros() - showWin.lastRun;
+  unsigned long showTime = so->showTime;
+
+  if ( (showWin.period == 0) || (since >= SHOW_IDLE_MS * 1000UL) )
+    return true;  // No run frame cadence to avoid
+  if (since < showWin.holdOff)
+    return false;
+  if (showTime == 0)
+    showTime = so->stripPix * (unsigned long)SHOW_US_PER_LED;
+  if ( (showWin.budgetUsed != 0) &&
+       (showWin.budgetUsed + showTime > SHOW_BUDGET_US) )
+    return false;
+
+  if (showWin.holdOff + showTime + SHOW_GUARD_US >= showWin.period)
+  {
+    // show() doesn't fit in a gap. Show at the start of every other gap
+    // (the run frame it overlaps is lost).
+    if ( (since < showWin.period) &&
+         (showWin.frames - so->lastShowFrame >= 2) )
+    {
+      showWin.overlaps++;
+      return true;
+    }
+    return false;
+  }
+
+  // After missed frames, the next one is still due on the cadence.
+  since %= showWin.period;
+  return (since >= showWin.holdOff) &&
+         (since + showTime + SHOW_GUARD_US <= showWin.period);
+}
+
+
+
+// Twinkle effect
+// Arguments (from the output's ports, defaulted on a new effect):
+//   backgroundColor    - Background colour (Arg1 - 3)
+//   minDelay           - Min delay (ms) before next twinkle (Arg4 x 10)
+//   maxDelay           - Max delay (ms) before next twinkle (Arg5 x 10)
+//   maxSimultaneous    - Max # of LEDs (triples) allowed to twinkle
+//                          simultaneously (Arg6)
+//   holdTime           - Duration (ms) for which twinkle is held (Arg7)
+void twinkle(unsigned long now)
+{
+  uint16_t &i = so->fx.twinkle.i;  // (The output's effect state)
+  uint16_t &j = so->fx.twinkle.j;
+  bool  &newIteration = so->fx.twinkle.newIteration;
+  Uint8 &phase = so->fx.twinkle.phase;
+  long  &delayEnd = so->fx.twinkle.delayEnd;
+  uint16_t &numSimultaneous = so->fx.twinkle.numSimultaneous;
+  long currTime = 0;
+  uint16_t k;
+  uint32_t backgroundColor;
+  uint16_t minDelay, maxDelay;
+  uint8_t maxSimultaneous, holdTime;
+  
+  if (so->newEffect)
+  {
+    if (so->stripArg4 == 0)
+      so->stripArg4 = 1;
+    if (so->stripArg5 == 0)
+      so->stripArg5 = 100;
+    else if (so->stripArg5 == 1)
+      so->stripArg5 = 2;
+    if (so->stripArg6 == 0)
+      so->stripArg6 = 5;
+    if (so->stripArg6 > so->numPix)
+      so->stripArg6 = so->numPix;
+    if (so->stripArg7 == 0)
+      so->stripArg7 = 20;
+    if (so->stripArg4 >= so->stripArg5)
+      so->stripArg4 = so->stripArg5 - 1;
+    so->stripDelay = 1;  // (The twinkles are timed here)
+  }
+  backgroundColor = fxColour();
+  minDelay        = so->stripArg4 * 10;
+  maxDelay        = so->stripArg5 * 10;
+  maxSimultaneous = so->stripArg6;
+  holdTime        = so->stripArg7;
+  
+  // Palette entry 1 is the background and entry 2 the twinkle colour
+  pixUseWheel(false);
+  palSet(1, backgroundColor);
+  palSet(2, so->strip->Color(255,255,255));
+  if (so->newEffect)
+  {
+    for (i = 0; i < so->numPix; i++)
+    {
+      pixSetPal(i, 1);
+    }
+    newIteration = true;
+  }
+  
+  if (newIteration)
+  {
+    newIteration = false;
+    i = 0;
+    phase = 1;
+    numSimultaneous = random(1, maxSimultaneous);
+  }
+  else if (i < 10)
+  {
+    switch (phase)
+    {
+      case 1:
+        // Set white pixels randomly
+        for (j = 0; j < numSimultaneous; j++)
+        {
+          k = (uint16_t)random(0, so->numPix);
+          pixSetPal(k, 2);
+        }
+        phase = 2;
+        delayEnd = now + holdTime;
+        break;
+      
+      case 2:
+        // Hold the twinkle; account for timer wraparound
+        currTime = now;
+        if (delayEnd >= holdTime)
+        {
+          if (currTime < delayEnd)
+            break;
+        }
+        else
+        {
           if (currTime > delayEnd)
             break;
         }
@@ -1452,18 +2965,17 @@ void twinkle(uint32_t backgroundColor,
       
       case 3:
         // Remove white pixels (revert to all background colour)
-        for (j = 0; j < strip->numPixels(); j++)
+        for (j = 0; j < so->numPix; j++)
         {
-          strip->setPixelColor(j, backgroundColor);
+          pixSetPal(j, 1);
         }
-        strip->show();
-        delayEnd = millis() + random(minDelay, maxDelay);
+        delayEnd = now + random(minDelay, maxDelay);
         phase = 4;
         break;
       
       case 4:
         // Delay the next twinkle; account for timer wraparound
-        currTime = millis();
+        currTime = now;
         if (delayEnd >= holdTime)
         {
           if (currTime < delayEnd)
@@ -1492,8 +3004,9 @@ void twinkle(uint32_t backgroundColor,
   Function: waterAndEmbers
   
   Undulating colours effect that can simulate wavy waters and glowing embers.
+  Each step sets the next LED to a new colour (see waterStep()).
   
-  Parameters:
+  Parameters: (Arg1 - Arg7)
     redLow:I     - Lower limit of red (0 - 255)
     redHigh:I    - Upper limit of red (0 - 255)
     greenLow:I   - Lower limit of blue (0 - 255)
@@ -1517,20 +3030,78 @@ void twinkle(uint32_t backgroundColor,
           depth       = 5
           [delay]     = 3
   ----------------------------------------------------------------------------*/
-void waterAndEmbers( uint8_t redLow,  uint8_t greenLow,  uint8_t blueLow,
-                     uint8_t redHigh, uint8_t greenHigh, uint8_t blueHigh,
-                     uint8_t depth )
-{
-  static int16_t r = 0;
-  static int16_t g = 0;
-  static int16_t b = 0;
-  static int16_t led = 0;
-  static int16_t level = 0;
-  static int16_t changeCount = 0;
-  static int8_t levelDirection = 0;
-  int16_t wait;
+void waterAndEmbers(unsigned long now)
+{
+  unsigned long n = so->fxStep - so->fxLastStep;  // Steps since last frame
+  Uint8 args = so->stripArg1 + so->stripArg2 + so->stripArg3 +
+               so->stripArg4 + so->stripArg5 + so->stripArg6 +
+               so->stripArg7;
+
+  // The palette framebuffer's LEDs share the palette: fix its colours
+  // for the arguments, rather than cycling new colours through it.
+  if ( (so->palFb != NULL) &&
+       (so->newEffect || (args != so->fx.water.palArgs)) )
+  {
+    so->fx.water.palArgs = args;
+    waterPalette( so->stripArg1, so->stripArg2, so->stripArg3,
+                  so->stripArg4, so->stripArg5, so->stripArg6,
+                  so->stripArg7 );
+  }
+  if (n > so->numPix)
+    n = so->numPix;
+  while ( (n-- > 0) && !fxOverBudget() )
+  {
+    waterStep( so->stripArg1, so->stripArg2, so->stripArg3,
+               so->stripArg4, so->stripArg5, so->stripArg6,
+               so->stripArg7 );
+  }
+}
+
+// Clip a colour channel value of waterAndEmbers() to 0 - 255.
+int16_t waterClip(int16_t v)
+{
+  return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+// Fill palette entries 1 - 15 with random colours in waterAndEmbers()'s
+// ranges, each offset by a random level within the depth (for the
+// palette framebuffer; see waterStep()).
+void waterPalette( uint8_t redLow,  uint8_t greenLow,  uint8_t blueLow,
+                   uint8_t redHigh, uint8_t greenHigh, uint8_t blueHigh,
+                   uint8_t depth )
+{
+  int16_t r, g, b, level;
+
+  pixUseWheel(false);
+  for (Uint8 k = 1; k < PAL_RAM_LEN; k++)
+  {
+    level = random(-depth, depth);
+    r = random(redLow, redHigh);
+    g = random(greenLow, greenHigh);
+    b = random(blueLow, blueHigh);
+    r = waterClip((r > 0) ? r + level : r);
+    g = waterClip((g > 0) ? g + level : g);
+    b = waterClip((b > 0) ? b + level : b);
+    palSet(k, so->strip->Color(r,b,g));
+  }
+}
+
+// One step of waterAndEmbers(): set the next LED.
+void waterStep( uint8_t redLow,  uint8_t greenLow,  uint8_t blueLow,
+                uint8_t redHigh, uint8_t greenHigh, uint8_t blueHigh,
+                uint8_t depth )
+{
+  int16_t &r = so->fx.water.r;  // (The output's effect state)
+  int16_t &g = so->fx.water.g;
+  int16_t &b = so->fx.water.b;
+  int16_t &led = so->fx.water.led;
+  Uint8   &idx = so->fx.water.idx;  // Palette entry of the current colour
+  int16_t &level = so->fx.water.level;
+  int16_t &changeCount = so->fx.water.changeCount;
+  int8_t  &levelDirection = so->fx.water.levelDirection;
   int16_t r_old, g_old, b_old, level_old;
   uint8_t i;
+  Uint16  dist, best;           // Distance to the nearest palette colour
   bool change = true;
   
   if (change)
@@ -1583,7 +3154,6 @@ void waterAndEmbers( uint8_t redLow,  uint8_t greenLow,  uint8_t blueLow,
     while (abs(level_old - level) < 8)
       level += levelDirection * 3;
   }
-  wait = random(1, 1);
   change = (random(5) < 1);
   if (changeCount < 3)
   {
@@ -1595,150 +3165,340 @@ void waterAndEmbers( uint8_t redLow,  uint8_t greenLow,  uint8_t blueLow,
   if (change)
     changeCount = 0;
     
-  strip->setPixelColor(led, strip->Color(r,b,g));
-  led = (led + 1) % strip->numPixels();
-  strip->show();
-  nextFxTime = millis() + wait;
+  pixUseWheel(false);
+  if (so->palFb != NULL)
+  {
+    // Take the nearest of the fixed colours (see waterPalette())
+    best = 0xFFFF;
+    for (i = 1; i < PAL_RAM_LEN; i++)
+    {
+      dist = abs(so->palette[i][0] - r) + abs(so->palette[i][1] - b) +
+             abs(so->palette[i][2] - g);
+      if (dist < best)
+      {
+        best = dist;
+        idx = i;
+      }
+    }
+  }
+  else if ( (idx == 0) || (so->palette[idx][0] != r) ||
+            (so->palette[idx][1] != b) || (so->palette[idx][2] != g) )
+  {
+    // Each new colour takes the next of palette entries 1 - 15 (only
+    // the pixel buffer keeps the colour written).
+    if (++idx >= PAL_RAM_LEN)
+      idx = 1;
+    palSet(idx, so->strip->Color(r,b,g));
+  }
+  pixSetPal(led, idx);
+  led = (led + 1) % so->numPix;
 }
 
 
-// Fill the dots one after the other with a color
-void colorWipe(uint32_t c)
+// Fill the dots one after the other with a color, one dot per step
+void colorWipe(unsigned long now)
 {
-  static uint16_t i = 0;
+  uint16_t &i = so->fx.wipe.i;    // (The output's effect state)
+  Uint8 &idx = so->fx.wipe.idx;   // Palette entry (1 or 2) of the wipe colour
+  unsigned long n = so->fxStep - so->fxLastStep;  // Steps since last frame
 
-  if (newEffect)
+  pixUseWheel(false);
+  if (so->newEffect)
   {
     i = 0;
+    // Wipe the new colour over the old one, in the other palette entry
+    idx = (idx == 1) ? 2 : 1;
   }
-  
-  if (++i >= strip->numPixels())
-    i = 0;
+  palSet(idx, fxColour());
 
-  strip->setPixelColor(i, c);
-  strip->show();
+  if (n > so->numPix)
+    n = so->numPix;
+  while ( (n-- > 0) && !fxOverBudget() )
+  {
+    if (++i >= so->numPix)
+      i = 0;
+    pixSetPal(i, idx);
+  }
 }
 
 
-void rainbow(void)
+void rainbow(unsigned long now)
 {
-  static uint16_t j = 0;
+  Uint8 pos = (Uint8)so->fxStep;
   uint16_t i = 0;
-    
-  if (++j >= 256)
-    j = 0;  
-  
-  for(i = 0; i < strip->numPixels(); i++)
+
+  pixUseWheel(true);
+  for(i = 0; i < so->numPix; i++)
   {
-    strip->setPixelColor(i, Wheel( (i+j) & 255 ));
+    pixSetWheel(i, pos++);
   }
-  strip->show();
+  so->stripDirty = true;
 }
 
 
 // Slightly different, this makes the rainbow equally distributed throughout
-void rainbowCycle(void)
+void rainbowCycle(unsigned long now)
 {
-  static uint16_t j = 0;
+  uint16_t pos;   // Wheel position, 8.8 fixed point
+  uint16_t step;  // 256 / numPix, 8.8 fixed point
   uint16_t i;
-  
-  if (++j >- (256 * 3))
-    j = 0;
-    
-  // 3 cycles of all colors on wheel
-  for(i = 0; i < strip->numPixels(); i++)
+
+  pixUseWheel(true);
+  pos  = (uint16_t)(Uint8)so->fxStep << 8;
+  step = 0x10000UL / so->numPix;
+  for(i = 0; i < so->numPix; i++)
   {
-    strip->setPixelColor(i, Wheel(((i * 256 / strip->numPixels()) + j) & 255));
+    pixSetWheel(i, pos >> 8);
+    pos += step;
   }
-  strip->show();
+  so->stripDirty = true;
 }
 
 
-//Theatre-style crawling lights.
-void theaterChase(uint32_t c)
+//Theatre-style crawling lights. Every third pixel is on, moving on one
+//pixel per step.
+void theaterChase(unsigned long now)
 {
-  static uint16_t q = 0;
-  
-  for (int i = 0; i < strip->numPixels(); i = i+3)
-  {
-    //turn every third pixel off
-    strip->setPixelColor(i + q, 0);
-  }
+  Uint8 q = so->fxStep % 3;  // Lit pixel of each triple
+  Uint8 k = 0;
 
-  if (++q >= 3)
-    q = 0;
-    
-  for (int i = 0; i < strip->numPixels(); i = i+3)
+  pixUseWheel(false);
+  palSet(1, fxColour());
+  for (uint16_t i = 0; i < so->numPix; i++)
   {
-    //turn every third pixel on
-    strip->setPixelColor(i + q, c);
+    pixSetPal(i, (k == q) ? 1 : 0);
+    if (++k >= 3)
+      k = 0;
   }
-  strip->show();     
 }
 
 
-//Theatre-style crawling lights with rainbow effect
-void theaterChaseRainbow(void)
+//Theatre-style crawling lights with rainbow effect. The lights are on for
+//even steps and off for odd ones; the off frames are skipped (the cleared
+//pixels would only be shown with the next frame's lit ones).
+void theaterChaseRainbow(unsigned long now)
 {
-  static uint16_t q = 0;
-  static uint16_t j = 0;
-  static boolean ledsOn = false;
-  
-  ledsOn = !ledsOn;
-  
-  if (ledsOn)
+  Uint8 q = (so->fxStep / 2) % 3;       // Lit pixel of each triple
+  Uint8 j = (Uint8)(so->fxStep / 6);    // Wheel offset
+  Uint8 k = 0;
+
+  if (so->fxStep & 1)
+    return;
+
+  pixUseWheel(true);
+  for (uint16_t i = 0; i < so->numPix; i++)
   {
-     for (int i = 0; i < strip->numPixels(); i = i+3)
-     {
-       //turn every third pixel off
-       strip->setPixelColor(i + q, Wheel( (i+j) % 255));
-     }
-     strip->show();
+    if (k == q)
+      pixSetWheel(i, (uint16_t)(i - q + j) % 255);
+    else
+      pixClear(i);
+    if (++k >= 3)
+      k = 0;
   }
+  so->stripDirty = true;
+}
+
+
+// Has the frame being rendered used up its FX_RENDER_BUDGET_US? (Effects
+// that catch up on several steps in a frame stop there, skipping the rest.)
+bool fxOverBudget()
+{
+  return (micros() - fxRenderStart) >= FX_RENDER_BUDGET_US;
+}
+
+
+// Account for a frame of so's that took renderUs to render, and stretch
+// (or shrink) so's frame interval so that the frames of all the outputs,
+// with their show() calls, leave FX_RADIO_DUTY_PCT of the time to the
+// rest of loop().
+void fxFrameDone(unsigned long renderUs)
+{
+  unsigned long interval;
+
+  fxFrames++;
+  if (renderUs > FX_RENDER_BUDGET_US)
+    fxOverruns++;
+
+  renderUs += so->showLast;
+  if (so->fxCost == 0)
+    so->fxCost = renderUs;
   else
-  {
-     for (int i = 0; i < strip->numPixels(); i = i+3)
-     {
-       //turn every third pixel on
-       strip->setPixelColor(i + q, 0);
-     }
-     
-     if (++q >= 3)
-     {
-       q = 0;
-       if (++j >= 256)
-         j = 0;
-     }
-  }
+    so->fxCost = (so->fxCost * 3 + renderUs) / 4;  // Smooth the cost
+  interval = (so->fxCost * numOuts) / (10UL * (100 - FX_RADIO_DUTY_PCT));
+  so->fxInterval = (interval > FX_MAX_INTERVAL_MS) ? FX_MAX_INTERVAL_MS
+                                                   : interval;
 }
 
 
-// Input a value 0 to 255 to get a color value.
-// The colours are a transition r - g - b - back to r.
-uint32_t Wheel(byte WheelPos)
+// Colour given by the effect's Red, Green and Blue arguments (Arg1 - 3).
+uint32_t fxColour()
 {
-  if(WheelPos < 85)
-  {
-   return strip->Color(WheelPos * 3, 255 - WheelPos * 3, 0);
-  }
-  else if(WheelPos < 170)
+  return so->strip->Color(so->stripArg1, so->stripArg3, so->stripArg2);
+}
+
+
+// Effect registry, indexed by effect number (Port 2 / 10). rate is the
+// number of steps per [Delay] ms; a restart effect starts afresh on any
+// parameter change, not just on a new effect.
+const FxDef_t fxTable[NUM_STRIP_FX] PROGMEM = {
+  // render              rate  restart  name
+  { NULL,                  1,  false,   "" },
+  { colorWipe,             1,  true,    "Colour Wipe" },
+  { rainbow,               1,  false,   "Rainbow" },
+  { rainbowCycle,          1,  false,   "Rainbow Cycle" },
+  { theaterChase,          1,  false,   "Theatre Chase" },
+  { theaterChaseRainbow,   4,  false,   "Theatre Chase Rainbow" },
+  { waterAndEmbers,        1,  false,   "Water and Embers" },
+  { twinkle,               1,  true,    "Twinkle" },
+  { NULL,                  1,  false,   "Ember Effect" }
+};
+
+
+// Advance so's effect step, so->fxStep, to time now: rate steps per
+// stripDelay ms, counted in 24.8 fixed point from the last rebase. The
+// step follows the clock, not the number of frames rendered, so the speed
+// is exact whatever the strip length or loop() rate.
+// Every FX_REBASE_MS, fxStart is moved on by a whole number of [Delay]s
+// (to keep the product in range without rounding the step), and if rebase,
+// the clock is rebased at time now (before the speed changes).
+void fxClock(unsigned long now, bool rebase)
+{
+  unsigned long elapsed = now - so->fxStart;
+  unsigned long pos;  // Steps since fxStart (+ fxFrac), 24.8 fixed point
+  unsigned long whole;
+  Uint8 rate = 1;
+
+  if ((long)elapsed < 0)
+    elapsed = 0;      // (The timebase was pulled back a little)
+  if (so->stripEffect < NUM_STRIP_FX)
+    rate = pgm_read_byte(&fxTable[so->stripEffect].rate);
+  if (so->stripDelay == 0)
+    pos = so->fxFrac;  // (LEDs off: the clock stands still)
+  else
+    pos = so->fxFrac + ((elapsed << 8) * rate) / so->stripDelay;
+  so->fxStep = so->fxBase + (pos >> 8);
+
+  if (rebase)
   {
-   WheelPos -= 85;
-   return strip->Color(255 - WheelPos * 3, 0, WheelPos * 3);
+    so->fxBase  = so->fxStep;
+    so->fxFrac  = (Uint8)pos;
+    so->fxStart = now;
   }
-  else
+  else if ( (elapsed >= FX_REBASE_MS) && (so->stripDelay != 0) )
   {
-   WheelPos -= 170;
-   return strip->Color(0, WheelPos * 3, 255 - WheelPos * 3);
+    whole = elapsed / so->stripDelay;
+    so->fxStart += whole * so->stripDelay;
+    so->fxBase  += whole * rate;
   }
 }
 
 
+// Restart so's effect, with its clock at step 0 at time now.
+void fxRestart(unsigned long now)
+{
+  so->newEffect  = true;
+  so->fxStart    = now;
+  so->fxBase     = 0;
+  so->fxFrac     = 0;
+  so->fxLastStep = (unsigned long)-1;
+}
+
+
 /***************************************************************************
  ***************************************************************************/
 
 
 
+// Show the loop() rate and the strip show() rate and duration since the
+// last call, then reset the statistics.
+void showLoopStats()
+{
+  unsigned long elapsed = millis() - statsStart;
+  unsigned long levels = 0;  // Channel levels of all the outputs' frames
+
+  logPrint(FLASH("Loop passes: "));
+  logPrint(loopCount);
+  logPrint(FLASH(" ("));
+  logPrint((elapsed >= 100) ? (loopCount * 10) / (elapsed / 100) : 0);
+  logPrint(FLASH("/s)  show(): "));
+  logPrint(showCount);
+  logPrint(FLASH(" ("));
+  logPrint((elapsed >= 100) ? (showCount * 10) / (elapsed / 100) : 0);
+  logPrint(FLASH("/s, avg "));
+  logPrint(showCount ? showTotal / showCount : 0);
+  logPrint(FLASH("us)  in "));
+  logPrint(elapsed);
+  logPrintln(FLASH("ms"));
+  logPrint(FLASH("Run frames (since reset): "));
+  logPrint(showWin.frames);
+  logPrint(FLASH(", missed since the last telemetry report "));
+  logPrint(telem.missed);
+  logPrint(FLASH(", period "));
+  logPrint(showWin.period);
+  logPrint(FLASH("us  Frames held back: "));
+  logPrint(showWin.deferred);
+  logPrint(FLASH(", shown across a run frame: "));
+  logPrintln(showWin.overlaps);
+  logPrint(FLASH("Timebase: "));
+  if (tb.locked)
+  {
+    logPrint(FLASH("locked, drift "));
+    logPrint((tb.drift * 15625L) / 262144L);  // (x 10^6 / 2^24)
+    logPrint(FLASH("ppm, stepped "));
+    logPrintln(tb.steps);
+  }
+  else
+    logPrintln(FLASH("free running"));
+  if (pixStream.frames != 0)
+  {
+    logPrint(FLASH("Pixel stream: pages "));
+    logPrint(pixStream.pages);
+    logPrint(FLASH(", frames "));
+    logPrint(pixStream.frames);
+    logPrint(FLASH(" ("));
+    logPrint((elapsed >= 100) ? (pixStream.frames * 10) / (elapsed / 100) : 0);
+    logPrint(FLASH("/s, "));
+    logPrint(pixStream.partial);
+    logPrint(FLASH(" with pages lost), pixels/s "));
+    logPrintln((elapsed >= 100) ? (pixStream.pixels * 10) / (elapsed / 100) : 0);
+    pixStream.pages = pixStream.frames = pixStream.partial = 0;
+    pixStream.pixels = 0;
+  }
+  logPrint(FLASH("Effect frames: "));
+  logPrint(fxFrames);
+  logPrint(FLASH(" ("));
+  logPrint((elapsed >= 100) ? (fxFrames * 10) / (elapsed / 100) : 0);
+  logPrint(FLASH("/s), over budget: "));
+  logPrintln(fxOverruns);
+  for (Uint8 s = 0; s < numOuts; s++)
+  {
+    so = outs[s];
+    levels += outLevelSum();
+    logPrint(FLASH("  Output "));
+    logPrint(s + 1);
+    logPrint(FLASH(": frame "));
+    logPrint(outs[s]->fxCost);
+    logPrint(FLASH("us, every "));
+    logPrint(outs[s]->fxInterval);
+    logPrintln(FLASH("ms min"));
+  }
+  logPrint(FLASH("Strip current: "));
+  logPrint((levels * pwrMaPerChan) / 255);
+  logPrint(FLASH("mA est., budget "));
+  logPrint(pwrBudget);
+  logPrint(FLASH("mA, limit "));
+  logPrint((pwrScale * 100) >> 8);
+  logPrint(FLASH("%, frames limited: "));
+  logPrintln(pwrLimited);
+
+  showWin.deferred = showWin.overlaps = 0;
+  loopCount = showCount = showTotal = 0;
+  fxFrames = fxOverruns = 0;
+  pwrLimited = 0;
+  statsStart += elapsed;
+}
+
+
 /***************************************************************************
  * Test how much RAM is left on the MPU, printing the results out to
  * the serial port.
@@ -1765,6 +3525,62 @@ void CheckRam()
 }
 
 
+// Set up strip output s: a strip of len LEDs on pin. Returns false if
+// there's no RAM for it.
+bool stripOutInit(Uint8 s, Int8 pin, Uint16 len)
+{
+  so = (StripOut_t *)calloc(1, sizeof(StripOut_t));
+  if (so == NULL)
+  {
+    logPrintln(FLASH("ERROR: No RAM for a strip output"));
+    return false;
+  }
+  outs[s] = so;
+  so->pin = pin;
+  so->scale = ((unsigned long)outScale * pwrScale) >> 8;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+
+  #ifdef PALETTE_FB_ENABLED
+    // An 800 KHz strip is driven from the palette framebuffer, sent by
+    // palShow(). Its library strip object is just 1 pixel long: it's used
+    // for Color() and to find the wire order.
+    // Only the segment map's logical pixels take framebuffer RAM.
+    if ( (ledStripFreq == 8) && (len >= 1) )
+    {
+      segConfigure(len);
+      so->palFb = (Uint8 *)calloc(so->numPix, 1);
+    }
+  #endif
+  if (so->palFb != NULL)
+  {
+    so->strip = new Adafruit_NeoPixel( 1, (uint8_t)pin,
+                                       (ledStripWiring + ledStripFreq) );
+  }
+  else if ( (len >= 1) && (len <= STRIP_MAX_LEN_RGB) )
+  {
+    // Apparently valid configuration parameters
+    so->strip = new Adafruit_NeoPixel( len, (uint8_t)pin,
+                                       (ledStripWiring + ledStripFreq) );
+  }
+  else
+  {
+    // Configuration parameters appear questionable. Create a default strip.
+    so->strip = new Adafruit_NeoPixel( 1, NEO_PIN, NEO_GRB + NEO_KHZ800 );
+  }
+
+  // (numPixels() is 0 if the library couldn't allocate its pixel buffer)
+  if (so->palFb == NULL)
+    segConfigure(so->strip->numPixels());
+  if (so->numPix == 0)
+  {
+    logPrint(FLASH("ERROR: No RAM for the pixels of LED strip output "));
+    logPrintln(s + 1);
+  }
+  return true;
+}
+
+
 void setup()
 {
   Serial.begin(SERIAL_BAUD);
@@ -1779,16 +3595,11 @@ void setup()
   radio.promiscuous(promiscuousMode);
   currReadPos = 0;
   for (Uint8 i = 0; i < RF69_MAX_DATA_LEN; i++)
-    buffer[i] = 0;
+    txPkt[i] = 0;
   
-  for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
+  for (Uint8 i = 0; i < NUM_PIXEL_PORTS; i++)
   {
-    nodeMap[i].port = -1;
-  }
-  
-  for (Uint8 i = 0; i < MAX_PORTS; i++)
-  {
-    portToDmxwMap[i] = 0;
+    nodeMap[i].dmxwChan = 0;
   }
 
   resetCount = EEPROM.read(1023) + 1;
@@ -1859,33 +3670,192 @@ void setup()
     ledStripFlags += NEO_KHZ800;
   else
     ledStripFlags += NEO_KHZ400;
-  if (ledStripLen >= 1)
+
+  // Output 1 is the strip set up with "led" and "ledCtrl"; the
+  // configured outputs after it follow.
+  numOuts = 0;
+  if (stripOutInit(0, ledStripCtrlPin, ledStripLen))
   {
-    // Apparently valid configuration parameters
-    strip = new Adafruit_NeoPixel( ledStripLen, (uint8_t)ledStripCtrlPin,
-                                   (ledStripWiring + ledStripFreq) );
+    numOuts = 1;
+    while ( (numOuts < MAX_STRIP_OUTPUTS) && (ledOutLen[numOuts - 1] >= 1) &&
+            stripOutInit(numOuts, ledOutPin[numOuts - 1],
+                         ledOutLen[numOuts - 1]) )
+      numOuts++;
+
+    // Probe the strips' wire order: see where the library puts the red,
+    // green and blue bytes of a pixel.
+    so = outs[0];
+    so->strip->setPixelColor(0, so->strip->Color(1, 2, 3));
+    for (Uint8 i = 0; i < 3; i++)
+    {
+      switch (so->strip->getPixels()[i])
+      {
+        case 1: pixOffsRed   = i; break;
+        case 2: pixOffsGreen = i; break;
+        case 3: pixOffsBlue  = i; break;
+      }
+    }
+    so->strip->setPixelColor(0, 0);
   }
-  else
+    
+  pinMode(9, OUTPUT);
+}
+
+
+// Run strip output s's effect, as set by its block of ports.
+void stripService(Uint8 s)
+{
+  Uint8 base = s * PIXEL_BLOCK_PORTS;  // Port index of the output's block
+  FxRender_t render = NULL;
+  const char *name = NULL;
+
+  so = outs[s];
+  currentTime = tbNow();
+
+  // Output 1 shows streamed pixels instead, until they stop coming
+  if ( (s == 0) && pixStream.active )
   {
-    // Configuration parameters appear questionable. Create a default strip.
-    strip = new Adafruit_NeoPixel( 1, NEO_PIN, NEO_GRB + NEO_KHZ800 );
+    if ((millis() - pixStream.lastPage) < PIX_TIMEOUT_MS)
+      return;
+    logPrintln(FLASH("Pixel streaming stopped"));
+    pixStream.active = false;
+    so->palRgb = false;
+    so->levelStale = true;
+    so->stripBlank = false;
+    fxRestart(currentTime);
   }
+
+  /* Override parameter changes if Delay is 255 */
+  if (portValue(base + 0) == 255)
+  {
+    so->stripParamChange = false;
+  }
+  
+  if (so->stripParamChange)
+  {
+    // Carry on from the current step at the new speed. (Changes arrive
+    // in run frames: time them by the frame, the same on every node.)
+    fxClock(tb.frameTime, true);
     
-  pinMode(9, OUTPUT);
+    // Block ports 1..9 --> strip parameters (0 if the port isn't mapped)
+    so->stripDelay  = portValue(base + 0);
+    so->stripEffect = portValue(base + 1) / 10;
+    so->stripArg1   = portValue(base + 2);
+    so->stripArg2   = portValue(base + 3);
+    so->stripArg3   = portValue(base + 4);
+    so->stripArg4   = portValue(base + 5);
+    so->stripArg5   = portValue(base + 6);
+    so->stripArg6   = portValue(base + 7);
+    so->stripArg7   = portValue(base + 8);
+
+    if (numOuts > 1)
+    {
+      logPrint(FLASH("Output "));
+      logPrint(s + 1);
+      logPrint(FLASH(": "));
+    }
+    if (so->stripEffect < NUM_STRIP_FX)
+      name = fxTable[so->stripEffect].name;
+    if ( (name != NULL) && (pgm_read_byte(name) != 0) )
+      logPrint((const __FlashStringHelper *)name);
+    else
+    {
+      logPrint("<unknown effect (");
+      logPrint(so->stripEffect);
+      logPrint (")>");
+    }
+    logPrint(": Delay="); logPrint(so->stripDelay);
+    logPrint("  (");
+    logPrint(so->stripArg1);
+    logPrint(", ");
+    logPrint(so->stripArg2);
+    logPrint(", ");
+    logPrint(so->stripArg3);
+    logPrint(", ");
+    logPrint(so->stripArg4);
+    logPrint(", ");
+    logPrint(so->stripArg5);
+    logPrint(", ");
+    logPrint(so->stripArg6);
+    logPrint(", ");
+    logPrint(so->stripArg7);
+    logPrintln(")");
+    
+    if (so->stripEffect != so->oldStripEffect)
+    {
+      so->oldStripEffect = so->stripEffect;
+      so->newEffect = true;
+      memset(&so->fx, 0, sizeof(so->fx));  // Start the effect afresh
+    }
+    else
+    {
+      if ( (so->stripEffect < NUM_STRIP_FX) &&
+           pgm_read_byte(&fxTable[so->stripEffect].restart) )
+      {
+        so->newEffect = true;
+      }
+    }
+    if (so->newEffect)
+      fxRestart(tb.frameTime);
+    so->stripParamChange = false;
+  }
+  fxClock(currentTime, false);
+
+  if ( disableEffects || (so->stripDelay == 0) || (so->numPix == 0) )
+  {
+    // Turn off all LEDs (once)
+    if (!so->stripBlank)
+    {
+      for(Uint16 i = 0; i < so->numPix; i++)
+      {
+        pixSetPal(i, 0);
+      }
+      so->stripBlank = true;
+    }
+  }
+  else
+  {
+    so->stripBlank = false;
+    /* Continue running the current effect: render a frame if it has moved
+       on a step, and the frame interval is up. (Steps the loop() fell
+       behind on are skipped, rather than slowing the effect down.) */
+    if (so->stripEffect < NUM_STRIP_FX)
+      render = (FxRender_t)pgm_read_word(&fxTable[so->stripEffect].render);
+    if ( (render != NULL) &&
+         ( so->newEffect ||
+           ( (so->fxStep != so->fxLastStep) &&
+             (currentTime - so->fxLastFrame >= so->fxInterval) ) ) )
+    {
+      fxRenderStart = micros();
+      render(currentTime);
+      fxFrameDone(micros() - fxRenderStart);
+      so->fxLastStep = so->fxStep;
+      so->fxLastFrame = currentTime;
+    }
+    so->newEffect = false;
+  }
 }
 
 
 void loop()
 {
+  unsigned long loopStart = micros();
+  unsigned long rxTimeUs;
+
   handleInput = false;
   bufSize = 0;
   dataToSend = false;
   requestAck = true;
   ackBuf[0] = ACK_ERR;
+  ackLen = 1;
   
   // Handle incoming messages.
   if (radio.receiveDone())
   {
+    // Any packet after a run frame (normally the telemetry poll) ends the
+    // wait for the poll.
+    rxTimeUs = micros();
+    showWin.holdOff = 0;
     // Determine if the message is aimed at us.
     dstNodeId = radio.TARGETID;
     srcNodeId = radio.SENDERID;
@@ -1893,14 +3863,17 @@ void loop()
     if ( ( (dstNodeId == myNodeId) && (dstNodeId > NODEID_UNDEF) ) ||
          ( (dstNodeId == BROADCASTID) && (srcNodeId == GATEWAYID) ) )
     {
-      if ( (radio.DATA[0] == srcNodeId) && (radio.DATA[1] == dstNodeId))
+      if ( (radio.DATALEN > DMXW_HDR_LEN) && DMXW_HDR_OK(radio.DATA[0]) )
       {
-        bufSize = radio.DATALEN - 2;
-        if (bufSize <= (MAX_DMXW_CHANS + 1))
+        rxSize = radio.DATALEN - DMXW_HDR_LEN;
+        if ( (rxSize <= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN + RUN_TB_LEN)) ||
+             ( (radio.DATA[DMXW_HDR_LEN] == CMD_PIX) &&
+               (rxSize <= 3 + PIX_PAGE_LEN) ) )
         {
           handleInput = true;
           ackRequested = radio.ACK_REQUESTED;
-          memcpy(buffer, (const void *)&radio.DATA[2], bufSize);
+          rxHdr = radio.DATA[0];
+          rxBuf = (const Uint8 *)&radio.DATA[DMXW_HDR_LEN];
         }
         else
         {
@@ -1909,14 +3882,10 @@ void loop()
       }
       else
       {
-//JVS??
-        bufSize = radio.DATALEN - 2;
-        memcpy(buffer, (const void *)&radio.DATA[2], bufSize);
-//
-        logPrint(FLASH("*** RX corrupt pkt; dropped. ["));
-        for (int i = 0; i < bufSize; i++)
+        logPrint(FLASH("*** RX bad pkt header; dropped. ["));
+        for (int i = 0; i < radio.DATALEN; i++)
         {
-          logPrint(buffer[i]);
+          logPrint(radio.DATA[i]);
           logPrint(FLASH("  "));
         }
         logPrintln(FLASH("]"));
@@ -1931,8 +3900,8 @@ void loop()
       dbgPrint(dstNodeId);
       dbgPrintln(FLASH(")"));
 //JVS??  vvv
-/*        bufSize = radio.DATALEN - 2;
-        memcpy(buffer, (const void *)&radio.DATA[2], 30);
+/*        bufSize = radio.DATALEN - DMXW_HDR_LEN;
+        memcpy(buffer, (const void *)&radio.DATA[DMXW_HDR_LEN], 30);
 */
       logPrintln(FLASH(" ... ignored (pkt not for me)"));
 /*
@@ -1972,20 +3941,44 @@ logPrintln("]");
     {
       rxTime = millis();
       currReadPos = 0;
-      command = buffer[currReadPos++];
+      command = rxBuf[currReadPos++];
 
       dbgPrint(FLASH("Cmd["));
       printCommand(command);
       dbgPrint("] ");
       rxCount++;
-      ackBuf[0] = (Uint8) handleNetRxMessage(command);
+      if ( ackRequested && (srcNodeId == GATEWAYID) &&
+           (rxHdr & DMXW_HDR_RETRY) && (DMXW_HDR_SEQ(rxHdr) == lastGwSeq) )
+      {
+        // A retransmission of the command just handled: our ACK was lost.
+        // Re-send the ACK, but don't execute the command a second time.
+        dbgPrint(FLASH("(dup) "));
+        ackBuf[0] = lastAckCode;
+        ackLen = lastAckLen;
+      }
+      else
+      {
+        ackBuf[0] = (Uint8) handleNetRxMessage(command);
+      }
+      if (srcNodeId == GATEWAYID)
+      {
+        lastGwSeq = DMXW_HDR_SEQ(rxHdr);
+        lastAckCode = ackBuf[0];
+        lastAckLen = ackLen;
+        telemGatewayPkt();
+        if (command == CMD_RUN)
+        {
+          showWinRunFrame(rxTimeUs);
+          tbRunFrame(millis() - (micros() - rxTimeUs) / 1000);
+        }
+      }
 
       dbgPrint(FLASH("  Result["));
       printAckResult(ackBuf[0]);
       dbgPrintln("]");
       if (ackRequested)
       {
-        radio.sendACK(ackBuf, 1);
+        radio.sendACK(ackBuf, ackLen);
         dbgPrint(FLASH("ACK sent["));
         dbgPrint(millis() - rxTime);
         dbgPrintln("]");
@@ -2006,13 +3999,9 @@ logPrintln("]");
   if (dataToSend)
   {
 //JVS??
-    if ((bufSize + 2) <= RF69_MAX_DATA_LEN)
+    if (bufSize <= TXBUF_LEN)
     {
       ackTime = millis();
-      memmove(&buffer[2], buffer, bufSize);
-      bufSize += 2;
-      buffer[0] = myNodeId;
-      buffer[1] = node;
       ackBuf[0] = sendBuffer(node, buffer, bufSize, requestAck);
       dbgPrint(FLASH(" RxAck["));
       dbgPrint(millis() - ackTime);
@@ -2048,201 +4037,13 @@ logPrintln("]");
     }
   }
 
-  /* Override parameter changes if Delay is 255 */
-  if (nodeMap[portToDmxwMap[0]-1].value == 255)
-  {
-    stripParamChange = false;
-  }
-  
-  if (stripParamChange)
-  {
-    Uint8 tmpDmxwChan;
-    
-    tmpDmxwChan = portToDmxwMap[0];  // Port 1 --> DMXW chan #
-    if (tmpDmxwChan == 0)
-      stripDelay = 0;
-    else
-      stripDelay = nodeMap[tmpDmxwChan-1].value;
-      
-    tmpDmxwChan = portToDmxwMap[1];
-    if (tmpDmxwChan == 0)
-      stripEffect = 0;
-    else
-      stripEffect = nodeMap[tmpDmxwChan-1].value / 10;
-      
-    tmpDmxwChan = portToDmxwMap[2];
-    if (tmpDmxwChan == 0)
-      stripArg1 = 0;
-    else
-      stripArg1 = nodeMap[tmpDmxwChan-1].value;
-      
-    tmpDmxwChan = portToDmxwMap[3];
-    if (tmpDmxwChan == 0)
-      stripArg2 = 0;
-    else
-      stripArg2 = nodeMap[tmpDmxwChan-1].value;
-      
-    tmpDmxwChan = portToDmxwMap[4];
-    if (tmpDmxwChan == 0)
-      stripArg3 = 0;
-    else
-      stripArg3 = nodeMap[tmpDmxwChan-1].value;
+  for (Uint8 i = 0; i < numOuts; i++)
+    stripService(i);
 
-    tmpDmxwChan = portToDmxwMap[5];
-    if (tmpDmxwChan == 0)
-      stripArg4 = 0;
-    else
-      stripArg4 = nodeMap[tmpDmxwChan-1].value;
-
-    tmpDmxwChan = portToDmxwMap[6];
-    if (tmpDmxwChan == 0)
-      stripArg5 = 0;
-    else
-      stripArg5 = nodeMap[tmpDmxwChan-1].value;
+  stripShow();
 
-    tmpDmxwChan = portToDmxwMap[7];
-    if (tmpDmxwChan == 0)
-      stripArg6 = 0;
-    else
-      stripArg6 = nodeMap[tmpDmxwChan-1].value;
-
-    tmpDmxwChan = portToDmxwMap[8];
-    if (tmpDmxwChan == 0)
-      stripArg7 = 0;
-    else
-      stripArg7 = nodeMap[tmpDmxwChan-1].value;
-
- 
-    switch (stripEffect)
-    {
-      case 1: logPrint("Colour Wipe");            break;
-      case 2: logPrint("Rainbow");                break;
-      case 3: logPrint("Rainbow Cycle");          break;
-      case 4: logPrint("Theatre Chase");          break;
-      case 5: logPrint("Theatre Chase Rainbow");  break;
-      case 6: logPrint("Water and Embers");       break;
-      case 7: logPrint("Twinkle");                break;
-      case 8: logPrint("Ember Effect");           break;
-      default:
-        logPrint("<unknown effect (");
-        logPrint(stripEffect);
-        logPrint (")>");
-    }
-    logPrint(": Delay="); logPrint(stripDelay);
-    logPrint("  (");
-    logPrint(stripArg1);
-    logPrint(", ");
-    logPrint(stripArg2);
-    logPrint(", ");
-    logPrint(stripArg3);
-    logPrint(", ");
-    logPrint(stripArg4);
-    logPrint(", ");
-    logPrint(stripArg5);
-    logPrint(", ");
-    logPrint(stripArg6);
-    logPrint(", ");
-    logPrint(stripArg7);
-    logPrintln(")");
-    
-    if (stripEffect != oldStripEffect)
-    {
-      oldStripEffect = stripEffect;
-      newEffect = true;
-    }
-    else
-    {
-      if ( ((stripEffect == 1) || (stripEffect == 7))
-           && stripParamChange)
-      {
-        newEffect = true;
-      }
-    }
-    stripParamChange = false;
-  }
-
-  if ( disableEffects || (stripDelay == 0) )
-  {
-    // Turn off all LEDs
-    for(Uint16 i = 0; i < strip->numPixels(); i++)
-    {
-      strip->setPixelColor(i, 0);
-    }
-    strip->show();
-  }
-  else
-  {
-    /* Continue running the current effect */
-    currentTime = millis();
-    if (currentTime >= nextFxTime)
-    {
-      switch (stripEffect)
-      {
-        case 1:
-          colorWipe(strip->Color(stripArg1, stripArg3, stripArg2));
-          break;
-  
-        case 2:
-          rainbow();
-          break;
-      
-        case 3:
-          rainbowCycle();
-          break;
-      
-        case 4:
-          theaterChase(strip->Color(stripArg1, stripArg3, stripArg2));
-          break;
-      
-        case 5:
-          theaterChaseRainbow();
-          break;
-      
-        case 6:
-          waterAndEmbers( stripArg1, stripArg2,
-                          stripArg3, stripArg4,
-                          stripArg5, stripArg6,
-                          stripArg7 );
-          break;
-          
-        case 7:
-          if (newEffect)
-          {
-            if (stripArg4 == 0)
-              stripArg4 = 1;
-            if (stripArg5 == 0)
-              stripArg5 = 100;
-            else if (stripArg5 == 1)
-              stripArg5 = 2;
-            if (stripArg6 == 0)
-              stripArg6 = 5;
-            if (stripArg6 > ledStripLen)
-              stripArg6 = ledStripLen;
-            if (stripArg7 == 0)
-              stripArg7 = 20;
-            if (stripArg4 >= stripArg5)
-              stripArg4 = stripArg5 - 1;
-            stripDelay = 1;
-          }
-          twinkle(strip->Color(stripArg1, stripArg3, stripArg2),
-                  stripArg4*10, stripArg5*10, stripArg6, stripArg7);
-          break;
-      
-        default:
-          ; // Ignore unknown Effect value
-      }
-      newEffect = false;
-      
-      switch (stripEffect)
-      {
-        case 5:
-          nextFxTime = currentTime + stripDelay/4;
-          break;
-          
-        default:
-          nextFxTime = currentTime + stripDelay;
-      }
-    }
-  }
-  
+  loopCount++;
+  loopStart = micros() - loopStart;
+  if (loopStart > telem.loopMax)
+    telem.loopMax = loopStart;
 }
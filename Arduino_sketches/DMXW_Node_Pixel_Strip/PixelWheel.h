@@ -0,0 +1,92 @@
+/* PixelWheel.h */
+#ifndef PixelWheel_h
+#define PixelWheel_h
+
+/*************************************************************************
+ * Colour wheel for the addressable LED strip effects.
+ *
+ * Maps a wheel position (0..255) to an { r, g, b } colour, stored in
+ * flash. The colours are a transition r - g - b - back to r. The table
+ * was generated offline from the Wheel() function it replaces, with
+ * p = wheel position:
+ *     p <  85:  ( 3p,          255 - 3p,     0            )
+ *     p < 170:  ( 255 - 3q,    0,            3q           ), q = p - 85
+ *     else:     ( 0,           3q,           255 - 3q     ), q = p - 170
+ *************************************************************************/
+
+#include <avr/pgmspace.h>
+#include "DMXWNet.h"
+
+#define WHEEL_RED    0
+#define WHEEL_GREEN  1
+#define WHEEL_BLUE   2
+
+const Uint8 wheelTable[256][3] PROGMEM =
+{
+  {   0, 255,   0 }, {   3, 252,   0 }, {   6, 249,   0 }, {   9, 246,   0 },  //   0
+  {  12, 243,   0 }, {  15, 240,   0 }, {  18, 237,   0 }, {  21, 234,   0 },  //   4
+  {  24, 231,   0 }, {  27, 228,   0 }, {  30, 225,   0 }, {  33, 222,   0 },  //   8
+  {  36, 219,   0 }, {  39, 216,   0 }, {  42, 213,   0 }, {  45, 210,   0 },  //  12
+  {  48, 207,   0 }, {  51, 204,   0 }, {  54, 201,   0 }, {  57, 198,   0 },  //  16
+  {  60, 195,   0 }, {  63, 192,   0 }, {  66, 189,   0 }, {  69, 186,   0 },  //  20
+  {  72, 183,   0 }, {  75, 180,   0 }, {  78, 177,   0 }, {  81, 174,   0 },  //  24
+  {  84, 171,   0 }, {  87, 168,   0 }, {  90, 165,   0 }, {  93, 162,   0 },  //  28
+  {  96, 159,   0 }, {  99, 156,   0 }, { 102, 153,   0 }, { 105, 150,   0 },  //  32
+  { 108, 147,   0 }, { 111, 144,   0 }, { 114, 141,   0 }, { 117, 138,   0 },  //  36
+  { 120, 135,   0 }, { 123, 132,   0 }, { 126, 129,   0 }, { 129, 126,   0 },  //  40
+  { 132, 123,   0 }, { 135, 120,   0 }, { 138, 117,   0 }, { 141, 114,   0 },  //  44
+  { 144, 111,   0 }, { 147, 108,   0 }, { 150, 105,   0 }, { 153, 102,   0 },  //  48
+  { 156,  99,   0 }, { 159,  96,   0 }, { 162,  93,   0 }, { 165,  90,   0 },  //  52
+  { 168,  87,   0 }, { 171,  84,   0 }, { 174,  81,   0 }, { 177,  78,   0 },  //  56
+  { 180,  75,   0 }, { 183,  72,   0 }, { 186,  69,   0 }, { 189,  66,   0 },  //  60
+  { 192,  63,   0 }, { 195,  60,   0 }, { 198,  57,   0 }, { 201,  54,   0 },  //  64
+  { 204,  51,   0 }, { 207,  48,   0 }, { 210,  45,   0 }, { 213,  42,   0 },  //  68
+  { 216,  39,   0 }, { 219,  36,   0 }, { 222,  33,   0 }, { 225,  30,   0 },  //  72
+  { 228,  27,   0 }, { 231,  24,   0 }, { 234,  21,   0 }, { 237,  18,   0 },  //  76
+  { 240,  15,   0 }, { 243,  12,   0 }, { 246,   9,   0 }, { 249,   6,   0 },  //  80
+  { 252,   3,   0 }, { 255,   0,   0 }, { 252,   0,   3 }, { 249,   0,   6 },  //  84
+  { 246,   0,   9 }, { 243,   0,  12 }, { 240,   0,  15 }, { 237,   0,  18 },  //  88
+  { 234,   0,  21 }, { 231,   0,  24 }, { 228,   0,  27 }, { 225,   0,  30 },  //  92
+  { 222,   0,  33 }, { 219,   0,  36 }, { 216,   0,  39 }, { 213,   0,  42 },  //  96
+  { 210,   0,  45 }, { 207,   0,  48 }, { 204,   0,  51 }, { 201,   0,  54 },  // 100
+  { 198,   0,  57 }, { 195,   0,  60 }, { 192,   0,  63 }, { 189,   0,  66 },  // 104
+  { 186,   0,  69 }, { 183,   0,  72 }, { 180,   0,  75 }, { 177,   0,  78 },  // 108
+  { 174,   0,  81 }, { 171,   0,  84 }, { 168,   0,  87 }, { 165,   0,  90 },  // 112
+  { 162,   0,  93 }, { 159,   0,  96 }, { 156,   0,  99 }, { 153,   0, 102 },  // 116
+  { 150,   0, 105 }, { 147,   0, 108 }, { 144,   0, 111 }, { 141,   0, 114 },  // 120
+  { 138,   0, 117 }, { 135,   0, 120 }, { 132,   0, 123 }, { 129,   0, 126 },  // 124
+  { 126,   0, 129 }, { 123,   0, 132 }, { 120,   0, 135 }, { 117,   0, 138 },  // 128
+  { 114,   0, 141 }, { 111,   0, 144 }, { 108,   0, 147 }, { 105,   0, 150 },  // 132
+  { 102,   0, 153 }, {  99,   0, 156 }, {  96,   0, 159 }, {  93,   0, 162 },  // 136
+  {  90,   0, 165 }, {  87,   0, 168 }, {  84,   0, 171 }, {  81,   0, 174 },  // 140
+  {  78,   0, 177 }, {  75,   0, 180 }, {  72,   0, 183 }, {  69,   0, 186 },  // 144
+  {  66,   0, 189 }, {  63,   0, 192 }, {  60,   0, 195 }, {  57,   0, 198 },  // 148
+  {  54,   0, 201 }, {  51,   0, 204 }, {  48,   0, 207 }, {  45,   0, 210 },  // 152
+  {  42,   0, 213 }, {  39,   0, 216 }, {  36,   0, 219 }, {  33,   0, 222 },  // 156
+  {  30,   0, 225 }, {  27,   0, 228 }, {  24,   0, 231 }, {  21,   0, 234 },  // 160
+  {  18,   0, 237 }, {  15,   0, 240 }, {  12,   0, 243 }, {   9,   0, 246 },  // 164
+  {   6,   0, 249 }, {   3,   0, 252 }, {   0,   0, 255 }, {   0,   3, 252 },  // 168
+  {   0,   6, 249 }, {   0,   9, 246 }, {   0,  12, 243 }, {   0,  15, 240 },  // 172
+  {   0,  18, 237 }, {   0,  21, 234 }, {   0,  24, 231 }, {   0,  27, 228 },  // 176
+  {   0,  30, 225 }, {   0,  33, 222 }, {   0,  36, 219 }, {   0,  39, 216 },  // 180
+  {   0,  42, 213 }, {   0,  45, 210 }, {   0,  48, 207 }, {   0,  51, 204 },  // 184
+  {   0,  54, 201 }, {   0,  57, 198 }, {   0,  60, 195 }, {   0,  63, 192 },  // 188
+  {   0,  66, 189 }, {   0,  69, 186 }, {   0,  72, 183 }, {   0,  75, 180 },  // 192
+  {   0,  78, 177 }, {   0,  81, 174 }, {   0,  84, 171 }, {   0,  87, 168 },  // 196
+  {   0,  90, 165 }, {   0,  93, 162 }, {   0,  96, 159 }, {   0,  99, 156 },  // 200
+  {   0, 102, 153 }, {   0, 105, 150 }, {   0, 108, 147 }, {   0, 111, 144 },  // 204
+  {   0, 114, 141 }, {   0, 117, 138 }, {   0, 120, 135 }, {   0, 123, 132 },  // 208
+  {   0, 126, 129 }, {   0, 129, 126 }, {   0, 132, 123 }, {   0, 135, 120 },  // 212
+  {   0, 138, 117 }, {   0, 141, 114 }, {   0, 144, 111 }, {   0, 147, 108 },  // 216
+  {   0, 150, 105 }, {   0, 153, 102 }, {   0, 156,  99 }, {   0, 159,  96 },  // 220
+  {   0, 162,  93 }, {   0, 165,  90 }, {   0, 168,  87 }, {   0, 171,  84 },  // 224
+  {   0, 174,  81 }, {   0, 177,  78 }, {   0, 180,  75 }, {   0, 183,  72 },  // 228
+  {   0, 186,  69 }, {   0, 189,  66 }, {   0, 192,  63 }, {   0, 195,  60 },  // 232
+  {   0, 198,  57 }, {   0, 201,  54 }, {   0, 204,  51 }, {   0, 207,  48 },  // 236
+  {   0, 210,  45 }, {   0, 213,  42 }, {   0, 216,  39 }, {   0, 219,  36 },  // 240
+  {   0, 222,  33 }, {   0, 225,  30 }, {   0, 228,  27 }, {   0, 231,  24 },  // 244
+  {   0, 234,  21 }, {   0, 237,  18 }, {   0, 240,  15 }, {   0, 243,  12 },  // 248
+  {   0, 246,   9 }, {   0, 249,   6 }, {   0, 252,   3 }, {   0, 255,   0 }   // 252
+};
+
+#endif
@@ -64,8 +64,13 @@
 #define SERIAL_BAUD          115200  // For serial debug console
 #define IPC_COMMS_BAUD        19200  // For serial IPC with Output processor.
 
-#define HMI_RETRY_PERIOD_MS      50  // Interval between Cmd Tx retries (ms)
+#define HMI_RETRY_PERIOD_MS      50  // Time without an ACK, after our last
+                                     //   Cmd Tx, before unacknowledged
+                                     //   commands are resent (ms)
 #define HMI_MAX_RETRIES           5  // Max # of Tx retries
+#define HMI_MAX_TX_BYTES         64  // Max # of unacknowledged bytes on the
+                                     //   line (the size of the Output
+                                     //   processor's SoftwareSerial Rx buffer)
 
 
 /*** Digital input pins ***/
@@ -128,6 +133,18 @@ typedef struct ButtonStruct
   uint8 state;
 } Button_t;
 
+/** An IPC command in the transmit window */
+typedef struct IpcSlotStruct
+{
+  uint8   len;      // # of bytes in buf (0 = slot is free)
+  uint8   txLen;    // # of bytes sent on the line (framed and escaped)
+  uint8   seqNum;   // The command's sequence #
+  uint8   tries;    // # of times the command has been sent
+  boolean held;     // The output processor is holding it (out of order)
+  boolean report;   // Its return code is wanted (see s_IpcResult)
+  uint8   buf[MAX_SERIAL_BUF_LEN];
+} IpcSlot_t;
+
 
 
 /*****************************  State Variables  ******************************/
@@ -138,7 +155,21 @@ uint8 s_IpcInBuf[MAX_SERIAL_BUF_LEN];
 uint8 s_IpcInBufPos = 0;
 uint8 s_IpcOutBuf[MAX_SERIAL_BUF_LEN];
 uint8 s_IpcOutBufPos = 0;
-uint8 s_IpcSeqNum = 0;  // Sequence # for Tx IPC messages.
+uint8 s_IpcSeqNum = 0;  // Sequence # of the last Tx IPC command.
+
+/** IPC transmit window
+ *  s_IpcWindow[] holds the (up to IPC_WINDOW_SIZE) commands that have been
+ *  sent, but not yet acknowledged, s_IpcPending of them in all.
+ */
+IpcSlot_t s_IpcWindow[IPC_WINDOW_SIZE];
+uint8     s_IpcPending = 0;
+uint8     s_IpcTxBytes = 0;          // Total txLen of the pending commands
+uint32    s_IpcTxTime  = 0;          // When a command was last sent (ms)
+int8      s_IpcResult  = TSTACK_OK;  // First failure among the commands
+                                     //   acknowledged since IpcFlush(), or
+                                     //   -1 if one timed out.
+boolean   s_IpcBatch   = false;      // SendIpcCommand() doesn't wait for
+                                     //   ACKs (see IpcBeginBatch()).
 
 /** Pushbutton states */
 Button_t buttons[NUM_BUTTONS] =
@@ -352,78 +383,97 @@ uint8 ScanButton(void)
 /***************************************************************************
  * Function: ProcessIpcAck
  * 
- * Parse and process a received acknowledgement in the IPC serial buffer.
+ * Parse and process a received acknowledgement in the IPC serial buffer:
+ * Retire the commands in the transmit window that it acknowledges, noting
+ * their return codes, and mark those that the output processor is holding.
  * If the output processor rebooted, flag that fact.
  * 
  * Parameters:
- *   expectedCmdAck:I  - The command to which an ACK is expected.
- * Returns:
- *   IPC Ack code (e.g. TSTACK_OK), if an ACK was received;
- *   -1, otherwise.
+ *   ackSeqNum:I  - The ACK's sequence number.
+ * Returns:  (none)
  * Input/Output:
  *   s_IpcInBuf:IO
  *   s_IpcInBufPos:IO
+ *   s_IpcPending:IO
+ *   s_IpcResult:IO
+ *   s_IpcTxBytes:IO
+ *   s_IpcWindow:IO
  *   s_OutputRebooted:O
  ***************************************************************************/
-int8 ProcessIpcAck(uint8 expectedCmdAck)
+void ProcessIpcAck(uint8 ackSeqNum)
 {
-  uint8 idx;
-  uint8 cmd;
+  uint8 rxMask;
+  uint8 *pRc;
+  uint8 dist;
   int8  rc;
-  uint8 isErr;
   
   if (0 == s_IpcInBufPos)
   {
     // There's nothing to process.
     dbgPrintln(FLASH("***ProcessIpcAck() called with empty buffer"));
-    return -1;
+    return;
   }
 
-  idx = 0;
-  isErr = false;
-  switch (s_IpcInBuf[idx++])
+  if (s_IpcInBuf[0] != TSTCMD_ACK)
   {
-    case TSTCMD_ACK:
-      // TSTCMD_ACK(cmdCode, returnCode)
-      dbgPrint(millis());
-      dbgPrint(FLASH(" ACK: "));
-      if (s_IpcInBufPos != 3)
-      {
-        isErr = true;
-        dbgPrintln(FLASH("Corrupted ACK"));
-      }
-      else
-      {
-        cmd = s_IpcInBuf[idx++];
-        rc = s_IpcInBuf[idx++];
-        if (cmd != expectedCmdAck)
-        {
-          isErr = true;
-        }
-        dbgPrint(cmd);
-        dbgPrint(", ");
-        dbgPrintln(rc);
-      }
-      break;
-
-    default:
-      isErr = true;
-      dbgPrint(FLASH("***Unexpected IPC message ["));
-      dbgPrint(s_IpcInBuf[0]);
-      dbgPrintln(FLASH("]"));
+    dbgPrint(FLASH("***Unexpected IPC message ["));
+    dbgPrint(s_IpcInBuf[0]);
+    dbgPrintln(FLASH("]"));
+    return;
   }
 
-  if (isErr)
+  // TSTCMD_ACK(cmdCode, rxMask, returnCodes...)
+  dbgPrint(millis());
+  dbgPrint(FLASH(" ACK: "));
+  if (s_IpcInBufPos != (3 + IPC_WINDOW_SIZE))
   {
-    return -1;
+    dbgPrintln(FLASH("Corrupted ACK"));
+    return;
   }
-  else
+  rxMask = s_IpcInBuf[2];
+  pRc = &s_IpcInBuf[3];
+  dbgPrint(ackSeqNum);
+  dbgPrint(", ");
+  dbgPrint(s_IpcInBuf[1]);
+  dbgPrint(", ");
+  dbgPrint(pRc[0]);
+  dbgPrint(", ");
+  dbgPrintln(rxMask);
+
+  for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
   {
-    if (TSTACK_OUTREBOOT == rc)
+    IpcSlot_t *pSlot = &s_IpcWindow[i];
+
+    if (0 == pSlot->len)
     {
-      s_OutputRebooted = true;
+      continue;
+    }
+    dist = IPC_SEQ_DIFF(ackSeqNum, pSlot->seqNum);
+    if (dist < IPC_WINDOW_SIZE)
+    {
+      // The command has been executed: Retire it.
+      rc = pRc[dist];
+      if (TSTACK_OUTREBOOT == rc)
+      {
+        s_OutputRebooted = true;
+      }
+      if ( pSlot->report && (rc != TSTACK_OK) && (TSTACK_OK == s_IpcResult) )
+      {
+        s_IpcResult = rc;
+      }
+      pSlot->len = 0;
+      s_IpcPending--;
+      s_IpcTxBytes -= pSlot->txLen;
+    }
+    else
+    {
+      dist = IPC_SEQ_DIFF(pSlot->seqNum, ackSeqNum);
+      if ( (dist >= 2) && (dist <= IPC_WINDOW_SIZE) &&
+           (rxMask & (1 << (dist - 2))) )
+      {
+        pSlot->held = true;
+      }
     }
-    return rc;
   }
 }
 
@@ -431,32 +481,29 @@ int8 ProcessIpcAck(uint8 expectedCmdAck)
 /***************************************************************************
  * Function: HandleIpcRx
  * 
- * Check for, and respond to, messages coming in from the HMI processor
+ * Check for, and respond to, messages coming in from the Output processor
  * over the Interprocessor Communcations serial port.
  * 
- * Parameters:
- *   expectedCmdAck:I  - The command to which an ACK is expected.
+ * Parameters: (none)
  * Returns:
- *   IPC Ack code (e.g. TSTACK_OK), if an ACK was received;
- *   -1, otherwise. 
+ *   true iff a complete message was read (so there may be more to read).
  * Input/Output:
- *   s_IpcSeqNum:I
  *   s_IpcInBuf:IO
  *   s_IpcInBufPos:IO
  * Note:
  *   This function processes the serial input in stream fashion, processing
- *   as much of the input at-a-time as it can, executing at most one
- *   received command.
+ *   as much of the input at-a-time as it can, processing at most one
+ *   received message.
  ***************************************************************************/
-int8 HandleIpcRx(uint8 expectedCmdAck)
+boolean HandleIpcRx(void)
 {
   static uint8 state = IPC_SEEK;
+  static uint8 ackSeqNum;
   boolean done;
   uint8   inChar;
   uint8   charCount;
   uint8   rxCrc8;
   uint8   calcCrc8;
-  uint8   ackSeqNum;
 
   done = false;
   charCount = s_OutComms.available();
@@ -467,11 +514,12 @@ int8 HandleIpcRx(uint8 expectedCmdAck)
   if (s_OutComms.overflow())
   {
     dbgPrintln(FLASH("***Buffer overflow"));
-    for (uint8 i = charCount; i != 0; i++)
+    for (uint8 i = charCount; i != 0; i--)
     {
       inChar = s_OutComms.read();
     }
-    return -1;
+    state = IPC_PURGE;
+    return false;
   }
   
   while ((charCount != 0) && !done)
@@ -501,17 +549,7 @@ int8 HandleIpcRx(uint8 expectedCmdAck)
 
       case IPC_SEQNUM:
         ackSeqNum = inChar;
-        if (ackSeqNum < s_IpcSeqNum)
-        {
-          // This is an old ACK. Discard it.
-          state = IPC_PURGE;
-          dbgPrint(FLASH("Drop: "));
-          dbgPrintln(ackSeqNum);
-        }
-        else
-        {
-          state = IPC_COLLECT;
-        }
+        state = IPC_COLLECT;
         break;
 
       case IPC_COLLECT:
@@ -582,113 +620,357 @@ int8 HandleIpcRx(uint8 expectedCmdAck)
     if (calcCrc8 == rxCrc8)
     {
       // The CRC8 value check out: Process the ACK.
-      return ProcessIpcAck(expectedCmdAck);
+      ProcessIpcAck(ackSeqNum);
+    }
+    else
+    {
+      dbgPrintln(FLASH("***Bad ACK CRC8"));
     }
-    dbgPrintln(FLASH("***Bad ACK CRC8"));
   }
   
-  return -1;
+  return done;
 }
 
 
 /***************************************************************************
- * Function: SendIpcCommand
+ * Function: IpcTransmit
  * 
- * Send a command to the Output Processor via the IPC serial ports.
+ * Send (or resend) a command in the transmit window to the Output
+ * Processor via the IPC serial ports.
  * 
  * Parameters:
- *  argBuf:I  - Address of a buffer containing the command arguments.
- *  bufLen:I  - Number of bytes in the buffer.
- * Returns:
- *   0,     if command was received without error;
- *   n > 0, if command was received with error (n is the return code);
- *   -1,    if the command timed out.
+ *  slot:I  - Index of the command's entry in s_IpcWindow[].
+ * Returns:  (none)
  * Input/Output:
- *   s_IpcSeqNum:IO
+ *   s_IpcTxTime:O
+ *   s_IpcWindow:IO
  ***************************************************************************/
-int8 SendIpcCommand(uint8 *argBuf, uint8 bufLen)
+void IpcTransmit(uint8 slot)
 {
-  uint32  retryTime;
+  IpcSlot_t *pSlot = &s_IpcWindow[slot];
   uint8  *src;
-  uint8   retryCount;
   uint8   crc8;
   uint8   outChar;
-  int8    rc;
   uint8   i;
-  boolean acked;
 
-  crc8 = Crc8(argBuf, bufLen);
-  retryCount = 0;
-  acked = false;
-  while ( (retryCount < HMI_MAX_RETRIES) && !acked )
-  {
-    retryCount++;
-    dbgPrint(FLASH("SendIpcCommand. Out: "));
-    /***  Send the command  ***/
-    
-    src = argBuf;
-    s_OutComms.write(CHAR_STX);
-    dbgPrint(CHAR_STX);
-    dbgPrint(" ");
-    s_OutComms.write(CHAR_STX);
-    dbgPrint(CHAR_STX);
-    dbgPrint(" ");
-    s_IpcSeqNum++;
-    if (s_IpcSeqNum >= CHAR_ESC)
+  pSlot->tries++;
+  crc8 = Crc8(pSlot->buf, pSlot->len);
+  dbgPrint(FLASH("SendIpcCommand. Out: "));
+  
+  src = pSlot->buf;
+  s_OutComms.write(CHAR_STX);
+  dbgPrint(CHAR_STX);
+  dbgPrint(" ");
+  s_OutComms.write(CHAR_STX);
+  dbgPrint(CHAR_STX);
+  dbgPrint(" ");
+  s_OutComms.write(pSlot->seqNum);
+  dbgPrint(pSlot->seqNum);
+  dbgPrint(" ");
+
+  /* Transmit the command buffer contents */
+  for (i = pSlot->len; i != 0; i--)
+  {
+    outChar = *src;
+    src++;
+    if (outChar >= CHAR_ESC)
     {
-      s_IpcSeqNum = 0;
+      // outChar needs to be escaped
+      s_OutComms.write(CHAR_ESC);
+      dbgPrint(CHAR_ESC);
+      dbgPrint(" ");
     }
-    s_OutComms.write(s_IpcSeqNum);
-    dbgPrint(s_IpcSeqNum);
+    s_OutComms.write((uint8)outChar);
+    dbgPrint(outChar);
     dbgPrint(" ");
+  }
+
+  s_OutComms.write(CHAR_ETX);
+  dbgPrint(CHAR_ETX);
+  dbgPrint(" ");
+  s_OutComms.write(crc8);
+  dbgPrintln(crc8);
 
-    /* Transmit the command buffer contents */
-    for (i = bufLen; i != 0; i--)
+  s_IpcTxTime = millis();
+  dbgPrint(s_IpcTxTime);
+  dbgPrint(FLASH(" Try #: "));
+  dbgPrintln(pSlot->tries);
+}
+
+
+/***************************************************************************
+ * Function: IpcReset
+ * 
+ * Abandon all of the commands in the transmit window.
+ * 
+ * Parameters: (none)
+ * Returns:    (none)
+ * Input/Output:
+ *   s_IpcPending:O
+ *   s_IpcTxBytes:O
+ *   s_IpcWindow:O
+ ***************************************************************************/
+void IpcReset(void)
+{
+  for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
+  {
+    s_IpcWindow[i].len = 0;
+  }
+  s_IpcPending = 0;
+  s_IpcTxBytes = 0;
+}
+
+
+/***************************************************************************
+ * Function: IpcService
+ * 
+ * Process any acknowledgements that have come in from the Output Processor
+ * and, if none has come in for HMI_RETRY_PERIOD_MS since a command was last
+ * sent, resend the commands that are still unacknowledged. Commands that the
+ * Output Processor reports holding aren't resent. If a command has run out
+ * of retries, the whole window is abandoned. The Output Processor's receive
+ * window is left waiting for the abandoned sequence numbers, and TSTCMD_INIT
+ * resyncs it: If an abandoned command's failure was to be reported, the
+ * Output Processor is flagged for reinitialization (see loop()); otherwise
+ * (e.g. a lost channel update), a lone TSTCMD_INIT is queued to resync it
+ * quietly. (Should it have rebooted, its reply to TSTCMD_INIT still flags
+ * it for reinitialization.)
+ * 
+ * Parameters: (none)
+ * Returns:    (none)
+ * Input/Output:
+ *   s_IpcPending:IO
+ *   s_IpcResult:IO
+ *   s_IpcSeqNum:IO
+ *   s_IpcTxBytes:IO
+ *   s_IpcTxTime:I
+ *   s_IpcWindow:IO
+ *   s_OutputRebooted:O
+ * Note:
+ *   This needs to be called regularly (e.g. once per loop()) while commands
+ *   are pending.
+ ***************************************************************************/
+void IpcService(void)
+{
+  boolean resent;
+  boolean reported;
+  uint8   initCmd = TSTCMD_INIT;
+
+  while (HandleIpcRx()) {}
+
+  if ( (0 == s_IpcPending) || ((millis() - s_IpcTxTime) < HMI_RETRY_PERIOD_MS) )
+  {
+    return;
+  }
+
+  for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
+  {
+    if ( (s_IpcWindow[i].len != 0) && !s_IpcWindow[i].held &&
+         (s_IpcWindow[i].tries >= HMI_MAX_RETRIES) )
     {
-      outChar = *src;
-      src++;
-      if (outChar >= CHAR_ESC)
+      // The command timed out.
+      dbgPrintln(FLASH("***IPC timeout"));
+      reported = false;
+      for (uint8 j = 0; j < IPC_WINDOW_SIZE; j++)
+      {
+        if ( (s_IpcWindow[j].len != 0) && s_IpcWindow[j].report )
+        {
+          reported = true;
+          if (TSTACK_OK == s_IpcResult)
+          {
+            s_IpcResult = -1;
+          }
+        }
+      }
+      IpcReset();
+      if (reported)
       {
-        // outChar needs to be escaped
-        s_OutComms.write(CHAR_ESC);
-        dbgPrint(CHAR_ESC);
-        dbgPrint(" ");
+        s_OutputRebooted = true;
       }
-      s_OutComms.write((uint8)outChar);
-      dbgPrint(outChar);
-      dbgPrint(" ");
+      else
+      {
+        IpcQueueCommand(&initCmd, 1, false);
+      }
+      return;
     }
-  
-    s_OutComms.write(CHAR_ETX);
-    dbgPrint(CHAR_ETX);
-    dbgPrint(" ");
-    s_OutComms.write(crc8);
-    dbgPrintln(crc8);
+  }
+
+  resent = false;
+  for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
+  {
+    if ( (s_IpcWindow[i].len != 0) && !s_IpcWindow[i].held )
+    {
+      IpcTransmit(i);
+      resent = true;
+    }
+  }
+  if (!resent)
+  {
+    // Nothing but held commands remain, so what they were waiting on must
+    // have been lost: Resend them next time round.
+    for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
+    {
+      s_IpcWindow[i].held = false;
+    }
+    s_IpcTxTime = millis();
+  }
+}
 
 
-    /***  Wait for ACK  ***/
-    dbgPrint(millis());
-    dbgPrint(FLASH(" Try #: "));
-    dbgPrintln(retryCount);
-    retryTime = millis() + HMI_RETRY_PERIOD_MS;
-    while ( (millis() < retryTime) && !acked )
+/***************************************************************************
+ * Function: IpcQueueCommand
+ * 
+ * Send a command to the Output Processor via the IPC serial ports, without
+ * waiting for it to be acknowledged. If the transmit window is full, or the
+ * command would take the bytes in flight over HMI_MAX_TX_BYTES (overflowing
+ * the Output processor's Rx buffer, should it be slow to read it), wait for
+ * room first.
+ * 
+ * Parameters:
+ *  argBuf:I  - Address of a buffer containing the command arguments.
+ *  bufLen:I  - Number of bytes in the buffer.
+ *  report:I  - true iff a failure of the command is to be reported by
+ *              IpcFlush().
+ * Returns:  (none)
+ * Input/Output:
+ *   s_IpcPending:IO
+ *   s_IpcSeqNum:IO
+ *   s_IpcTxBytes:IO
+ *   s_IpcWindow:IO
+ ***************************************************************************/
+void IpcQueueCommand(uint8 *argBuf, uint8 bufLen, boolean report)
+{
+  uint8 slot;
+  uint8 txLen;
+
+  // CHAR_STX, CHAR_STX, seq #, (escaped) command, CHAR_ETX, CRC8
+  txLen = bufLen + 5;
+  for (uint8 i = 0; i < bufLen; i++)
+  {
+    if (argBuf[i] >= CHAR_ESC)
     {
-      rc = HandleIpcRx(argBuf[0]);
-      if (rc != -1)
-      {
-        acked = true;
-      }
+      txLen++;
     }
   }
 
-  if (acked)
+  while (   (s_IpcPending >= IPC_WINDOW_SIZE)
+         || ( (s_IpcPending != 0) &&
+              ((uint16)s_IpcTxBytes + txLen > HMI_MAX_TX_BYTES) )
+        )
   {
-    return rc;
+    IpcService();
   }
-  else
+
+  for (slot = 0; s_IpcWindow[slot].len != 0; slot++) {}
+  s_IpcSeqNum = IPC_SEQ_NEXT(s_IpcSeqNum);
+  s_IpcWindow[slot].seqNum = s_IpcSeqNum;
+  s_IpcWindow[slot].tries  = 0;
+  s_IpcWindow[slot].held   = false;
+  s_IpcWindow[slot].report = report;
+  s_IpcWindow[slot].len    = bufLen;
+  s_IpcWindow[slot].txLen  = txLen;
+  memcpy(s_IpcWindow[slot].buf, argBuf, bufLen);
+  s_IpcPending++;
+  s_IpcTxBytes += txLen;
+  IpcTransmit(slot);
+}
+
+
+/***************************************************************************
+ * Function: IpcFlush
+ * 
+ * Wait for all commands in the transmit window to be acknowledged (or to
+ * time out).
+ * 
+ * Parameters: (none)
+ * Returns:
+ *   0,     if the commands were received without error;
+ *   n > 0, if a command was received with error (n is the first one's
+ *          return code);
+ *   -1,    if a command timed out.
+ * Input/Output:
+ *   s_IpcPending:I
+ *   s_IpcResult:IO
+ ***************************************************************************/
+int8 IpcFlush(void)
+{
+  int8 rc;
+
+  while (s_IpcPending != 0)
+  {
+    IpcService();
+  }
+  rc = s_IpcResult;
+  s_IpcResult = TSTACK_OK;
+  return rc;
+}
+
+
+/***************************************************************************
+ * Function: IpcBeginBatch
+ * 
+ * Start a batch of commands: Until IpcEndBatch(), SendIpcCommand() only
+ * waits for room in the transmit window, so that up to IPC_WINDOW_SIZE
+ * commands are in flight at once.
+ * 
+ * Parameters: (none)
+ * Returns:    (none)
+ * Input/Output:
+ *   s_IpcBatch:O
+ ***************************************************************************/
+void IpcBeginBatch(void)
+{
+  s_IpcBatch = true;
+}
+
+
+/***************************************************************************
+ * Function: IpcEndBatch
+ * 
+ * End a batch of commands, waiting for all of them to be acknowledged.
+ * 
+ * Parameters: (none)
+ * Returns:
+ *   0,     if the commands were received without error;
+ *   n > 0, if a command was received with error (n is the first one's
+ *          return code);
+ *   -1,    if a command timed out.
+ * Input/Output:
+ *   s_IpcBatch:O
+ ***************************************************************************/
+int8 IpcEndBatch(void)
+{
+  s_IpcBatch = false;
+  return IpcFlush();
+}
+
+
+/***************************************************************************
+ * Function: SendIpcCommand
+ * 
+ * Send a command to the Output Processor via the IPC serial ports.
+ * 
+ * Parameters:
+ *  argBuf:I  - Address of a buffer containing the command arguments.
+ *  bufLen:I  - Number of bytes in the buffer.
+ * Returns:
+ *   0,     if command was received without error;
+ *   n > 0, if command was received with error (n is the return code);
+ *   -1,    if the command timed out.
+ *   In a batch (see IpcBeginBatch()), the command isn't waited for: The
+ *   result is that of the batch's commands acknowledged so far.
+ * Input/Output:
+ *   s_IpcBatch:I
+ *   s_IpcResult:I
+ ***************************************************************************/
+int8 SendIpcCommand(uint8 *argBuf, uint8 bufLen)
+{
+  IpcQueueCommand(argBuf, bufLen, true);
+  if (s_IpcBatch)
   {
-    return -1;
+    return s_IpcResult;
   }
+  return IpcFlush();
 }
 
 
@@ -931,22 +1213,20 @@ dbgPrintln(s_TestOutputs);
  * Function: IpcUpdateChannel
  * 
  * Send an IPC command to the Output Processor to set a single specific
- * channel's value.
+ * channel's value. The command isn't waited for, so that the menus and
+ * potentiometer stay responsive; any failure is ignored.
  * 
  * Parameters:
  *   chanNum:I  - Channel number of the channel to upate based on the current
  *                test outputs (onboard or DMXW). The channel number is
  *                expected to be within the value range.
  *   value:I    - The channel's value to be updated.
- * Returns:
- *   0,     if command was received without error;
- *   n > 0, if command was received with error n (e.g. TSTACK_BAD_PARM);
- *   -1,    if the command timed out.
+ * Returns:  (none)
  * Input/Output:
  *   s_IpcOutBuf:IO
  *   s_IpcOutBufPos:IO
  ***************************************************************************/
-int8 IpcUpdateChannel(uint8 chanNum, uint8 value)
+void IpcUpdateChannel(uint8 chanNum, uint8 value)
 {
   dbgPrint(FLASH("IpcUpdateChannel: "));
   s_IpcOutBufPos = 0;
@@ -954,7 +1234,7 @@ int8 IpcUpdateChannel(uint8 chanNum, uint8 value)
   s_IpcOutBuf[s_IpcOutBufPos++] = 1;
   s_IpcOutBuf[s_IpcOutBufPos++] = chanNum;
   s_IpcOutBuf[s_IpcOutBufPos++] = value;
-  return SendIpcCommand(s_IpcOutBuf, s_IpcOutBufPos);
+  IpcQueueCommand(s_IpcOutBuf, s_IpcOutBufPos, false);
 }
 
 
@@ -2198,6 +2478,7 @@ void UpdatePotChannel(void)
  * Inputs/Outputs:
  *   s_IpcOutBuf:O
  *   s_IpcOutBufPos:O
+ *   s_IpcResult:O
  *   s_OutputRebooted:O
  *   s_SendConfigData:O
  *   s_TestState:O
@@ -2209,14 +2490,16 @@ void InitializeSystem(void)
   dbgPrintln(FLASH("Init System..."));
   s_TestState = STOPPED;
   s_SendConfigData = false;
+  IpcReset();  // (The output processor resyncs to TSTCMD_INIT.)
+  s_IpcResult = TSTACK_OK;
   s_IpcOutBufPos = 0;
   s_IpcOutBuf[s_IpcOutBufPos++] = TSTCMD_INIT;
   rc = SendIpcCommand(s_IpcOutBuf, s_IpcOutBufPos);
 
   // If the the TSTCMD_INIT succeeded, we're ok to configure the output
-  // processor. Otherwise, we'll end up getting called again to retry
-  // indefinitely.
-  if (0 == rc)
+  // processor. (It replies TSTACK_OUTREBOOT if it had rebooted.) Otherwise,
+  // we'll end up getting called again to retry indefinitely.
+  if ( (0 == rc) || (TSTACK_OUTREBOOT == rc) )
   {
     s_OutputRebooted = false;
     s_SendConfigData = true;
@@ -2324,6 +2607,7 @@ void setup()
 //------------------------------------------------------------------
 void loop()
 {
+  IpcService();
   if (s_OutputRebooted)
   {
     if (!s_Initialized)
@@ -2379,6 +2663,8 @@ void loop()
   {
     dbgPrintln(FLASH("Sending config"));
     s_SendConfigData = false;
+    IpcFlush();
+    IpcBeginBatch();
     IpcSetState(STOPPED);
     if (IpcConfigureTest() != 0)
     {
@@ -2396,6 +2682,10 @@ void loop()
     {
       s_SendConfigData = true;
     }
+    if (IpcEndBatch() != 0)
+    {
+      s_SendConfigData = true;
+    }
     
     if (s_SendConfigData)
     {
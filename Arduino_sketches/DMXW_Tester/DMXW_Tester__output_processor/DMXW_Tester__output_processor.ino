@@ -107,6 +107,8 @@
 
 #define SERIAL_BAUD         115200  // For serial debug console
 #define IPC_COMMS_BAUD       19200  // For serial IPC with HMI processor
+#define IPC_ACK_HOLDOFF_US    2000  // Quiet time on the IPC line before
+                                    //   sending an ACK (us)
 
 
 /*** PWM test channel output pins ***/
@@ -131,7 +133,7 @@
 // which can be achieved with at most 24 channel slots.)
 #define DMXW_TX_DELAY            100  // milliseconds
 //#define DMXW_TX_DELAY            35  // milliseconds
-#define DMXW_MAX_BUF_LEN     (MAX_DMXW_CHANS + 3)
+#define DMXW_MAX_BUF_LEN     (DMXW_HDR_LEN + 1 + MAX_DMXW_CHANS)
 
 // Macro for defining strings that are stored in flash (program) memory rather
 // than in RAM. Arduino defines the non-descript F("string") syntax.
@@ -218,10 +220,25 @@ TestState_t  s_TestState   = STOPPED;    // Current test state
 SoftwareSerial s_HmiComms(HMI_COMMS_RX, HMI_COMMS_TX);
 uint8 s_IpcBuf[MAX_SERIAL_BUF_LEN];
 uint8 s_IpcBufPos = 0;
-uint8 s_IpcSeqNum = 0;
+uint8 s_IpcSeqNum = 0;  // Sequence # of the last command executed.
+uint8 s_IpcAckCmd = TSTCMD_UNDEF;      // Code of the last command executed.
+uint8 s_IpcAckRc[IPC_WINDOW_SIZE];     // Return codes of the last commands
+                                       //   executed, latest first.
+boolean s_IpcAckDue = false;           // An ACK is to be sent once the line
+                                       //   is quiet.
+uint32  s_IpcRxTime = 0;               // When the last IPC char arrived (us)
+
+/** IPC commands received out of order.
+ *  s_IpcHoldBuf[i] holds the command with sequence # (s_IpcSeqNum + 2 + i),
+ *  if s_IpcHoldLen[i] is non-zero, until the commands before it have been
+ *  executed.
+ */
+uint8 s_IpcHoldBuf[IPC_WINDOW_SIZE - 1][MAX_SERIAL_BUF_LEN];
+uint8 s_IpcHoldLen[IPC_WINDOW_SIZE - 1];
 
 // DMXW packet buffer
 uint8 s_DmxwBuf[DMXW_MAX_BUF_LEN];
+uint8 s_DmxwTxSeq = 0;   // Sequence # of the next DMXW packet (see DMXW_HDR)
 
 // LED Pixel String state
 Adafruit_NeoPixel *s_pStrip    = NULL; // Ptr to pixel string object
@@ -365,7 +382,7 @@ AckCode_t SendDmxwPacket(int dst, uint8 *payload, int sendSize, bool requestAck)
   dbgPrint(FLASH("] Size["));
   dbgPrint(sendSize);
   dbgPrint(FLASH("] Data["));
-  PrintDmxwCmd(payload[2]);
+  PrintDmxwCmd(payload[DMXW_HDR_LEN]);
   for (uint8 i = 0; i < sendSize; i++)
   {
     dbgPrint(" ");
@@ -378,6 +395,8 @@ AckCode_t SendDmxwPacket(int dst, uint8 *payload, int sendSize, bool requestAck)
     requestAck = false;
   for (byte i = 0; i <= TX_NUM_RETRIES; i++)
   { 
+    if (i > 0)
+      payload[0] |= DMXW_HDR_RETRY;
     s_Radio.send(dst, payload, sendSize, requestAck);
     sentTime = millis();
     if (requestAck)
@@ -630,8 +649,7 @@ void OutputChannels(void)
         
         dmxwUpdateTime = millis() + DMXW_TX_DELAY;
         pDmxwBuf = &s_DmxwBuf[0];
-        *(pDmxwBuf++) = kMyNodeId;
-        *(pDmxwBuf++) = BROADCASTID;
+        *(pDmxwBuf++) = DMXW_HDR(0, s_DmxwTxSeq++);
         *(pDmxwBuf++) = CMD_RUN;
         if (s_TestState != STOPPED)
         {
@@ -938,50 +956,71 @@ uint8 UpdateChanValue(uint8 chanNum, uint8 value)
 /***************************************************************************
  * Function: SendIpcAck
  * 
- * Send an acknowledgement to an IPC command.
+ * Send a cumulative acknowledgement of the IPC commands executed so far,
+ * along with the return codes of the latest ones and the set of commands
+ * being held out of order.
  * 
- * Parameters:
- *  ipcCmd:I      - The IPC command to which this is an acknowledgement.
- *  returnCode:I  - The acknowledgement return code value.
+ * Parameters:   (none)
  * Returns:      (none)
  * Input/Output:
+ *  s_IpcAckCmd:I
+ *  s_IpcAckDue:O
+ *  s_IpcAckRc:I
+ *  s_IpcHoldLen:I
  *  s_IpcSeqNum:I
  *  s_HmiComms:O
  ***************************************************************************/
-void SendIpcAck(uint8 ipcCmd, uint8 returnCode)
+void SendIpcAck(void)
 {
-  uint8 *pBuf;
-  uint8 tmpBuf[4];
+  uint8 tmpBuf[3 + IPC_WINDOW_SIZE];
   uint8 len;
+  uint8 rxMask;
   uint8 crc8;
 
+  rxMask = 0;
+  for (uint8 i = 0; i < IPC_WINDOW_SIZE - 1; i++)
+  {
+    if (s_IpcHoldLen[i] != 0)
+    {
+      rxMask |= 1 << i;
+    }
+  }
+
   len = 0;
   tmpBuf[len++] = TSTCMD_ACK;
-  tmpBuf[len++] = ipcCmd;
-  if (returnCode >= CHAR_ESC)
+  tmpBuf[len++] = s_IpcAckCmd;
+  tmpBuf[len++] = rxMask;
+  for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
   {
-    tmpBuf[len++] = CHAR_ESC;
+    tmpBuf[len++] = s_IpcAckRc[i];
   }
-  tmpBuf[len++] = returnCode;
   crc8 = Crc8(tmpBuf, len);
   
   s_HmiComms.write(CHAR_STX);
   s_HmiComms.write(CHAR_STX);
   s_HmiComms.write(s_IpcSeqNum);
-  pBuf = tmpBuf;
-  for (uint8 i = len; i != 0; i--)
+  for (uint8 i = 0; i < len; i++)
   {
-    s_HmiComms.write(*pBuf);
-    pBuf++;
+    if (tmpBuf[i] >= CHAR_ESC)
+    {
+      // The value needs to be escaped
+      s_HmiComms.write(CHAR_ESC);
+    }
+    s_HmiComms.write(tmpBuf[i]);
   }
   s_HmiComms.write(CHAR_ETX);
   s_HmiComms.write(crc8);
+  s_IpcAckDue = false;
   dbgPrint(millis());
   dbgPrint(FLASH(" "));
   dbgPrint(FLASH("ACK["));
-  dbgPrint(ipcCmd);
+  dbgPrint(s_IpcSeqNum);
   dbgPrint(FLASH(", "));
-  dbgPrint(returnCode);
+  dbgPrint(s_IpcAckCmd);
+  dbgPrint(FLASH(", "));
+  dbgPrint(s_IpcAckRc[0]);
+  dbgPrint(FLASH(", "));
+  dbgPrint(rxMask);
   dbgPrint(FLASH(", "));
   dbgPrint(crc8);
   dbgPrintln(FLASH("]"));
@@ -991,19 +1030,24 @@ void SendIpcAck(uint8 ipcCmd, uint8 returnCode)
 /***************************************************************************
  * Function: ProcessIpcCommand
  * 
- * Parse and execute the command in the IPC serial buffer.
+ * Parse and execute the command in the IPC serial buffer, recording its
+ * return code for the next acknowledgement.
  * 
- * Parameters: (none)
+ * Parameters:
+ *   seqNum:I  - The command's sequence number.
  * Returns:    (none)
  * Input/Output:
+ *   s_IpcAckCmd:O
+ *   s_IpcAckRc:IO
  *   s_IpcBuf:IO
  *   s_IpcBufPos:IO
+ *   s_IpcSeqNum:O
  *   s_Rebooted:IO
  *   s_TestOutputs:IO
  *   s_TestState:IO
  *   s_TestType:IO
  ***************************************************************************/
-void ProcessIpcCommand(void)
+void ProcessIpcCommand(uint8 seqNum)
 {
   uint8 idx;
   uint8 tmp1, tmp2, tmp3;
@@ -1027,6 +1071,10 @@ void ProcessIpcCommand(void)
     case TSTCMD_INIT:
       // TSTCMD_INIT()
       dbgPrint(FLASH("INIT: "));
+      if (s_Rebooted)
+      {
+        rc = TSTACK_OUTREBOOT;  // (The HMI must resend our configuration)
+      }
       s_Rebooted = false;
       break;
       
@@ -1193,7 +1241,101 @@ void ProcessIpcCommand(void)
   {
     rc = TSTACK_OUTREBOOT;
   }
-  SendIpcAck(cmd, rc);
+
+  s_IpcSeqNum = seqNum;
+  s_IpcAckCmd = cmd;
+  for (uint8 i = IPC_WINDOW_SIZE - 1; i != 0; i--)
+  {
+    s_IpcAckRc[i] = s_IpcAckRc[i - 1];
+  }
+  s_IpcAckRc[0] = rc;
+}
+
+
+/***************************************************************************
+ * Function: ReceiveIpcCommand
+ * 
+ * Accept the (CRC checked) command in the IPC serial buffer into the receive
+ * window: Execute it if it's the next one in sequence, followed by any held
+ * commands that follow on from it; hold it if it's arrived early; and drop
+ * it if it's a duplicate. Either way, an acknowledgement becomes due.
+ * 
+ * Parameters:
+ *   seqNum:I  - The command's sequence number.
+ * Returns:    (none)
+ * Input/Output:
+ *   s_IpcAckDue:O
+ *   s_IpcAckRc:O
+ *   s_IpcBuf:IO
+ *   s_IpcBufPos:IO
+ *   s_IpcHoldBuf:IO
+ *   s_IpcHoldLen:IO
+ *   s_IpcSeqNum:IO
+ *   s_Rebooted:I
+ * Note:
+ *   Until the HMI processor has sent TSTCMD_INIT, after a reboot, every
+ *   command is taken to be the next one in sequence.
+ ***************************************************************************/
+void ReceiveIpcCommand(uint8 seqNum)
+{
+  uint8 dist;
+  uint8 heldLen;
+
+  s_IpcAckDue = true;
+  if ( s_Rebooted || (TSTCMD_INIT == s_IpcBuf[0]) )
+  {
+    // Resynchronize the window to this command.
+    s_IpcSeqNum = IPC_SEQ_DIFF(seqNum, 1);
+    for (uint8 i = 0; i < IPC_WINDOW_SIZE; i++)
+    {
+      s_IpcAckRc[i] = TSTACK_OUTREBOOT;
+    }
+    for (uint8 i = 0; i < IPC_WINDOW_SIZE - 1; i++)
+    {
+      s_IpcHoldLen[i] = 0;
+    }
+  }
+
+  dist = IPC_SEQ_DIFF(seqNum, s_IpcSeqNum);
+  if (1 == dist)
+  {
+    // Execute the command, then any held commands that are now in sequence.
+    ProcessIpcCommand(seqNum);
+    do
+    {
+      heldLen = s_IpcHoldLen[0];
+      if (heldLen != 0)
+      {
+        memcpy(s_IpcBuf, s_IpcHoldBuf[0], heldLen);
+        s_IpcBufPos = heldLen;
+      }
+      for (uint8 i = 0; i < IPC_WINDOW_SIZE - 2; i++)
+      {
+        s_IpcHoldLen[i] = s_IpcHoldLen[i + 1];
+        memcpy(s_IpcHoldBuf[i], s_IpcHoldBuf[i + 1], s_IpcHoldLen[i]);
+      }
+      s_IpcHoldLen[IPC_WINDOW_SIZE - 2] = 0;
+      if (heldLen != 0)
+      {
+        ProcessIpcCommand(IPC_SEQ_NEXT(s_IpcSeqNum));
+      }
+    } while (heldLen != 0);
+  }
+  else if ( (dist >= 2) && (dist <= IPC_WINDOW_SIZE) )
+  {
+    // The command has arrived early: Hold it.
+    dbgPrint(FLASH("Hold: "));
+    dbgPrintln(seqNum);
+    memcpy(s_IpcHoldBuf[dist - 2], s_IpcBuf, s_IpcBufPos);
+    s_IpcHoldLen[dist - 2] = s_IpcBufPos;
+  }
+  else
+  {
+    // A command that has already been executed (its ACK must have been
+    // lost), or one from outside the window.
+    dbgPrint(FLASH("Drop: "));
+    dbgPrintln(seqNum);
+  }
 }
 
  
@@ -1204,27 +1346,38 @@ void ProcessIpcCommand(void)
  * over the Interprocessor Communcations serial port.
  * 
  * Parameters: (none)
- * Returns:    (none)
+ * Returns:
+ *   true iff a complete command was read (so there may be more to read).
  * Input/Output:
+ *   s_IpcAckDue:I
  *   s_IpcBuf:IO
  *   s_IpcBufPos:IO
- *   s_IpcSeqNum:IO
+ *   s_IpcRxTime:IO
  * Note:
  *   This function processes the serial input in stream fashion, processing
- *   as much of the input at-a-time as it can, executing at most one
- *   received command.
+ *   as much of the input at-a-time as it can, receiving at most one
+ *   command.
+ *   Once there are no more commands to read, any ACK that is due is held
+ *   off until the line has been quiet for IPC_ACK_HOLDOFF_US, so that it
+ *   acknowledges a whole burst of commands and doesn't garble the next
+ *   one. (SoftwareSerial can't receive while it's transmitting.)
  ***************************************************************************/
-void HandleIpcRx(void)
+boolean HandleIpcRx(void)
 {
   static uint8 state = IPC_SEEK;
   boolean done;
   uint8   inChar;
   uint8   charCount;
+  static uint8 rxSeqNum;
   uint8   rxCrc8;
   uint8   calcCrc8;
 
   done = false;
   charCount = s_HmiComms.available();
+  if (charCount != 0)
+  {
+    s_IpcRxTime = micros();
+  }
 
   /* If the serial buffer has overflowed, purge the buffer
    * and abort further processing.
@@ -1232,11 +1385,12 @@ void HandleIpcRx(void)
   if (s_HmiComms.overflow())
   {
     dbgPrintln(FLASH("IPC serial overflow"));
-    for (uint8 i = charCount; i != 0; i++)
+    for (uint8 i = charCount; i != 0; i--)
     {
       inChar = s_HmiComms.read();
     }
-    return;
+    state = IPC_PURGE;
+    return false;
   }
   
   while ((charCount != 0) && !done)
@@ -1269,7 +1423,7 @@ void HandleIpcRx(void)
         break;
 
       case IPC_SEQNUM:
-        s_IpcSeqNum = inChar;
+        rxSeqNum = inChar;
         state = IPC_COLLECT;
         break;
 
@@ -1341,14 +1495,28 @@ void HandleIpcRx(void)
     dbgPrintln(calcCrc8);
     if (calcCrc8 == rxCrc8)
     {
-      // The CRC8 value checks out: Execute the command.
-      ProcessIpcCommand();
+      // The CRC8 value checks out: Accept the command.
+      ReceiveIpcCommand(rxSeqNum);
     }
     else
     {
       dbgPrintln(FLASH("***Bad cmd CRC8"));
     }
   }
+  else if ( s_IpcAckDue && ((IPC_SEEK == state) || (IPC_PURGE == state)) )
+  {
+    // Wait for the line to go quiet, unless another command is coming in.
+    while (   (0 == s_HmiComms.available())
+           && ((micros() - s_IpcRxTime) < IPC_ACK_HOLDOFF_US) )
+    {
+    }
+    if (0 == s_HmiComms.available())
+    {
+      SendIpcAck();
+    }
+  }
+
+  return done;
 }
 
 /***************************************************************************
@@ -1447,7 +1615,7 @@ void setup()
 //------------------------------------------------------------------
 void loop()
 {
-  HandleIpcRx();
+  while (HandleIpcRx()) {}
   if (!s_Rebooted)
   {
     UpdateChannels();
@@ -25,14 +25,33 @@
 #define NODEID_UNDEF       0
 #define NODEID_MAX         (MAX_DMXW_CHANS + 1)
 
+// Packet header    hdr = ver:2 | flags:2 | seq:4
+// =======================================================
+// - every packet sent by any node (including gateway) starts with a
+//   one-byte header. (The source and destination node numbers are carried,
+//   and CRC-checked, by the radio's own packet header.)
+//     - ver is the protocol version, DMXW_VERSION. Packets with any other
+//       version are dropped.
+//     - seq is incremented by the sender for each new packet. A
+//       retransmission repeats it with DMXW_HDR_RETRY set, so that the
+//       receiver can recognize a command it has already executed.
+//     - the header is implicit and isn't shown in the command syntax
+//       summaries below
+#define DMXW_HDR_LEN       1
+#define DMXW_VERSION       1
+#define DMXW_HDR_VER_MASK  0xC0
+#define DMXW_HDR_RETRY     0x10  // flags: retransmission of an earlier packet
+#define DMXW_HDR_POLL      0x20  // flags: (CMD_RUN) a CMD_TREQ follows
+#define DMXW_HDR_SEQ_MASK  0x0F
+
+#define DMXW_HDR(flags, seq) \
+          ((DMXW_VERSION << 6) | (flags) | ((seq) & DMXW_HDR_SEQ_MASK))
+#define DMXW_HDR_OK(hdr)   (((hdr) & DMXW_HDR_VER_MASK) == (DMXW_VERSION << 6))
+#define DMXW_HDR_SEQ(hdr)  ((hdr) & DMXW_HDR_SEQ_MASK)
+
 // Command codes   <Command code>(<arg>...)
 // =======================================================
-// - every packet sent by any node (including gateway) starts with
-//   duplicated source and destination node numbers--used to check
-//   for message corruption.
-//     - these are implicit and aren't shown in the command syntax summaries
-//       below
-// - following those is the command code
+// - every packet starts, after the header, with the command code
 // - command packet argument, [X], is an implied destination to which a packet
 //   is sent, either a specific node X (a unicast message),
 //   or if X=ALL (a broadcast message)
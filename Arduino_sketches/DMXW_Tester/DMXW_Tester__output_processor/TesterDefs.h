@@ -37,13 +37,6 @@
                             //   command.
 #define TSTACK_CORRUPTED  4 // Corrupted command detected.
 
-// TSTCMD_ACK returnCode values
-#define TSTACK_OK         0
-#define TSTACK_BAD_PARM   1 // Bad parameter value(s) or # of parameters
-#define TSTACK_BAD_STATE  2 // Current testing state is invalid for this
-                            //   command.
-#define TSTACK_CORRUPTED  3 // Corrupted command detected.
-
 // IPC processing states
 #define IPC_SEEK     0  // Initial state: Looking for first CHAR_STX
 #define IPC_SEEK2    1  // Looking for 2nd CHAR_STX
@@ -53,6 +46,18 @@
 #define IPC_CRC      5  // Collect the CRC8 value
 #define IPC_PURGE    6  // Error: Purge buffer until empty or CHAR_STX found.
 
+// IPC sliding window
+#define IPC_WINDOW_SIZE  4        // Max # of commands in flight (unacknowledged)
+                                  //   at any one time. (9 at most: see the
+                                  //   TSTCMD_ACK rxMask.)
+#define IPC_SEQ_MOD      CHAR_ESC // Sequence #s run from 0 thru 252, so that
+                                  //   they never need to be escaped.
+
+// Distance from sequence # b forward to sequence # a (modulo IPC_SEQ_MOD).
+#define IPC_SEQ_DIFF(a, b)  ((uint8)(((a) + IPC_SEQ_MOD - (b)) % IPC_SEQ_MOD))
+// The sequence # following sequence # a.
+#define IPC_SEQ_NEXT(a)     ((uint8)(((a) + 1) % IPC_SEQ_MOD))
+
 // Interprocessor Commands
 // =======================================================
 // - Communication between the Output Processor and HMI Processor
@@ -73,16 +78,29 @@
 //          255                CHAR_ESC, 255
 // - All commands are acknowledged (or time out at the HMI Processr) to
 //   indicate success or failure.
+// - The HMI Processor may have up to IPC_WINDOW_SIZE commands in flight,
+//   each with the next sequence number. The Output Processor executes them
+//   strictly in sequence number order, holding any that arrive early, and
+//   acknowledges them cumulatively with a single TSTCMD_ACK once the line
+//   goes quiet. The HMI Processor resends only the commands that are neither
+//   acknowledged nor held when no TSTCMD_ACK arrives in time.
 #define TSTCMD_UNDEF    0  // 'uninitialized' command code
 
 #define TSTCMD_INIT     1  // Startup handshake message from HMI processor.
                            // Parameters: (none)
                            // Return:
-                           //   The command always succeeds.
-                           // Note: After the output processor reboots, it
-                           //       will continue to reply to all IPC messages
-                           //       with TSTACK_OUTREBOOT until it receives
-                           //       this command.
+                           //   TSTACK_OUTREBOOT, if the output processor
+                           //   had rebooted since the last TSTCMD_INIT
+                           //   (it needs its configuration resent); else
+                           //   TSTACK_OK.
+                           // Notes:
+                           //  - After the output processor reboots, it
+                           //    will continue to reply to all IPC messages
+                           //    with TSTACK_OUTREBOOT until it receives
+                           //    this command.
+                           //  - The output processor's receive window is
+                           //    resynchronized to this command's sequence
+                           //    number.
 
 #define TSTCMD_STATE    2  // Set the current testing state.
                            // Parameters:
@@ -163,14 +181,22 @@
                            // Return:
                            //  This command always succeeds.
 
-#define TSTCMD_ACK      7  // Acknowledge the received command.
+#define TSTCMD_ACK      7  // Acknowledge all received commands up to and
+                           // including the one whose sequence number this
+                           // message carries (the last command executed).
                            // Parameters:
                            //  1:cmdCode [uint8]
-                           //     The command code (e.g. TSTCMD_STATE) to
-                           //     which this is an acknowledgement.
-                           //  1:returnCode [uint8]
-                           //     A value of zero indicates success. Any other
-                           //     value indicates failure.
+                           //     The command code (e.g. TSTCMD_STATE) of the
+                           //     last command executed.
+                           //  2:rxMask [uint8]
+                           //     Bit i is set iff the command with sequence
+                           //     number (ACK's + 2 + i) has been received
+                           //     out of order and is being held.
+                           //  3:returnCodes [list of IPC_WINDOW_SIZE uint8]
+                           //     The return codes of the last commands
+                           //     executed, from the ACK's sequence number
+                           //     backwards. A value of zero indicates success.
+                           //     Any other value indicates failure.
                            // Return:  (none)
 
 /****************************  Type Definitions  ******************************/
@@ -25,14 +25,33 @@
 #define NODEID_UNDEF       0
 #define NODEID_MAX         (MAX_DMXW_CHANS + 1)
 
+// Packet header    hdr = ver:2 | flags:2 | seq:4
+// =======================================================
+// - every packet sent by any node (including gateway) starts with a
+//   one-byte header. (The source and destination node numbers are carried,
+//   and CRC-checked, by the radio's own packet header.)
+//     - ver is the protocol version, DMXW_VERSION. Packets with any other
+//       version are dropped.
+//     - seq is incremented by the sender for each new packet. A
+//       retransmission repeats it with DMXW_HDR_RETRY set, so that the
+//       receiver can recognize a command it has already executed.
+//     - the header is implicit and isn't shown in the command syntax
+//       summaries below
+#define DMXW_HDR_LEN       1
+#define DMXW_VERSION       1
+#define DMXW_HDR_VER_MASK  0xC0
+#define DMXW_HDR_RETRY     0x10  // flags: retransmission of an earlier packet
+#define DMXW_HDR_POLL      0x20  // flags: (CMD_RUN) a CMD_TREQ follows
+#define DMXW_HDR_SEQ_MASK  0x0F
+
+#define DMXW_HDR(flags, seq) \
+          ((DMXW_VERSION << 6) | (flags) | ((seq) & DMXW_HDR_SEQ_MASK))
+#define DMXW_HDR_OK(hdr)   (((hdr) & DMXW_HDR_VER_MASK) == (DMXW_VERSION << 6))
+#define DMXW_HDR_SEQ(hdr)  ((hdr) & DMXW_HDR_SEQ_MASK)
+
 // Command codes   <Command code>(<arg>...)
 // =======================================================
-// - every packet sent by any node (including gateway) starts with
-//   duplicated source and destination node numbers--used to check
-//   for message corruption.
-//     - these are implicit and aren't shown in the command syntax summaries
-//       below
-// - following those is the command code
+// - every packet starts, after the header, with the command code
 // - command packet argument, [X], is an implied destination to which a packet
 //   is sent, either a specific node X (a unicast message),
 //   or if X=ALL (a broadcast message)
@@ -43,17 +62,28 @@
                            // Wireless network is in Run mode. Gateway
                            // broadcasts a packet of time division multiplexed
                            // DMXW channel values.
+                           // Optionally followed by a schedule trailer,
+                           // (t:8, w:8): run frames are sent every t ms and
+                           // the next one is due w ms after this one. Nodes
+                           // may use it to sleep their radio between frames.
+                           // The schedule may in turn be followed by the
+                           // gateway's timebase (c:32, LSB first): its
+                           // millis() count when the frame was built. Nodes
+                           // may lock their effect clocks to it.
                                                       
+#define RUN_SCHED_LEN 2    // Length of the CMD_RUN schedule trailer
+#define RUN_TB_LEN    4    // Length of the timebase following it
+
 // ----- Configuration & Test Commands
 #define CMD_PING      3    // CMD_PING([n:8]) - gateway requests a CMD_PONG
                            //   liveness/existence response from node n.
 #define CMD_PONG      4    // CMD_PONG([g:8]) - Node liveness/existence
                            //   confirmation to DMX gateway, g. Response to
                            //   CMD_PING.
-#define CMD_MAP       5    // CMD_MAP([n:8], d:8, p:8, l:8) - Gateway commands node n
+#define CMD_MAP       5    // CMD_MAP([n:8], d:8, p:8, c:8) - Gateway commands node n
                            //   to map DMXW channel #d to port #p, and if
-                           //   the output is analog, adjust it to a
-                           //   logarithmic scale.
+                           //   the output is analog, shape its values with
+                           //   response curve c (see CURVE_xxx below).
                            //   (Gateway maintains a mapping from DMX-512
                            //    channels to DMXW local wireless network
                            //    channel.)
@@ -66,12 +96,13 @@
                            //   report back the port mapping information for
                            //   the port assigned to DMXW channel d. (CMD_CHAN
                            //   is expected as a response.)
-#define CMD_CHAN      9    // CMD_CHANS([g:8], d:8, p:8, o:8, c:8, a:8, v:8)
+#define CMD_CHAN      9    // CMD_CHANS([g:8], d:8, p:8, o:8, c:8, a:8, v:8, r:8)
                            //   - node reports to gateway g that, assigned to
                            //     DMX channel d, is port p which is mapped
                            //     to output pin o which is either analog
                            //     (a = 1) or digital (a = 0), and potential
-                           //     conflict port c, and current value v.
+                           //     conflict port c, current value v, and
+                           //     response curve r.
 #define CMD_LOC       10   // CMD_LOC([n:8]) - Gateway requests node n to blink
                            //   location beacon to help locate the node.
                            //   (by default, node blinks the onboard LED)
@@ -82,6 +113,47 @@
                            //   set port p value to v.
 #define CMD_CTRL      13   // CMD_CTRL([n:8], d:8, v:8) - Gateway commands node n to
                            //   set port assigned to DMXW channel d to value v.
+#define CMD_CURVE     14   // CMD_CURVE([n:8], o:8, v1:8, ..., vk:8) - Gateway
+                           //   uploads k (<= CURVE_CHUNK_LEN) entries of the
+                           //   user response curve to node n, starting at
+                           //   table offset o. Node stores them in EEPROM.
+                           //   A chunk at o = 0 starts a new upload; the
+                           //   table is used only once the chunk ending at
+                           //   CURVE_TABLE_LEN has been stored.
+#define CMD_TREQ      15   // CMD_TREQ([n:8]) - Gateway requests node n's
+                           //   telemetry. Node n returns it in its ACK,
+                           //   ACK(a:8, v:8, r:8, w:8, f:16, m:16, l:16):
+                           //   supply voltage v (20 mV units), mean and
+                           //   weakest RSSI r and w (-dBm) of gateway
+                           //   packets, f run frames received and m missed,
+                           //   and the longest loop pass l (us), all since
+                           //   the previous CMD_TREQ. (16-bit values are
+                           //   sent MSB first.) A run frame sent with
+                           //   DMXW_HDR_POLL set is followed by a CMD_TREQ,
+                           //   so nodes that sleep their radio between run
+                           //   frames should listen for it.
+#define TELEM_LEN     9    // Length of the telemetry record in the ACK
+#define CMD_PIX       16   // CMD_PIX([n:8], p:8, m:8, d1:8, ..., dk:8) -
+                           //   Gateway streams page p (PIX_PAGE_MASK bits)
+                           //   of a frame of pixel data to pixel node n,
+                           //   packed as per mode m (PIX_xxx). The page
+                           //   holds pixels p * PIX_PAGE_PIXELS(m) onward.
+                           //   PIX_LAST is set in p on a frame's last page,
+                           //   on which the node shows the frame. Sent
+                           //   without an ACK request.
+#define PIX_LAST      0x80 // p: last page of the frame
+#define PIX_PAGE_MASK 0x7F
+#define PIX_RGB       1    // m: 3 bytes per pixel (red, green, blue)
+#define PIX_RGB444    2    // m: 4 bits per colour, 2 pixels in 3 bytes
+                           //   (r0:4 g0:4, b0:4 r1:4, g1:4 b1:4)
+#define PIX_RGB332    3    // m: 1 byte per pixel, r:3 g:3 b:2 (a fixed
+                           //   palette of 256 colours)
+#define PIX_PAGE_LEN  57   // Max pixel data bytes in a CMD_PIX packet
+#define PIX_PAGE_PIXELS(m)  ( ((m) == PIX_RGB)    ? PIX_PAGE_LEN / 3 :     \
+                              ((m) == PIX_RGB444) ? PIX_PAGE_LEN / 3 * 2 : \
+                                                    PIX_PAGE_LEN )
+#define PIX_MAX_PIXELS  170 // Max pixels in a frame (a DMX-512 universe)
+
 #define CMD_TEST      254  // CMD_TEST([n:8]) - Gateway sends test command to
                            //   node n. Response is node-defined.
                            //   No behavioural semantics are implied.
@@ -98,6 +170,46 @@
 #define ACK_ERR       254  // Unspecified error.
 #define ACK_NULL      255  // 'undefined' ACK value
 
+// Response curves for analog output ports (argument c of CMD_MAP)
+#define CURVE_LINEAR  0    // Output value = DMX-512 value.
+#define CURVE_LOG     1    // Perceived linear LED brightness (logarithmic).
+#define CURVE_GAMMA   2    // Gamma 2.2.
+#define CURVE_SCURVE  3    // S-curve (smoothstep); soft at both ends.
+#define CURVE_USER    4    // User table uploaded with CMD_CURVE.
+#define NUM_CURVES    5
+#define CURVE_DIM_FLAG  0x80 // Added to c: drive a digital port as a dimmed
+                             //   (software PWM) output, if the node can.
+#define CURVE_TABLE_LEN  256
+#define CURVE_CHUNK_LEN  8 // Max # of curve entries per CMD_CURVE packet
+
+// On-node effect ports (DMX_Wireless_Node). They're numbered after the
+// output ports and are mapped like any other port (CMD_MAP), but their
+// values drive the node's effect generator rather than a pin. The effect
+// modulates all of the node's mapped outputs. Effect values are in decade
+// bands (e.g. 20 - 29 = FX_CHASE), as on the pixel strip node.
+#define NUM_FX_PORTS    3
+#define FX_PORT_EFFECT  (MAX_PORTS + 1) // Effect (FX_xxx = value / 10)
+#define FX_PORT_RATE    (MAX_PORTS + 2) // Rate, in 0.1 Hz (0 = frozen)
+#define FX_PORT_DEPTH   (MAX_PORTS + 3) // Duty cycle or depth (0 = default)
+#define FX_OFF        0    // No effect: outputs follow their channels.
+#define FX_STROBE     1    // On for depth/256 of each cycle.
+#define FX_CHASE      2    // One output on at a time, a step per cycle,
+                           //   for depth/256 of the step.
+#define FX_PULSE      3    // Breathe; dims by up to depth/256 each cycle.
+#define FX_FLICKER    4    // Random dips of up to depth/256, once a cycle.
+#define NUM_FX        5
+
+// Pixel strip node ports (DMXW_Node_Pixel_Strip). Each of its strip outputs
+// is controlled by a block of PIXEL_BLOCK_PORTS ports (speed, effect and
+// effect arguments #1 - #7): output s (1..MAX_STRIP_OUTPUTS) uses ports
+// (s - 1) * PIXEL_BLOCK_PORTS + 1 to s * PIXEL_BLOCK_PORTS. The port after
+// the last block sets the brightness of all the outputs.
+#define PIXEL_BLOCK_PORTS  9
+#define MAX_STRIP_OUTPUTS  4
+#define PIXEL_PORT_BRIGHTNESS  (MAX_STRIP_OUTPUTS * PIXEL_BLOCK_PORTS + 1)
+#define MAX_NODE_PORTS     PIXEL_PORT_BRIGHTNESS   // Highest port # on any
+                                                   //   kind of node
+
 
 #ifndef Int8
   typedef signed char   Int8;
@@ -118,25 +230,32 @@ typedef struct GatewayMapping
   Uint16   dmx512Chan;  // DMX-512 channel that's mapped to dmxwChan.
   Uint8    nodeId;      // Node assigned to dmxwChan.
   Uint8    port;        // Port of node, nodeId, assigned to dmxwChan.
-  bool     logarithmic; // Port values are to be scaled logarithmically.
+  Uint8    curve;       // Response curve for port values (CURVE_xxx).
   // ??JVS  We probably don't need to store the value here.
   Uint8    value;       // Last known value for dmxwChan
                         //   (ultimately, a DMX-512 channel value).
 } DmxwGwMapRecord_t;
 
 
-// Mapping records used by DMXW nodes to map DMXW channels to Ports.
+// Mapping records used by DMXW nodes to map Ports to DMXW channels. Nodes
+// keep one record per port, indexed by port # - 1, since a node maps only
+// a few of the MAX_DMXW_CHANS DMXW channels.
 typedef struct NodeMapping
 {
-  Int8   port;          // Port assigned to DMXW channel (-1 = no assignment)
-  bool   isOutput;      // Is the port an input (false) or output (true) port?
-  bool   isLogarithmic; // Should DMX-512 values on an analog output be
-                        //   adjusted to a perceived linear brightness scale?
-                        //   Normally, an LED at PWM value 200 looks much less
-                        //   than twice as bright as one at 100.
-  Uint8  value;
+  Uint8  dmxwChan;      // DMXW channel assigned to port (0 = no assignment)
+  Uint8  flags;         // Response curve (CURVE_xxx) applied to DMX-512
+                        //   values on a dimmed output, plus NODEMAP_xxx
+                        //   flags. E.g. CURVE_LOG gives a perceived linear
+                        //   brightness scale; normally, an LED at PWM value
+                        //   200 looks much less than twice as bright as one
+                        //   at 100.
+  Uint8  value;         // Last value output on the port
 } DmxwNodeMapRecord_t;
 
+#define NODEMAP_CURVE_MASK  0x0F            // Response curve (CURVE_xxx)
+#define NODEMAP_OUTPUT      0x40            // Output (else input) port
+#define NODEMAP_DIMMED      CURVE_DIM_FLAG  // Digital port dimmed by s/w PWM
+
 
 // Mapping records used by DMXW nodes to map DMXW channel Ports to I/O pins
 typedef struct PortMapping
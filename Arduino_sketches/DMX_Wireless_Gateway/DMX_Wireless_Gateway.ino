@@ -53,6 +53,29 @@
  *       The DMX_Wireless_Node is not affected because it doesn't use
  *       the DMXSerial library.
  *
+ *   Node telemetry:
+ *      While DMXW is running, one node (with mapped channels) is polled
+ *      with CMD_TREQ every TELEM_POLL_MS, right after a run frame. Its
+ *      report (supply voltage, mean/weakest RSSI of gateway packets, run
+ *      frames received/missed, longest loop pass) comes back in its ACK.
+ *      The last TELEM_HIST_LEN voltage and RSSI readings, the cumulative
+ *      frame loss and the worst loop time of up to TELEM_MAX_NODES nodes
+ *      are kept for the serial "nodes" command.
+ *
+ *   Pixel streaming (serial "pix" command):
+ *      A block of DMX-512 channels (3 per pixel) can be streamed to a pixel
+ *      node, to drive a short strip's pixels directly from the desk or a
+ *      media server. Each frame is sent as CMD_PIX pages, unacknowledged,
+ *      in the gaps between run frames (a page is only started if it will
+ *      be done PIX_PAGE_MS before the next run frame is due). Pixels can
+ *      be sent as 8 bits per colour, 4 bits per colour (2 pixels in 3
+ *      bytes) or 3-3-2 (1 byte), for 19, 38 or 57 pixels per page.
+ *      The stream's settings are kept in EEPROM by "save". "pix" alone
+ *      shows the throughput (pages, frames, pixels and bytes per second),
+ *      and "pixb" streams a test pattern flat out for a while, to measure
+ *      the most the link can sustain (run it with and without "stop" to
+ *      see the share left between run frames).
+ *
  * Console Controls:
  * ================
  *   Control              Pin
@@ -94,7 +117,7 @@
 
 #define COPYRIGHT       "(C)2015, A.J. van Schouwen"
 #define SW_VERSION_c    "1.1 (2015-11-02)"
-#define FW_VERSION_c    9   // Increment (with wraparound) for new F/W;
+#define FW_VERSION_c    10  // Increment (with wraparound) for new F/W;
                             //   clears EEPROM.
 
 //#define DEBUG_ON            // Uncomment to turn off debug output to serial port.
@@ -106,6 +129,8 @@
 #define EEPROM_FW_ADDR             0
 #define EEPROM_NUMDMXNODES_ADDR    1
 #define EEPROM_FIRST_OPEN_ADDR     2
+#define EEPROM_PIX_ADDR  (EEPROM_FIRST_OPEN_ADDR + MAX_DMXW_CHANS * 6 + \
+                          NUM_BUTTONS + NUM_POTS + 2)  // Pixel stream (5)
 #define INVALID_MAP_INDEX  (MAX_DMXW_CHANS + 1)
 
 #define SERIAL_BAUD            9600
@@ -150,8 +175,21 @@
 #define DMXW_TX_DELAY            35  // milliseconds
 #define DMX_SUSPEND_DURATION   2000  // milliseconds
 
+// Node telemetry (CMD_TREQ) polling. One node is polled, in turn, every
+// TELEM_POLL_MS, right after a run frame. The poll is sent only once and
+// its ACK awaited for at most TELEM_ACK_WAIT, so that it fits in the gap
+// before the next run frame.
+#define TELEM_POLL_MS          1000  // milliseconds
+#define TELEM_ACK_WAIT           20  // milliseconds
+#define TELEM_MAX_NODES           8  // # of nodes with telemetry history
+#define TELEM_HIST_LEN            4  // # of reports kept per node
+
 #define DMXW_TEST_MODE            1
 
+// Pixel streaming (CMD_PIX). Pages are sent only if they'll be on the air
+// before the next run frame is due.
+#define PIX_PAGE_MS              11  // Air time of a CMD_PIX page (ms)
+
 
 // Macro for defining strings that are stored in flash (program) memory rather
 // than in RAM. Arduino defines the non-descript F("string") syntax.
@@ -193,9 +231,17 @@ bool deferDmx512 = false;
 bool dmx512Suspended = true;
 Uint8 quiteMode = 0;  // Set to non-zero for quiet output from "n" serial cmd
 
-Uint8 buffer[MAX_DATA_LEN];
+// Received packets are decoded in place, through rxBuf, straight out of
+// the radio's receive buffer. (It isn't touched again until the next
+// receiveDone() or send.) Outgoing packets are built in buffer[], which
+// is preceded by DMXW_HDR_LEN bytes of headroom for sendBuffer()'s header.
+const Uint8 *rxBuf = NULL;
+Uint8 rxSize = 0;
+Uint8 txPkt[MAX_DATA_LEN];
+Uint8 * const buffer = &txPkt[DMXW_HDR_LEN];
 Uint8 bufSize = 0;
 Uint8 currReadPos = 0;
+#define TXBUF_LEN  (MAX_DATA_LEN - DMXW_HDR_LEN)
 
 char  serialBuffer[MAX_SERIAL_BUF_LEN];
 Uint8 serialPos = 0;
@@ -205,6 +251,8 @@ Uint8   command = 0;
 Uint8   cmdInProgress = CMD_UNDEF; // Multi-cycle command when not CMD_UNDEF
 Int8    iteration = -1;
 Uint8   ackBuf[1];
+Uint8   txSeq = 0;      // Sequence # of the next packet sent (see DMXW_HDR)
+Uint8   txFlags = 0;    // DMXW_HDR flags for the next packet sent
 bool    saveNodes = false;
 
 // DMXW Channel Test Mode variables
@@ -237,6 +285,41 @@ DmxwGwMapRecord_t  tmpMapRecord;
 Uint8  nodeList[MAX_DMXW_CHANS];
 Uint8  numNodes = 0;
 
+// Telemetry history per node (serial "nodes" command)
+typedef struct nodeTelem_t {
+  Uint8   nodeId;                 // 0 = unused entry
+  Uint8   noAcks;                 // Consecutive unanswered polls
+  Uint8   histPos;                // Index of the newest report below
+  Uint8   vcc[TELEM_HIST_LEN];    // Supply voltage (20 mV units; 0 = none)
+  Uint8   rssi[TELEM_HIST_LEN];   // Mean RSSI of gateway packets (-dBm)
+  Uint8   rssiWorst;              // Weakest RSSI reported (-dBm)
+  Uint8   rssiUp;                 // RSSI of the node's last ACK (-dBm)
+  Uint16  frames;                 // Run frames received ...
+  Uint16  missed;                 // ... and missed (halved together)
+  Uint16  loopMax;                // Longest loop() pass reported (us)
+  unsigned long lastSeen;         // millis() of the last report
+} NodeTelem_t;
+NodeTelem_t nodeTelem[TELEM_MAX_NODES];
+Uint8   telemNode = 0;            // Node polled last
+bool    telemPollPending = false; // Poll telemNode after this run frame
+unsigned long telemPollTime = 0;
+
+// Pixel stream (serial "pix" command): a block of DMX-512 channels sent to
+// a pixel node as frames of CMD_PIX pages, between run frames.
+typedef struct pixStream_t {
+  Uint8   nodeId;                 // Pixel node (0 = not streaming)
+  Uint16  dmx512Chan;             // DMX-512 channel of pixel 1's red
+  Uint8   numPixels;              // Pixels per frame (3 channels each)
+  Uint8   mode;                   // Packing (PIX_xxx)
+  Uint8   page;                   // Next page to send
+  unsigned long benchEnd;         // End of the benchmark (0 = none)
+  unsigned long statsStart;       // millis() at stats reset
+  unsigned long pages;            // Pages sent ...
+  unsigned long frames;           // ... frames completed ...
+  unsigned long bytes;            // ... and pixel data bytes sent
+} PixStream_t;
+PixStream_t pixStream;
+
 typedef struct buttonData_t {
   Int8    dmxwChan;
   Uint8   pin;
@@ -280,6 +363,13 @@ void EepromLoad()
 {
   int addr;
 
+  addr = EEPROM_PIX_ADDR;
+  pixStream.nodeId      = EEPROM.read(addr++);
+  pixStream.dmx512Chan  = ((Uint16)(EEPROM.read(addr++))) << 8;
+  pixStream.dmx512Chan |= (Uint16)EEPROM.read(addr++);
+  pixStream.numPixels   = EEPROM.read(addr++);
+  pixStream.mode        = EEPROM.read(addr++);
+
   numDmxwChans = EEPROM.read(EEPROM_NUMDMXNODES_ADDR);
   if (numDmxwChans == 0)
     return;
@@ -292,7 +382,7 @@ void EepromLoad()
     dmxMap[i].dmx512Chan |= (Uint16)EEPROM.read(addr++);
     dmxMap[i].nodeId      = EEPROM.read(addr++);
     dmxMap[i].port        = EEPROM.read(addr++);
-    dmxMap[i].logarithmic = EEPROM.read(addr++);
+    dmxMap[i].curve       = EEPROM.read(addr++);
     //dmxMap[i].value       = EEPROM.read(addr++); // Don't store the value
     dmxMap[i].value       = 0;
   }
@@ -317,7 +407,7 @@ void EepromSave()
     EEPROM.write(addr++, (byte)(dmxMap[i].dmx512Chan & 0x00ff));
     EEPROM.write(addr++, dmxMap[i].nodeId);
     EEPROM.write(addr++, dmxMap[i].port);
-    EEPROM.write(addr++, dmxMap[i].logarithmic);
+    EEPROM.write(addr++, dmxMap[i].curve);
     //EEPROM.write(addr++, dmxMap[i].value); // Don't store the value
   }
   for (Uint8 i = 0; i < NUM_BUTTONS; i++)
@@ -326,6 +416,13 @@ void EepromSave()
     EEPROM.write(addr++, potMap[i].dmxwChan);
   EEPROM.write(addr++, joystick.dmxwChan_x);
   EEPROM.write(addr++, joystick.dmxwChan_y);
+
+  addr = EEPROM_PIX_ADDR;
+  EEPROM.write(addr++, pixStream.nodeId);
+  EEPROM.write(addr++, (byte)(pixStream.dmx512Chan >> 8));
+  EEPROM.write(addr++, (byte)(pixStream.dmx512Chan & 0x00ff));
+  EEPROM.write(addr++, pixStream.numPixels);
+  EEPROM.write(addr++, pixStream.mode);
 }
 
 AckCode_t handleCmdPing()
@@ -346,21 +443,21 @@ AckCode_t handleCmdPong()
 AckCode_t handleCmdChan()
 {
   char   logTxt[81];
-  Int8   dmxwChan     = buffer[currReadPos++];
-  Int8   port         = buffer[currReadPos++];
-  Int8   outPin       = buffer[currReadPos++];
-  Int8   conflictPort = buffer[currReadPos++];
-  Uint8  isAnalog     = buffer[currReadPos++];
-  Uint8  value        = buffer[currReadPos++];
-  Uint8  logarithmic  = buffer[currReadPos++];
+  Int8   dmxwChan     = rxBuf[currReadPos++];
+  Int8   port         = rxBuf[currReadPos++];
+  Int8   outPin       = rxBuf[currReadPos++];
+  Int8   conflictPort = rxBuf[currReadPos++];
+  Uint8  isAnalog     = rxBuf[currReadPos++];
+  Uint8  value        = rxBuf[currReadPos++];
+  Uint8  curve        = rxBuf[currReadPos++];
 
   if (port == -1)
     sprintf(logTxt, "DmxwChan:%3d, Node:%2d   *** Not Mapped!",
             dmxwChan, srcNodeId);
   else
-    sprintf(logTxt, "DmxwChan:%3d, Node:%2d, Port:%2d, Log?(%1s), "
+    sprintf(logTxt, "DmxwChan:%3d, Node:%2d, Port:%2d, Curve:%1d, "
                     "OutPin:%2d, Value:%3d%s",
-            dmxwChan, srcNodeId, port, logarithmic ? "Y" : "N", outPin, value,
+            dmxwChan, srcNodeId, port, curve, outPin, value,
             isAnalog ? "(Analog) " : "(Digital)");
   logPrint(logTxt);
 
@@ -410,6 +507,7 @@ AckCode_t handleNetRxMessage(Uint8 command)
     case CMD_OFF:
     case CMD_PORT:
     case CMD_CTRL:
+    case CMD_CURVE:
     case CMD_TEST:
     case CMD_SAVE:   ret = ACK_ECMD;             break;
       
@@ -445,6 +543,8 @@ void printCommand(Uint8 command)
     case CMD_OFF:    dbgPrint(FLASH("CMD_OFF"));     break;
     case CMD_PORT:   dbgPrint(FLASH("CMD_PORT"));    break;
     case CMD_CTRL:   dbgPrint(FLASH("CMD_CTRL"));    break;
+    case CMD_CURVE:  dbgPrint(FLASH("CMD_CURVE"));   break;
+    case CMD_PIX:    dbgPrint(FLASH("CMD_PIX"));     break;
     case CMD_TEST:   dbgPrint(FLASH("CMD_TEST"));    break;
     case CMD_SAVE:   dbgPrint(FLASH("CMD_SAVE"));    break;
     case CMD_UNDEF:  dbgPrint(FLASH("CMD_UNDEF"));   break;
@@ -475,7 +575,8 @@ void printAckResult(Uint8 ackResult)
 }
 
 
-// Send a message to a node on the wireless network
+// Send a message to a node on the wireless network. The packet header is
+// written into the DMXW_HDR_LEN bytes of headroom in front of payload.
 AckCode_t sendBuffer(int dst, Uint8 *payload, int sendSize, bool requestAck)
 {
   unsigned long sentTime;
@@ -495,8 +596,14 @@ AckCode_t sendBuffer(int dst, Uint8 *payload, int sendSize, bool requestAck)
 
   if (dst == BROADCASTID)
     requestAck = false;
+  payload -= DMXW_HDR_LEN;
+  sendSize += DMXW_HDR_LEN;
+  payload[0] = DMXW_HDR(txFlags, txSeq++);
+  txFlags = 0;
   for (byte i = 0; i <= TX_NUM_RETRIES; i++)
   { 
+    if (i > 0)
+      payload[0] |= DMXW_HDR_RETRY;
     radio.send(dst, payload, sendSize, requestAck);
     sentTime = millis();
     if (requestAck)
@@ -577,7 +684,7 @@ bool existsDmxMapPair(Uint8 startIdx, Uint8 nodeId, Uint8 port)
 }
 
 void writeDmxMapRecord(Uint8 idx,Uint16 dmx512Chan, Uint8 dmxwChan,
-                       Uint8 nodeId, Uint8 port, bool logarithmic)
+                       Uint8 nodeId, Uint8 port, Uint8 curve)
 {
   DmxwGwMapRecord_t tmp;
   
@@ -585,7 +692,7 @@ void writeDmxMapRecord(Uint8 idx,Uint16 dmx512Chan, Uint8 dmxwChan,
   tmp.dmx512Chan  = dmx512Chan;
   tmp.nodeId      = nodeId;
   tmp.port        = port;
-  tmp.logarithmic = logarithmic;
+  tmp.curve       = curve;
   tmp.value       = 0;
   dmxMap[idx] = tmp;
 }
@@ -623,7 +730,7 @@ bool shiftDownMapRecords(Uint8 idx)
 }
   
 bool addDmxMap(Uint16 dmx512Chan, Uint8 dmxwChan, Uint8 nodeId, Uint8 port,
-               bool logarithmic)
+               Uint8 curve)
 {
   Uint8 idx;
   Uint8 tmpChan;
@@ -639,7 +746,8 @@ bool addDmxMap(Uint16 dmx512Chan, Uint8 dmxwChan, Uint8 nodeId, Uint8 port,
   if ( (dmx512Chan == 0) || (dmxwChan == 0) || (nodeId == 0) || (port == 0))
     return false;
   if ( (dmx512Chan > MAX_DMX512_CHANS) || (dmxwChan > MAX_DMXW_CHANS) ||
-       (nodeId > NODEID_MAX) || (port > MAX_PORTS)  )
+       (nodeId > NODEID_MAX) || (port > MAX_NODE_PORTS) ||
+       ((curve & ~CURVE_DIM_FLAG) >= NUM_CURVES) )
     return false;
   
   // Check for duplicate channel numbers or (nodeId, port) pairs
@@ -663,12 +771,12 @@ bool addDmxMap(Uint16 dmx512Chan, Uint8 dmxwChan, Uint8 nodeId, Uint8 port,
     if ( (tmpChan == 0) || (tmpChan > dmxwChan))
     {
       shiftUpMapRecords(idx);
-      writeDmxMapRecord(idx, dmx512Chan, dmxwChan, nodeId, port, logarithmic);
+      writeDmxMapRecord(idx, dmx512Chan, dmxwChan, nodeId, port, curve);
       bufSize = 0;
       buffer[bufSize++] = CMD_MAP;
       buffer[bufSize++] = dmxwChan;
       buffer[bufSize++] = port;
-      buffer[bufSize++] = logarithmic;
+      buffer[bufSize++] = curve;
       node = nodeId;
       dataToSend = true;
       return true;
@@ -734,6 +842,8 @@ void datafillDmxwRunPacket(void)
   Uint8 idx;
   int tmpValue;
   int tmpChan;
+  long nextIn;
+  unsigned long now;
   
   if (numDmxwChans == 0)
     return;
@@ -770,7 +880,7 @@ void datafillDmxwRunPacket(void)
   }
     
   bufSize = 0;
-  memset(buffer, 0, sizeof(buffer));
+  memset(buffer, 0, TXBUF_LEN);
   buffer[bufSize++] = CMD_RUN;
   
   // Datafill all DMXW channel values into the CMD_RUN packet.
@@ -836,8 +946,292 @@ void datafillDmxwRunPacket(void)
   }
   
   bufSize = DATA_START + MAX_DMXW_CHANS;
+
+  // Append the run schedule so that battery nodes can sleep their radios
+  // until just before the next run frame.
+  nextIn = (long)(dmxwTxTime - millis());
+  buffer[bufSize++] = DMXW_TX_DELAY;
+  buffer[bufSize++] = constrain(nextIn, 0, 255);
+
+  // Append the timebase, so that pixel nodes can keep their effects in
+  // step with each other.
+  now = millis();
+  for (i = 0; i < RUN_TB_LEN; i++)
+  {
+    buffer[bufSize++] = (Uint8)now;
+    now >>= 8;
+  }
   node = BROADCASTID;
   dataToSend = true;
+
+  // Flag the frame if a telemetry poll is to follow it, so that nodes
+  // that sleep their radio between frames listen for it.
+  if ((millis() - telemPollTime) >= TELEM_POLL_MS)
+  {
+    telemPollTime = millis();
+    telemNode = nextTelemNode(telemNode);
+    if (telemNode != 0)
+    {
+      telemPollPending = true;
+      txFlags = DMXW_HDR_POLL;
+    }
+  }
+}
+
+
+// Build the next page of the pixel stream: its pixels' channel values,
+// read from DMX-512 (or a moving test pattern, while benchmarking), and
+// packed as per pixStream.mode.
+void datafillPixPage(void)
+{
+  Uint8 perPage = PIX_PAGE_PIXELS(pixStream.mode);
+  Uint8 first = pixStream.page * perPage;
+  Uint8 count = pixStream.numPixels - first;
+  Uint8 rgb[3];
+  bool  last;
+
+  if (count > perPage)
+    count = perPage;
+  last = (first + count >= pixStream.numPixels);
+
+  bufSize = 0;
+  buffer[bufSize++] = CMD_PIX;
+  buffer[bufSize++] = pixStream.page | (last ? PIX_LAST : 0);
+  buffer[bufSize++] = pixStream.mode;
+  for (Uint8 i = 0; i < count; i++)
+  {
+    for (Uint8 c = 0; c < 3; c++)
+    {
+      if (pixStream.benchEnd != 0)
+        rgb[c] = (first + i) * 8 + pixStream.frames * (c + 1);
+      else
+        rgb[c] = DMXSerial.read(pixStream.dmx512Chan + (first + i) * 3 + c);
+    }
+    switch (pixStream.mode)
+    {
+      case PIX_RGB:
+        buffer[bufSize++] = rgb[0];
+        buffer[bufSize++] = rgb[1];
+        buffer[bufSize++] = rgb[2];
+        break;
+
+      case PIX_RGB444:
+        if ((i & 1) == 0)
+        {
+          buffer[bufSize++] = (rgb[0] & 0xF0) | (rgb[1] >> 4);
+          buffer[bufSize++] = rgb[2] & 0xF0;
+        }
+        else
+        {
+          buffer[bufSize - 1] |= rgb[0] >> 4;
+          buffer[bufSize++] = (rgb[1] & 0xF0) | (rgb[2] >> 4);
+        }
+        break;
+
+      default:  // PIX_RGB332
+        buffer[bufSize++] = (rgb[0] & 0xE0) | ((rgb[1] >> 3) & 0x1C) |
+                            (rgb[2] >> 6);
+    }
+  }
+  node = pixStream.nodeId;
+  requestAck = false;
+  dataToSend = true;
+
+  pixStream.pages++;
+  pixStream.bytes += bufSize - 3;
+  if (last)
+  {
+    pixStream.frames++;
+    pixStream.page = 0;
+  }
+  else
+    pixStream.page++;
+}
+
+
+// Show the pixel stream's settings and throughput since the last call,
+// then reset the statistics.
+void showPixStream()
+{
+  unsigned long elapsed = millis() - pixStream.statsStart;
+
+  if (pixStream.nodeId == 0)
+  {
+    logPrintln(FLASH("Pixel streaming is off"));
+    return;
+  }
+  logPrint(FLASH("Pixel stream to node #"));
+  logPrint(pixStream.nodeId);
+  logPrint(FLASH(": "));
+  logPrint(pixStream.numPixels);
+  logPrint(FLASH(" pixels from DMX-512 chan "));
+  logPrint(pixStream.dmx512Chan);
+  logPrint(FLASH(", mode "));
+  logPrintln(pixStream.mode);
+  if (elapsed >= 100)
+  {
+    logPrint(FLASH("  Pages/s: "));
+    logPrint((pixStream.pages * 10) / (elapsed / 100));
+    logPrint(FLASH("  Frames/s: "));
+    logPrint((pixStream.frames * 10) / (elapsed / 100));
+    logPrint(FLASH("  Pixels/s: "));
+    logPrint((pixStream.frames * pixStream.numPixels * 10) / (elapsed / 100));
+    logPrint(FLASH("  Bytes/s: "));
+    logPrint((pixStream.bytes * 10) / (elapsed / 100));
+    logPrint(FLASH("  (in "));
+    logPrint(elapsed);
+    logPrintln(FLASH("ms)"));
+  }
+  pixStream.pages = pixStream.frames = pixStream.bytes = 0;
+  pixStream.statsStart += elapsed;
+}
+
+
+// Next node after node, in node # order (wrapping around), that has
+// DMXW channels mapped to it. 0 if there are none.
+Uint8 nextTelemNode(Uint8 node)
+{
+  Uint8 first = 0;
+  Uint8 next = 0;
+  Uint8 id;
+
+  for (Uint8 i = 0; i < numDmxwChans; i++)
+  {
+    id = dmxMap[i].nodeId;
+    if ((id == NODEID_UNDEF) || (id == BROADCASTID))
+      continue;
+    if ((first == 0) || (id < first))
+      first = id;
+    if ((id > node) && ((next == 0) || (id < next)))
+      next = id;
+  }
+  return next ? next : first;
+}
+
+
+// Index of the nodeTelem[] entry of nodeId. A new entry is set up if
+// there's none yet. -1 if the table is full.
+Int8 findNodeTelem(Uint8 nodeId)
+{
+  Int8 freeIdx = -1;
+
+  for (Uint8 i = 0; i < TELEM_MAX_NODES; i++)
+  {
+    if (nodeTelem[i].nodeId == nodeId)
+      return i;
+    if ((nodeTelem[i].nodeId == 0) && (freeIdx == -1))
+      freeIdx = i;
+  }
+  if (freeIdx != -1)
+  {
+    memset(&nodeTelem[freeIdx], 0, sizeof(NodeTelem_t));
+    nodeTelem[freeIdx].nodeId = nodeId;
+  }
+  return freeIdx;
+}
+
+
+// Request telemetry from nodeId (CMD_TREQ) and add the report returned
+// in its ACK to the node's history.
+void pollNodeTelem(Uint8 nodeId)
+{
+  Int8 idx = findNodeTelem(nodeId);
+  NodeTelem_t *t;
+  Uint8 pkt[DMXW_HDR_LEN + 1];
+  const volatile Uint8 *rpt = &radio.DATA[1];
+  unsigned long sentTime;
+  Uint16 frames, missed, loop;
+
+  if (idx == -1)
+    return;
+  t = &nodeTelem[idx];
+  pkt[0] = DMXW_HDR(0, txSeq++);
+  pkt[DMXW_HDR_LEN] = CMD_TREQ;
+  if (t->noAcks < 255)
+    t->noAcks++;
+  radio.send(nodeId, pkt, sizeof(pkt), true);
+  sentTime = millis();
+  while ((millis() - sentTime) < TELEM_ACK_WAIT)
+  {
+    if (radio.ACKReceived(nodeId))
+    {
+      if ( (radio.DATALEN < (1 + TELEM_LEN)) || (radio.DATA[0] != ACK_OK) )
+        return;
+      t->noAcks = 0;
+      t->lastSeen = millis();
+      t->rssiUp = -radio.RSSI;
+      t->histPos = (t->histPos + 1) % TELEM_HIST_LEN;
+      t->vcc[t->histPos] = rpt[0];
+      t->rssi[t->histPos] = rpt[1];
+      if (rpt[2] > t->rssiWorst)
+        t->rssiWorst = rpt[2];
+      frames = ((Uint16)rpt[3] << 8) | rpt[4];
+      missed = ((Uint16)rpt[5] << 8) | rpt[6];
+      loop   = ((Uint16)rpt[7] << 8) | rpt[8];
+      // Keep the loss ratio, rather than the counts, when they get large.
+      while ( ((Uint16)(t->frames + frames) < t->frames) ||
+              ((Uint16)(t->missed + missed) < t->missed) )
+      {
+        t->frames /= 2;
+        t->missed /= 2;
+        frames /= 2;
+        missed /= 2;
+      }
+      t->frames += frames;
+      t->missed += missed;
+      if (loop > t->loopMax)
+        t->loopMax = loop;
+      return;
+    }
+  }
+}
+
+
+// Serial "nodes" command: show the telemetry history of the nodes.
+void showNodeTelem()
+{
+  char   txt[24];
+  Uint8  idx;
+  Uint16 mv;
+  NodeTelem_t *t;
+
+  logPrintln(FLASH("Node  Vcc (V) newest..oldest   RSSI -dBm avg/min/up  "
+                   "Frames  Lost   Loop(us) Seen(s) NoAck"));
+  for (Uint8 i = 0; i < TELEM_MAX_NODES; i++)
+  {
+    t = &nodeTelem[i];
+    if (t->nodeId == 0)
+      continue;
+    sprintf(txt, "%4d ", t->nodeId);
+    logPrint(txt);
+    for (Uint8 h = 0; h < TELEM_HIST_LEN; h++)
+    {
+      idx = (t->histPos + TELEM_HIST_LEN - h) % TELEM_HIST_LEN;
+      mv = t->vcc[idx] * 20;
+      if (mv == 0)
+        sprintf(txt, "   -  ");
+      else
+        sprintf(txt, " %2d.%02d", mv / 1000, (mv % 1000) / 10);
+      logPrint(txt);
+    }
+    sprintf(txt, "     %3d/%3d/%3d     ",
+            t->rssi[t->histPos], t->rssiWorst, t->rssiUp);
+    logPrint(txt);
+    mv = (t->frames + t->missed) ?
+           (Uint16)(1000UL * t->missed / ((unsigned long)t->frames + t->missed))
+           : 0;
+    sprintf(txt, "%6u %3u.%u%% ", t->frames, mv / 10, mv % 10);
+    logPrint(txt);
+    sprintf(txt, "%7u ", t->loopMax);
+    logPrint(txt);
+    if (t->lastSeen == 0)
+      sprintf(txt, "      - ");
+    else
+      sprintf(txt, "%7lu ", (millis() - t->lastSeen) / 1000);
+    logPrint(txt);
+    sprintf(txt, "%5d", t->noAcks);
+    logPrintln(txt);
+  }
 }
 
 
@@ -893,7 +1287,7 @@ void showSerialHelp()
   logPrintln(FLASH("Serial port commands are enabled. Commands are:"));
   logPrintln(FLASH("  (spaces may replaces commas)"));
   logPrint(FLASH("<x> in {1...512};  <n> in {1...20}; <d> in {1...48};  "));
-  logPrintln(FLASH("<p> in {1...16};  <v> in {0...255}"));
+  logPrintln(FLASH("<p> in {1...36};  <v> in {0...255}"));
   logPrintln(FLASH("  c[b|j|p] <i>,<d>     - Map console button i, joystick, or "
                                               "potentiometer i to DMXW "));
   logPrintln(FLASH("                         channel d (d=0) to delete. ["
@@ -905,21 +1299,42 @@ void showSerialHelp()
                                                  "or at all nodes (n = 255)"));
   }
   logPrintln(FLASH("  free                 - Display free RAM"));
+  logPrintln(FLASH("  pix [<n>,<x>,<l>,<m>] - Stream l pixels from DMX-512 "
+                                               "chans x on to pixel node n,"));
+  logPrintln(FLASH("                           packed as m (1=RGB, 2=4 bits "
+                                               "per colour, 3=RGB 3-3-2)"));
+  logPrintln(FLASH("                           (n=0: stop; no args: show "
+                                               "pixel throughput)"));
+  logPrintln(FLASH("  pixb <t>             - Benchmark pixel streaming for "
+                                               "<t> seconds"));
+  logPrintln(FLASH("  nodes                - Show node telemetry (supply "
+                                               "voltage, RSSI, frame loss, "));
+  logPrintln(FLASH("                           loop time)"));
   logPrintln(FLASH("  h                    - Print this help text"));
   if (!dmx512Running)
   {
     logPrintln(FLASH("  l <n>                - Locate node n"));
-    logPrintln(FLASH("  m <x>,<d>,<n>,<p>,<l> - Map DMX-512 chan x to DMXW "
+    logPrintln(FLASH("  m <x>,<d>,<n>,<p>,<c> - Map DMX-512 chan x to DMXW "
                                                "chan d, which is assigned to "));
-    logPrintln(FLASH("                           node n port p (l=1 means "
-                                                "scale logarithmically; 0 "
-                                                "otherwise)"));
+    logPrintln(FLASH("                           node n port p, using response "
+                                                "curve c (0=linear, 1=log, "));
+    logPrintln(FLASH("                           2=gamma 2.2, 3=S-curve, "
+                                                "4=user)"));
+    logPrintln(FLASH("                           (add 128 to c to dim a "
+                                                "digital port)"));
+    logPrintln(FLASH("                           (ports 17-19 set the "
+                                                "node's effect, rate & depth)"));
+    logPrintln(FLASH("                           (pixel nodes: ports 1-9, "
+                                                "10-18, ... control strip "));
+    logPrintln(FLASH("                           outputs 1, 2, ...)"));
     logPrintln(FLASH("  n [<v>]              - Show all DMXW channel mapping "
                                                  "detail for all known "
                                                  "channels."));
     logPrintln(FLASH("                           (quiet mode if v present & not 0)"));
     logPrintln(FLASH("  p <n>                - Ping node n / all nodes (n = 255)"));
     logPrintln(FLASH("  r <x>                - Remove map for DMX-512 chan x "));
+    logPrintln(FLASH("  u <n>,<g>            - Upload a gamma g/10 user response "
+                                                 "curve to node n"));
   }
   logPrintln(FLASH("  s                    - Show DMX channel mappings and DMXW "
                                                "channel values"));
@@ -992,7 +1407,8 @@ void getSerialCommand()
   Uint8  dmxwChan = 0;
   Uint16 dmx512Chan = 0;
   Uint8  idx = 0;
-  Uint8  logarithmic = 0;
+  Uint8  curve = 0;
+  int    pixels = 0;
   bool   cmdToProcess = false;
   bool   cmdInvalid = false;
   bool   blockWhileRunning = true;
@@ -1085,6 +1501,16 @@ void getSerialCommand()
           break;
           // Not the "free" command. So fall thru.
           
+        case 'n':
+          if (strstr(serialBuffer, "nodes") != null)
+            blockWhileRunning = false;
+          break;
+          
+        case 'p':
+          if (strstr(serialBuffer, "pix") != null)
+            blockWhileRunning = false;
+          break;
+          
         default:
           break;
       }
@@ -1119,12 +1545,10 @@ void getSerialCommand()
               if (dmxMap[i].nodeId == node)
               {
                 bufSize = 0;
-                buffer[bufSize++] = myNodeId;
-                buffer[bufSize++] = node;
                 buffer[bufSize++] = CMD_MAP;
                 buffer[bufSize++] = dmxMap[i].dmxwChan;
                 buffer[bufSize++] = dmxMap[i].port;
-                buffer[bufSize++] = dmxMap[i].logarithmic;
+                buffer[bufSize++] = dmxMap[i].curve;
                 logPrint(FLASH("Copying DMXW chan #"));
                 logPrint(dmxMap[i].dmxwChan);
                 logPrint(FLASH(" to node #"));
@@ -1242,16 +1666,16 @@ void getSerialCommand()
         break;
         
       case 'm':
-        // m <x>, <d>, <n>, <p>, <l>
+        // m <x>, <d>, <n>, <p>, <c>
         // Map DMX-512 channel x to DMXW channel d which is, in turn, to
-        // be assigned to node n, port p, (whose values are to be scaled
-        // logarithmically when l=1)
+        // be assigned to node n, port p, (whose values are to be shaped
+        // by response curve c)
         dmx512Chan  = serialParseInt();
         dmxwChan    = serialParseInt();
         node        = serialParseInt();
         port        = serialParseInt();
-        logarithmic = serialParseInt();
-        if (!addDmxMap(dmx512Chan, dmxwChan, node, port, logarithmic))
+        curve       = serialParseInt();
+        if (!addDmxMap(dmx512Chan, dmxwChan, node, port, curve))
         {
           logPrintln(FLASH("*** Unable to add Channel Map. Check "
                                "arguments and table"));
@@ -1271,6 +1695,13 @@ void getSerialCommand()
         break;
         
       case 'n':
+        if (strstr(serialBuffer, "nodes") != NULL)
+        {
+          // nodes
+          // Show the telemetry history of the nodes.
+          showNodeTelem();
+          break;
+        }
         // n [<v>]
         // Show all DMXW channel mapping details for all nodes.
         // (Quiet mode if v present and not 0.)
@@ -1280,6 +1711,64 @@ void getSerialCommand()
         break;
         
       case 'p':
+        if (strstr(serialBuffer, "pixb") != NULL)
+        {
+          // pixb <t>
+          // Benchmark pixel streaming: stream a test pattern for t seconds,
+          // as fast as the link allows.
+          serialPos += 3;
+          if (pixStream.nodeId == 0)
+          {
+            logPrintln(FLASH("*** Set up pixel streaming first (pix)"));
+            break;
+          }
+          pixStream.benchEnd = millis() + serialParseInt() * 1000UL;
+          pixStream.page = 0;
+          pixStream.statsStart = millis();
+          pixStream.pages = pixStream.frames = pixStream.bytes = 0;
+          logPrintln(FLASH("Pixel streaming benchmark started"));
+          break;
+        }
+        if (strstr(serialBuffer, "pix") != NULL)
+        {
+          // pix [<n>, <x>, <l>, <m>]
+          // Stream l pixels, from DMX-512 channels x on, to pixel node n
+          // packed as per mode m. (n = 0 stops streaming. With no
+          // arguments, show the stream's throughput.)
+          serialPos += 2;
+          if (serialBuffer[3] == '\0')
+          {
+            showPixStream();
+            break;
+          }
+          node       = serialParseInt();
+          dmx512Chan = serialParseInt();
+          pixels     = serialParseInt();
+          val        = serialParseInt();
+          if (node == 0)
+          {
+            pixStream.nodeId = 0;
+            logPrintln(FLASH("Pixel streaming stopped"));
+            break;
+          }
+          if ( (node < 2) || (node > NODEID_MAX) || (dmx512Chan < 1) ||
+               (pixels < 1) || (pixels > PIX_MAX_PIXELS) ||
+               (dmx512Chan + pixels * 3 - 1 > MAX_DMX512_CHANS) ||
+               (val < PIX_RGB) || (val > PIX_RGB332) )
+          {
+            cmdInvalid = true;
+            break;
+          }
+          pixStream.nodeId     = node;
+          pixStream.dmx512Chan = dmx512Chan;
+          pixStream.numPixels  = pixels;
+          pixStream.mode       = val;
+          pixStream.page       = 0;
+          pixStream.statsStart = millis();
+          pixStream.pages = pixStream.frames = pixStream.bytes = 0;
+          logPrintln(FLASH("Pixel streaming set (type 'save' to keep it)"));
+          break;
+        }
         // p <n>
         // Ping node n
         node = serialParseInt();
@@ -1400,9 +1889,9 @@ void getSerialCommand()
           logPrint(FLASH("# entries: ")); logPrintln(numDmxwChans);
           if (numDmxwChans)
           {
-            logPrintln(FLASH("Idx\tDMX-512\tDMXW\tNode\tPort\tLog?\tValue"
+            logPrintln(FLASH("Idx\tDMX-512\tDMXW\tNode\tPort\tCurve\tValue"
                              "\tConsole"));
-            logPrintln(FLASH("---\t-------\t----\t----\t----\t----\t-----"
+            logPrintln(FLASH("---\t-------\t----\t----\t----\t-----\t-----"
                              "\t-------"));
             for (Uint8 idx = 0; idx < MAX_DMXW_CHANS; idx++)
             {
@@ -1411,7 +1900,7 @@ void getSerialCommand()
               dmxwChan    = tmp->dmxwChan;
               node        = tmp->nodeId;
               port        = tmp->port;
-              logarithmic = tmp->logarithmic;
+              curve       = tmp->curve;
               val         = tmp->value;
               if (dmxwChan)
               {
@@ -1420,7 +1909,7 @@ void getSerialCommand()
                 logPrint(dmxwChan); logPrint("\t");
                 logPrint(node); logPrint("\t");
                 logPrint(port); logPrint("\t");
-                logPrint(logarithmic); logPrint("\t");
+                logPrint(curve); logPrint("\t");
                 logPrint(val); logPrint("\t");
                 for (Uint8 i = 0; i < NUM_BUTTONS; i++)
                   if (buttonMap[i].dmxwChan == dmxwChan)
@@ -1533,6 +2022,43 @@ void getSerialCommand()
           cmdInvalid = true;
         break;
 
+      case 'u':
+        // u <n>, <g>
+        // Upload a user response curve, v' = 255 * (v/255)^(g/10), to
+        // node n, CURVE_CHUNK_LEN entries per CMD_CURVE packet.
+        node = serialParseInt();
+        val  = serialParseInt();
+        if ( (node < 2) || (node > NODEID_MAX) || (val == 0) )
+        {
+          cmdInvalid = true;
+          break;
+        }
+        for (Uint16 offs = 0; offs < CURVE_TABLE_LEN; offs += CURVE_CHUNK_LEN)
+        {
+          bufSize = 0;
+          buffer[bufSize++] = CMD_CURVE;
+          buffer[bufSize++] = offs;
+          for (Uint8 i = 0; i < CURVE_CHUNK_LEN; i++)
+            buffer[bufSize++] = (Uint8)(255.0 * pow((offs + i) / 255.0,
+                                                    val / 10.0) + 0.5);
+          ackBuf[0] = sendBuffer(node, buffer, bufSize, true);
+          if (ackBuf[0] != ACK_OK)
+          {
+            logPrint(FLASH("*** Curve upload failed at entry "));
+            logPrint(offs);
+            logPrint(FLASH(": "));
+            printAckResult(ackBuf[0]);
+            logPrintln();
+            break;
+          }
+          // Give the node time to write the entries to its EEPROM.
+          delay(CURVE_CHUNK_LEN * 4);
+        }
+        if (ackBuf[0] == ACK_OK)
+          logPrintln(FLASH("User curve uploaded."));
+        bufSize = 0;
+        break;
+
       case 'z':
         // z <n>, <p>, <v>
         // Send Ctrl(p, v) to node n
@@ -1565,18 +2091,16 @@ void dumpBuffer()
   
   logPrint(FLASH("\n\rDUMP:  Src["));
   logPrint(srcNodeId);
-  logPrint(FLASH("/"));
-  logPrint(radio.DATA[0]);
   logPrint(FLASH("]  Dst["));
   logPrint(dstNodeId);
-  logPrint(FLASH("/"));
-  logPrint(radio.DATA[1]);
+  logPrint(FLASH("]  Hdr["));
+  logPrint(radio.DATA[0]);
   logPrint(FLASH("] Size ["));
-  logPrint(bufSize);
+  logPrint(radio.DATALEN);
   logPrint(FLASH("]\n\rBuffer: ["));
-  for (int i = 0; i < bufSize; i++)
+  for (int i = 0; i < radio.DATALEN; i++)
   {
-    sprintf(hex, "%.2x", buffer[i]);
+    sprintf(hex, "%.2x", radio.DATA[i]);
     logPrint(hex);
     logPrint(" ");
   }
@@ -1717,6 +2241,7 @@ void setup()
     // Record new F/W version and start with blank mappings
     EEPROM.write(EEPROM_FW_ADDR, FW_VERSION_c);
     EEPROM.write(EEPROM_NUMDMXNODES_ADDR, 0);  // numDmxwChans
+    EEPROM.write(EEPROM_PIX_ADDR, 0);          // pixStream.nodeId
   }
   else
   {
@@ -1724,7 +2249,7 @@ void setup()
     EepromLoad();
   }
   for (Uint8 i = 0; i < MAX_DATA_LEN; i++)
-    buffer[i] = 0;
+    txPkt[i] = 0;
 
   for (Uint8 i = 1; i <= 5; i++)
     logPrintln();
@@ -1781,16 +2306,16 @@ void loop()
       srcNodeId = radio.SENDERID;
       if ( (dstNodeId == myNodeId) || (dstNodeId == BROADCASTID) )
       {
-        if ( (radio.DATA[0] == srcNodeId) && (radio.DATA[1] == dstNodeId))
+        if ( (radio.DATALEN > DMXW_HDR_LEN) && DMXW_HDR_OK(radio.DATA[0]) )
         {
           handleInput = true;
           ackRequested = radio.ACK_REQUESTED;
-          bufSize = radio.DATALEN - 2;
-          memcpy(buffer, (const void *)&radio.DATA[2], bufSize);
+          rxSize = radio.DATALEN - DMXW_HDR_LEN;
+          rxBuf = (const Uint8 *)&radio.DATA[DMXW_HDR_LEN];
         }
         else
         {
-          logPrintln(FLASH("*** RX corrupt pkt; dropped."));
+          logPrintln(FLASH("*** RX bad pkt header; dropped."));
           dumpBuffer();
         }
       }
@@ -1819,7 +2344,7 @@ void loop()
       {
         rxTime = millis();
         currReadPos = 0;
-        command = buffer[currReadPos++];
+        command = rxBuf[currReadPos++];
         dbgPrint(FLASH("Cmd["));
         printCommand(command);
         dbgPrint("] ");
@@ -2034,26 +2559,49 @@ void loop()
   {
     if (millis() >= dmxwTxTime)
     {
-      dmxwTxTime = millis() + DMXW_TX_DELAY;
+      // Keep run frames on a fixed cadence (nodes predict their arrival)
+      // unless we've fallen more than a frame behind.
+      dmxwTxTime += DMXW_TX_DELAY;
+      if (millis() >= dmxwTxTime)
+        dmxwTxTime = millis() + DMXW_TX_DELAY;
       datafillDmxwRunPacket();
       txCount++;
     }
   }
+
+  // Stream pixel pages in the gaps between run frames (or flat out, while
+  // benchmarking without them).
+  if ( (pixStream.benchEnd != 0) && ((long)(millis() - pixStream.benchEnd) >= 0) )
+  {
+    pixStream.benchEnd = 0;
+    logPrintln(FLASH("Pixel streaming benchmark done:"));
+    showPixStream();
+    pixStream.page = 0;
+  }
+  if ( (pixStream.nodeId != 0) && !dataToSend && !cmdInProgress &&
+       (suspendStartTime == 0) &&
+       ( (dmx512Running &&
+          ((long)(dmxwTxTime - millis()) >= PIX_PAGE_MS)) ||
+         (!dmx512Running && (pixStream.benchEnd != 0)) ) )
+  {
+    datafillPixPage();
+  }
   
   if (dataToSend)
   {
     dataToSend = false;
-    if ((bufSize + 2) <= MAX_DATA_LEN)
+    if (bufSize <= TXBUF_LEN)
     {
       ackTime = millis();
-      memmove(&buffer[2], buffer, bufSize);
-      bufSize += 2;
-      buffer[0] = myNodeId;
-      buffer[1] = node;
       ackBuf[0] = sendBuffer(node, buffer, bufSize, requestAck);
       dbgPrint(FLASH(" RxAck["));
       dbgPrint(millis() - ackTime);
       dbgPrint("]");
+      if (telemPollPending)
+      {
+        telemPollPending = false;
+        pollNodeTelem(telemNode);
+      }
       if ( (ackBuf[0] != ACK_OK) && (cmdInProgress != CMD_UNDEF) )
       {
         logPrint(FLASH("\nNode ["));
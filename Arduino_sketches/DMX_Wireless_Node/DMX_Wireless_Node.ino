@@ -46,9 +46,63 @@
  *         0      Firmware Version
  *         1      Node ID (recorded in myNodeId)
  *         2      Mapping data validity (1=valid; 0=invalid)
+ *       511      User response curve validity (1=valid: the whole table
+ *                has been uploaded)
+ *   512 - 767    User response curve (CURVE_USER) table
  *   Arduino Serial Monitor settings for console I/O:
  *     - 9600 baud
  *     - "Carriage return" as line ending
+ *   Idle sleep (IDLE_SLEEP_ENABLED):
+ *     - Rather than spinning for 2ms at the end of every loop(), the node
+ *       idle-sleeps until the next event: a radio packet (DIO0 interrupt),
+ *       a timer tick (Timer0, every ~1ms; drives the locator blink) or a
+ *       serial character. Timers, SPI and the USART keep running in
+ *       idle mode.
+ *     - The serial "loop" command shows the RX-to-output latency and the
+ *       fraction of time the MCU is awake (also available with the flag
+ *       undefined, for comparison).
+ *   Low-power listen schedule (SCHED_LISTEN_ENABLED; for battery nodes):
+ *     - The gateway appends its frame period and the time to the next
+ *       run frame to every CMD_RUN. The node sleeps its radio after each
+ *       run frame and turns the receiver back on just before the next one
+ *       is due: early by the frame's air time, the radio's wake-up time
+ *       and a guard time that adapts to the measured arrival jitter.
+ *     - After SCHED_MAX_MISSES predicted frames fail to arrive (e.g. the
+ *       gateway paused run frames to configure nodes), the node falls
+ *       back to continuous RX until the next run frame. Any other command
+ *       addressed to the node holds it in continuous RX for SCHED_HOLD_MS.
+ *     - The serial "loop" command also shows the radio-on duty cycle and
+ *       the schedule's frame and loss counters.
+ *   Telemetry (CMD_TREQ):
+ *     - The gateway polls each node in turn for its supply voltage
+ *       (measured against the internal bandgap), the mean and weakest
+ *       RSSI of gateway packets, run frames received and missed, and its
+ *       longest loop() pass. The record is returned in the ACK, so the
+ *       gateway needn't open a receive window while it's running.
+ *     - Missed frames are counted from gaps in the run frame cadence,
+ *       using the period in the CMD_RUN schedule trailer.
+ *     - With SCHED_LISTEN_ENABLED, the receiver stays on for up to
+ *       SCHED_POLL_US after a run frame flagged with DMXW_HDR_POLL.
+ *   On-node effects (FX_ENABLED):
+ *     - Ports 17 - 19 (FX_PORT_EFFECT, FX_PORT_RATE, FX_PORT_DEPTH) have no
+ *       pin. Mapped to DMXW channels like any other port, they select an
+ *       effect (strobe, chase, pulse, flicker; in decade bands, as on the
+ *       pixel strip node), its rate (0.1 Hz units) and its duty cycle or
+ *       depth. The effect modulates the levels of all of the node's
+ *       mapped outputs.
+ *     - The effect is computed locally every loop() pass (about every ms,
+ *       woken by the Timer0 tick), so its timing doesn't depend on the
+ *       run frame rate or on lost frames. The desk only sends the slowly
+ *       changing parameter and level channels.
+ *     - A chase steps through the mapped outputs in port order.
+ *   Software PWM (SOFT_PWM_ENABLED):
+ *     - A digital port mapped with CURVE_DIM_FLAG added to its curve is
+ *       driven as an 8-bit dimmed output by a bit angle modulation (BAM)
+ *       engine running off the Timer1 compare interrupt.
+ *     - Timer1 is taken over by the BAM engine, so the PWM ports on pins
+ *       9 and 10 (ports 14, 15) are driven by it as well.
+ *     - Channels are spread over BAM_PHASES phase-shifted groups so that
+ *       not all dimmed outputs switch on at the same instant.
  *
  * History
  * =======
@@ -71,8 +125,10 @@
 #include <RFM69.h>
 #include <SPI.h>
 #include "DMXWNet.h"
+#include "DMXWCurves.h"
 #include <avr/pgmspace.h>
 #include <EEPROM.h>
+#include <avr/sleep.h>
 
 #define COPYRIGHT     "(C)2020, A.J. van Schouwen"
 #define SW_VERSION_c  "1.0 (2020-03-13)"
@@ -82,6 +138,10 @@
 //#define DEBUG_ON         // Uncomment to turn off debug output to serial port.
 #define LOGGING_ON       // Uncomment to turn off packet logging to serial port.
 #define SERIAL_CMDS_ENABLED // Enables command line at serial port
+#define SOFT_PWM_ENABLED    // Enables Timer1 software PWM on digital ports
+#define IDLE_SLEEP_ENABLED  // Idle-sleep between events (else 2ms spin)
+//#define SCHED_LISTEN_ENABLED // Sleep the radio between run frames
+#define FX_ENABLED          // On-node effects driven by the FX ports
 
 #define PIN_LOCATE    9    // Pin number of digital port connected to
                            // onboard LED (for location purposes)
@@ -90,6 +150,46 @@
 #define EEPROM_NODEID_ADDR         1
 #define EEPROM_VALIDITY_ADDR       2
 #define EEPROM_FIRST_OPEN_ADDR     3
+#define EEPROM_CURVE_VALID_ADDR  511
+#define EEPROM_CURVE_ADDR        512
+
+// Software PWM (bit angle modulation). Each BAM frame is 255 ticks long;
+// bit plane p of a channel's value is output for 2^p ticks. The channels
+// are split into BAM_PHASES groups whose frames are offset from each
+// other by BAM_PHASE_OFFSET ticks. The Timer1 ISR fires at every plane
+// boundary of any group: at most 8 * BAM_PHASES times per frame.
+// ISR load estimate: ~32 ISRs per 8.16ms frame of ~5us each (incl.
+// entry/exit) => ~4000 ISRs/s, ~2% of the CPU. The longest delay added
+// to the radio's DIO0 interrupt is one ISR (~5us). Use the serial "pwm"
+// command to show the measured load.
+#define LOOP_DELAY_US      2000  // Per-loop spin without IDLE_SLEEP_ENABLED
+#define TXBUF_LEN  (RF69_MAX_DATA_LEN - DMXW_HDR_LEN)  // Max TX payload
+
+// Low-power listen schedule
+#define SCHED_MAX_MISSES      2     // Missed frames before continuous RX
+#define SCHED_HOLD_MS      2000     // Continuous RX after a config command
+#define SCHED_POLL_US      8000     // RX after a run frame with DMXW_HDR_POLL
+#define SCHED_MIN_GUARD_US 1500     // Guard time with no jitter (> 1 tick)
+#define SCHED_RADIO_WAKE_US 1500    // RFM69 sleep to RX-ready time
+#define SCHED_BIT_US         18     // Air time per bit (55.5 kbps)
+#define SCHED_PKT_OVERHEAD   11     // Preamble, sync, length, addr, CTL, CRC
+
+// On-node effects
+#ifdef FX_ENABLED
+  #define NUM_NODE_PORTS   (MAX_PORTS + NUM_FX_PORTS)  // Output + FX ports
+#else
+  #define NUM_NODE_PORTS   MAX_PORTS
+#endif
+#define FX_CYCLE_LEN   10000000UL  // Rate (0.1 Hz) x time (us) of a cycle
+#define FX_MAX_STEP_US    1000000  // Longest time step applied at once
+
+#define BAM_MAX_CHANS      MAX_PORTS
+#define BAM_PHASES         4     // # of phase-staggered groups (power of 2)
+#define BAM_PHASE_OFFSET   64    // Offset (ticks) between group frames
+#define BAM_MAX_EVENTS     (8 * BAM_PHASES)
+#define BAM_FRAME_TICKS    255
+#define BAM_TICK_SHIFT     6     // 2^6 Timer1 counts (0.5us each) per tick
+                                 //   => 32us ticks, 8.16ms (122Hz) frames
 
 // Macro for defining strings that are stored in flash (program) memory rather
 // than in RAM. Arduino defines the non-descript F("string") syntax.
@@ -125,13 +225,28 @@ Uint8   srcNodeId;
 bool    resetEeprom = false;
 bool    handleInput = false;
 bool    ackRequested = false;
+Uint8   rxHdr = 0;          // Header of the packet being handled
+Uint8   lastGwSeq = 0xFF;   // Seq # of the last packet handled from gateway
+AckCode_t lastAckCode = ACK_NULL;  // ... and the ACK code it got
+Uint8   lastAckLen = 1;     // ... and the length of that ACK
+Uint8   txSeq = 0;          // Sequence # of the next packet sent
 bool    dataToSend = false;
 bool    requestAck = true;
 bool    saveMappings = false;
+bool    saveCurve = false;
+bool    userCurveValid = false;
 Uint8   currReadPos = 0;
 Uint8   command = 0;
-Uint8   buffer[RF69_MAX_DATA_LEN];
-Uint8   ackBuf[1];
+// Received packets are decoded in place, through rxBuf, straight out of
+// the radio's receive buffer. (It isn't touched again until the next
+// receiveDone() or send.) Outgoing packets are built in buffer[], which
+// is preceded by DMXW_HDR_LEN bytes of headroom for sendBuffer()'s header.
+const Uint8 *rxBuf = NULL;
+Uint8   rxSize = 0;
+Uint8   txPkt[RF69_MAX_DATA_LEN];
+Uint8 * const buffer = &txPkt[DMXW_HDR_LEN];
+Uint8   ackBuf[1 + TELEM_LEN];  // ACK code, plus telemetry for CMD_TREQ
+Uint8   ackLen = 1;
 Uint8   bufSize = 0;
 char    serialBuffer[MAX_SERIAL_BUF_LEN];
 Uint8   serialBufSize = 0;
@@ -143,8 +258,53 @@ unsigned long rxCount = 0;
 Uint8   resetCount;
 Uint16  badAddr = 0;
 
-// Port to I/O pin mapping
-NodePortMapRecord_t portMap[MAX_PORTS] =
+// Loop timing statistics (serial "loop" command)
+unsigned long rxArrival = 0;      // micros() when the pending pkt was seen
+unsigned long latencyTotal = 0;   // Sum of RX-to-output latencies (us)
+unsigned long latencyMax = 0;     // Max RX-to-output latency (us)
+unsigned long latencyCount = 0;   // # of latencies summed
+unsigned long idleTotal = 0;      // Time (us) spent waiting for events
+unsigned long statsStart = 0;     // micros() at stats reset
+
+// Telemetry reported to the gateway (CMD_TREQ). Reset after each report.
+#define TELEM_IDLE_MS  5000  // Longer run frame gaps: gateway idle, not loss
+typedef struct telemetry_t {
+  unsigned long  rssiTotal;     // Sum of gateway packet RSSIs (-dBm)
+  Uint16         rssiCount;     // # of RSSIs summed
+  Uint8          rssiWorst;     // Weakest gateway packet RSSI (-dBm)
+  unsigned long  frames;        // Run frames received
+  unsigned long  missed;        // Run frames missed (gaps in the cadence)
+  unsigned long  loopMax;       // Longest loop() pass, excluding idle (us)
+  unsigned long  lastRun;       // millis() of the last run frame
+} Telemetry_t;
+Telemetry_t telem;
+
+#ifdef SCHED_LISTEN_ENABLED
+// Low-power listen schedule state. Times are micros() unless noted.
+typedef struct listenSched_t {
+  bool           active;        // Sleeping the radio between run frames?
+  bool           radioOn;       // Is the receiver on?
+  bool           pollWait;      // Listening for a CMD_TREQ after a run frame?
+  Uint8          misses;        // Consecutive predicted frames not received
+  Uint8          period;        // Run frame period (ms)
+  Uint16         guard;         // Guard time around the predicted arrival
+  Uint16         jitter;        // Smoothed |arrival - predicted arrival|
+  unsigned long  nextFrame;     // Predicted arrival of the next run frame
+  unsigned long  wakeTime;      // When to turn the receiver back on
+  unsigned long  holdUntil;     // millis() until which to stay in RX
+  unsigned long  pollUntil;     // When to stop listening for a CMD_TREQ
+  unsigned long  radioOnSince;  // When the receiver was turned on
+  unsigned long  radioOnTotal;  // Receiver-on time since stats reset
+  unsigned long  frames;        // Run frames received in a predicted window
+  unsigned long  lost;          // Predicted run frames that didn't arrive
+  unsigned long  fallbacks;     // # of fallbacks to continuous RX
+} ListenSched_t;
+ListenSched_t sched;
+#endif
+
+// Port to I/O pin mapping (constant; kept in flash--use the portXxx()
+// accessors below to read it)
+const NodePortMapRecord_t portMap[MAX_PORTS] PROGMEM =
 {
   //{ inPin, outPin, conflictPort, isAnalog }
     {   2,     2,         -1,       false },  // Port 1
@@ -166,8 +326,74 @@ NodePortMapRecord_t portMap[MAX_PORTS] =
 };
 
 
-// List of defined ports indexed by DMXW channel # (-1 = not used)
-DmxwNodeMapRecord_t nodeMap[MAX_DMXW_CHANS];
+// DMXW channel mapping of each port, indexed by port # - 1
+// (dmxwChan 0 = port not mapped). The FX ports follow the output ports.
+DmxwNodeMapRecord_t nodeMap[NUM_NODE_PORTS];
+
+// Compact list of the mapped output channels, in port order, so that
+// handleCmdRun() only visits the node's active ports. Rebuilt by
+// buildActiveChans() whenever the mapping changes.
+typedef struct activeChan_t {
+  Uint8   dmxwChan;     // DMXW channel # (= offset of value in CMD_RUN)
+  Uint8   portIdx;      // Index of the output port in portMap[]/portDrv[]
+  Uint8   curve;        // Response curve (dimmed ports only)
+  bool    isDimmed;     // PWM/BAM output (true) or on/off output (false)
+} ActiveChan_t;
+ActiveChan_t  activeChans[MAX_PORTS];
+Uint8         numActiveChans = 0;
+
+// Output driver state per port, precomputed from portMap[] by
+// initPortDrivers(). portWrite() uses it to write the output registers
+// directly, and skips the write when the value hasn't changed.
+typedef struct portDriver_t {
+  volatile Uint8 *outReg;  // PORTx register of the output pin
+  volatile Uint8 *ocrReg;  // Timer compare register (PWM ports); else NULL
+  Uint8   bitMask;         // Bit of the output pin in *outReg
+  Uint8   timer;           // Timer driving the pin's PWM (NOT_ON_TIMER if none)
+  Int8    bamIdx;          // Software PWM channel of the port (-1 = none)
+  Uint8   value;           // Last value written to the port
+  bool    valid;           // Is value the port's actual output state?
+} PortDriver_t;
+PortDriver_t  portDrv[MAX_PORTS];
+
+#ifdef FX_ENABLED
+// On-node effect generator state. The effect's parameters are the values
+// of the FX ports; the unmodulated level of each output is its
+// nodeMap[].value.
+typedef struct fxState_t {
+  Uint8          effect;        // Effect being run (FX_xxx)
+  unsigned long  pos;           // Position in the cycle (rate x us)
+  unsigned long  cycles;        // # of cycles completed (chase step)
+  unsigned long  lastUs;        // micros() of the last update
+  Uint8          dip[MAX_PORTS];  // Flicker: dip of each active channel
+} FxState_t;
+FxState_t fx;
+#endif
+
+#ifdef SOFT_PWM_ENABLED
+// Software PWM (BAM) channels. bamOut[] holds, for each interval between
+// consecutive plane boundaries, the PORTB/PORTC/PORTD bits of all
+// channels; it's rebuilt by bamRebuild() whenever a channel value changes.
+typedef struct bamChan_t {
+  Uint8   portIdx;      // Port driven by this channel
+  Uint8   portSel;      // 0 = PORTB, 1 = PORTC, 2 = PORTD
+  Uint8   bitMask;      // Bit of the pin in its PORTx register
+  Uint8   value;        // Duty cycle (0..255)
+} BamChan_t;
+BamChan_t  bamChans[BAM_MAX_CHANS];
+Uint8      bamNumChans = 0;
+bool       bamDirty = false;
+Uint8      bamNumEvents = 0;
+Uint8      bamEvTime[BAM_MAX_EVENTS];     // Start tick of each interval
+Uint8      bamEvTicks[BAM_MAX_EVENTS];    // Length (ticks) of each interval
+volatile Uint8  bamOut[BAM_MAX_EVENTS][3];
+volatile Uint8  bamMask[3];               // PORTB/C/D bits owned by BAM
+volatile Uint8  bamEvent = 0;             // Interval being output
+volatile unsigned long bamIsrCount = 0;   // # of ISRs since stats reset
+volatile unsigned long bamIsrTotal = 0;   // Sum of Timer1 counts in ISRs
+volatile Uint8  bamIsrMax = 0;            // Max Timer1 counts in an ISR
+unsigned long   bamStatsStart = 0;        // micros() at stats reset
+#endif
 
 Uint8 node;
 
@@ -177,10 +403,47 @@ long lastTime = 0;
 
 
 
+// Accessors for the port table in flash. (FX ports have no pins.)
+Int8 portInPin(Uint8 portIdx)
+{
+  if (portIdx >= MAX_PORTS)
+    return -1;
+  return (Int8)pgm_read_byte(&portMap[portIdx].inPin);
+}
+
+Int8 portOutPin(Uint8 portIdx)
+{
+  if (portIdx >= MAX_PORTS)
+    return -1;
+  return (Int8)pgm_read_byte(&portMap[portIdx].outPin);
+}
+
+Int8 portConflict(Uint8 portIdx)
+{
+  if (portIdx >= MAX_PORTS)
+    return -1;
+  return (Int8)pgm_read_byte(&portMap[portIdx].conflictPort);
+}
+
+bool portIsAnalog(Uint8 portIdx)
+{
+  if (portIdx >= MAX_PORTS)
+    return false;
+  return pgm_read_byte(&portMap[portIdx].isAnalog);
+}
+
+
+// The EEPROM keeps the mappings in their original per-DMXW-channel
+// format, (port, isOutput, curve) for each channel, so existing
+// configurations load unchanged. They're converted to/from the per-port
+// nodeMap[] here.
 void EepromLoad()
 {
   int addr;
   bool dataIsValid;
+  Int8 port;
+  bool isOutput;
+  Uint8 curve;
 
   dataIsValid = EEPROM.read(EEPROM_VALIDITY_ADDR);
   if (!dataIsValid)
@@ -189,31 +452,43 @@ void EepromLoad()
   addr = EEPROM_FIRST_OPEN_ADDR;
   for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
   {
-    nodeMap[i].port          = EEPROM.read(addr++);
-    nodeMap[i].isOutput      = EEPROM.read(addr++);
-    if (nodeMap[i].isOutput)
-      pinMode(portMap[nodeMap[i].port - 1].outPin, OUTPUT);
-    else
-      pinMode(portMap[nodeMap[i].port - 1].inPin, INPUT);
-    nodeMap[i].isLogarithmic = EEPROM.read(addr++);
-    //nodeMap[i].value       = EEPROM.read(addr++); // Don't store the value
-    nodeMap[i].value         = 0;
+    port     = EEPROM.read(addr++);
+    isOutput = EEPROM.read(addr++);
+    curve    = EEPROM.read(addr++);
+    if ( (port <= 0) || (port > NUM_NODE_PORTS) )
+      continue;
+    nodeMap[port - 1].dmxwChan = i + 1;
+    nodeMap[port - 1].flags    = curve | (isOutput ? NODEMAP_OUTPUT : 0);
+    nodeMap[port - 1].value    = 0;
+    if ( !isOutput && (portInPin(port - 1) != -1) )
+      pinMode(portInPin(port - 1), INPUT);  // (FX ports have no pin)
   }
+  buildActiveChans();
 }
 
 void EepromSave()
 {
   const Uint8 dataIsValid = 1;
+  Int8 port;
   int addr;
 
   EEPROM.write(EEPROM_VALIDITY_ADDR, dataIsValid);
   addr = EEPROM_FIRST_OPEN_ADDR;
   for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
   {
-    EEPROM.write(addr++, nodeMap[i].port);
-    EEPROM.write(addr++, nodeMap[i].isOutput);
-    EEPROM.write(addr++, nodeMap[i].isLogarithmic);
-    //EEPROM.write(addr++, nodeMap[i].value); // Don't store the value
+    port = findPortByDmxwChan(i + 1);
+    if (port == -1)
+    {
+      EEPROM.write(addr++, -1);
+      EEPROM.write(addr++, true);
+      EEPROM.write(addr++, CURVE_LINEAR);
+    }
+    else
+    {
+      EEPROM.write(addr++, port + 1);
+      EEPROM.write(addr++, (nodeMap[port].flags & NODEMAP_OUTPUT) != 0);
+      EEPROM.write(addr++, nodeMap[port].flags & ~NODEMAP_OUTPUT);
+    }
   }
 }
 
@@ -222,7 +497,7 @@ bool isPortMapValid(Uint8 port, bool isOutput)
 {
   Int8 conflictPort;
   
-  if ( (port == 0) || (port > MAX_PORTS) )
+  if ( (port == 0) || (port > NUM_NODE_PORTS) )
   {
     logPrint(FLASH("*** Port # out of range - "));
     logPrintln(port);
@@ -230,39 +505,37 @@ bool isPortMapValid(Uint8 port, bool isOutput)
   }
 
   // Check for a conflict
-  conflictPort = portMap[port - 1].conflictPort;
+  conflictPort = portConflict(port - 1);
   if ( (conflictPort != -1) && isOutput )
   {
     // We have a potential conflict ... but only if both ports are
     // output ports.
-    for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-      if (nodeMap[i].port == conflictPort)
-        if (nodeMap[i].isOutput)
-        {
-          logPrint(FLASH("*** DMXW Channel "));
-          logPrint(i+1);
-          logPrint(FLASH(" is mapped to conflicting output port "));
-          logPrintln(conflictPort);
-          return false;
-        }
-  }
-  
-  // Check for a duplicated port
-  for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-    if (nodeMap[i].port == port)
+    if ( (nodeMap[conflictPort - 1].dmxwChan != 0) &&
+         (nodeMap[conflictPort - 1].flags & NODEMAP_OUTPUT) )
     {
       logPrint(FLASH("*** DMXW Channel "));
-      logPrint(i+1);
-      logPrint(FLASH(" already uses port #"));
-      logPrintln(port);
+      logPrint(nodeMap[conflictPort - 1].dmxwChan);
+      logPrint(FLASH(" is mapped to conflicting output port "));
+      logPrintln(conflictPort);
       return false;
     }
+  }
+  
+  // Check for a duplicated port
+  if (nodeMap[port - 1].dmxwChan != 0)
+  {
+    logPrint(FLASH("*** DMXW Channel "));
+    logPrint(nodeMap[port - 1].dmxwChan);
+    logPrint(FLASH(" already uses port #"));
+    logPrintln(port);
+    return false;
+  }
 
   return true;
 }
 
 
-bool addNodeMap(Uint8 dmxwChan, Uint8 port, bool isOutput, bool logarithmic)
+bool addNodeMap(Uint8 dmxwChan, Uint8 port, bool isOutput, Uint8 curve)
 {
   DmxwNodeMapRecord_t *tmpMap;
   
@@ -272,85 +545,452 @@ bool addNodeMap(Uint8 dmxwChan, Uint8 port, bool isOutput, bool logarithmic)
     logPrintln(dmxwChan);
     return false;
   }
-  dmxwChan--;
   if (!isPortMapValid(port, isOutput))
     return false;
     
-  if (nodeMap[dmxwChan].port != -1)
+  if (findPortByDmxwChan(dmxwChan) != -1)
   {
     logPrint(FLASH("*** DMXW Chan already mapped to port ["));
     logPrint(dmxwChan);
     logPrint(FLASH(" / "));
-    logPrint(port);
+    logPrint(findPortByDmxwChan(dmxwChan) + 1);
     logPrintln(FLASH("]"));
     return false;
   }
   
-  tmpMap = &nodeMap[dmxwChan];
-  tmpMap->port          = port;
-  tmpMap->isOutput      = isOutput;
-  if (portMap[port-1].isAnalog)
-    tmpMap->isLogarithmic = logarithmic;
+  tmpMap = &nodeMap[port - 1];
+  tmpMap->dmxwChan      = dmxwChan;
+  if ((curve & ~CURVE_DIM_FLAG) >= NUM_CURVES)
+    curve = CURVE_LINEAR;
+  if (portIsAnalog(port - 1))
+    tmpMap->flags = curve & ~CURVE_DIM_FLAG;
+  #ifdef SOFT_PWM_ENABLED
+  else if (curve & CURVE_DIM_FLAG)
+    tmpMap->flags = curve;  // Digital port dimmed by software PWM
+  #endif
   else
-    tmpMap->isLogarithmic = 0;
+    tmpMap->flags = CURVE_LINEAR;
+  if (isOutput)
+    tmpMap->flags |= NODEMAP_OUTPUT;
   tmpMap->value         = 0;
+  buildActiveChans();
   
   return true;
 }
 
 bool delNodeMap(Uint8 dmxwChan)
 {
+  Int8 port;
+
   if ( (dmxwChan == 0) || (dmxwChan > MAX_DMXW_CHANS))
   {
     logPrint(FLASH("*** DMXW Chan# out of range - "));
     logPrintln(dmxwChan);
     return false;
   }
-  dmxwChan--;
   
-  if (nodeMap[dmxwChan].port == -1)
+  port = findPortByDmxwChan(dmxwChan);
+  if (port == -1)
     return false;
-  nodeMap[dmxwChan].port = -1;
+  nodeMap[port].dmxwChan = 0;
+  buildActiveChans();
   return true;
 }
 
 
-Int8 getPortMapIdxByDmxwChan(int dmxwChan)
+// Rebuild activeChans[] from nodeMap[]. Must be called after any change
+// to nodeMap[]. Also sets the pin mode of each active output.
+void buildActiveChans()
+{
+  DmxwNodeMapRecord_t *currNodeMap;
+  ActiveChan_t *chan;
+
+  numActiveChans = 0;
+  #ifdef SOFT_PWM_ENABLED
+    bamClearChans();
+  #endif
+  for (Uint8 i = 0; i < MAX_PORTS; i++)
+  {
+    currNodeMap = &nodeMap[i];
+    if ( (currNodeMap->dmxwChan == 0) ||
+         !(currNodeMap->flags & NODEMAP_OUTPUT) )
+      continue;
+
+    chan = &activeChans[numActiveChans++];
+    chan->dmxwChan = currNodeMap->dmxwChan;
+    chan->portIdx  = i;
+    chan->curve    = currNodeMap->flags & NODEMAP_CURVE_MASK;
+    chan->isDimmed = portIsAnalog(i) || (currNodeMap->flags & NODEMAP_DIMMED);
+    pinMode(portOutPin(i), OUTPUT);
+    #ifdef SOFT_PWM_ENABLED
+      // Dimmed ports without a hardware PWM timer are driven by BAM.
+      if (chan->isDimmed && (portDrv[i].ocrReg == NULL))
+      {
+        portDrv[i].bamIdx = bamAddChan(i);
+        portDrv[i].valid  = false;
+      }
+    #endif
+  }
+}
+
+
+// Returns the index (port # - 1) of the port mapped to DMXW channel,
+// dmxwChan, or -1 if there's none.
+Int8 findPortByDmxwChan(int dmxwChan)
 {
-  Uint8 port;
-  
   if ( (dmxwChan < 1) || (dmxwChan > MAX_DMXW_CHANS))
     return -1;
-  port = nodeMap[dmxwChan - 1].port;
-  if (port == -1)
+  for (Uint8 i = 0; i < NUM_NODE_PORTS; i++)
+    if (nodeMap[i].dmxwChan == dmxwChan)
+      return i;
+  return -1;
+}
+
+
+// Returns the PWM value (0..255) for DMX-512 value, dmx512Val, shaped by
+// response curve, curve. CURVE_LOG provides a perceived linear LED
+// brightness relationship relative to the linearity assumed by lighting
+// consoles generating DMX values in the range 0..255.
+// The curves are table lookups (see DMXWCurves.h); the user curve is read
+// from EEPROM and behaves as CURVE_LINEAR until one has been uploaded.
+Uint8 curveValue(Uint8 curve, Uint8 dmx512Val)
+{
+  switch (curve)
+  {
+    case CURVE_LOG:     return pgm_read_byte(&curveLogTable[dmx512Val]);
+    case CURVE_GAMMA:   return pgm_read_byte(&curveGammaTable[dmx512Val]);
+    case CURVE_SCURVE:  return pgm_read_byte(&curveSTable[dmx512Val]);
+    case CURVE_USER:
+      if (userCurveValid)
+        return EEPROM.read(EEPROM_CURVE_ADDR + dmx512Val);
+      break;
+    default:
+      break;
+  }
+  return dmx512Val;
+}
+
+
+//------------  Port output driver ------------------------------------
+// Connect (on = true) or disconnect the PWM output of timer compare unit,
+// timer, to/from its pin.
+void pwmConnect(Uint8 timer, bool on)
+{
+  volatile Uint8 *tccr;
+  Uint8 comBit;
+
+  switch (timer)
+  {
+    case TIMER0A:  tccr = &TCCR0A;  comBit = _BV(COM0A1);  break;
+    case TIMER0B:  tccr = &TCCR0A;  comBit = _BV(COM0B1);  break;
+    case TIMER1A:  tccr = &TCCR1A;  comBit = _BV(COM1A1);  break;
+    case TIMER1B:  tccr = &TCCR1A;  comBit = _BV(COM1B1);  break;
+    case TIMER2A:  tccr = &TCCR2A;  comBit = _BV(COM2A1);  break;
+    case TIMER2B:  tccr = &TCCR2A;  comBit = _BV(COM2B1);  break;
+    default:       return;
+  }
+  if (on)
+    *tccr |= comBit;
+  else
+    *tccr &= ~comBit;
+}
+
+#ifdef SOFT_PWM_ENABLED
+// Bit plane shown by phase group, group, at BAM tick, tick. Each group's
+// frame starts with plane 7 (128 ticks) and ends with plane 0 (1 tick).
+Uint8 bamPlaneAt(Uint8 tick, Uint8 group)
+{
+  Uint8 rel = (tick + BAM_FRAME_TICKS - (group * BAM_PHASE_OFFSET) %
+               BAM_FRAME_TICKS) % BAM_FRAME_TICKS;
+  Uint8 plane = 7;
+
+  // Plane p occupies ticks [256 - 2^(p+1), 256 - 2^p) of the group's frame
+  while (rel >= (Uint8)(256 - (1 << plane)))
+    plane--;
+  return plane;
+}
+
+// Build the BAM interval schedule and start Timer1 in CTC mode.
+void bamInit()
+{
+  Uint8 isBoundary[(BAM_FRAME_TICKS + 7) / 8];
+  Uint8 tick;
+
+  // Mark the start tick of every plane of every group.
+  memset(isBoundary, 0, sizeof(isBoundary));
+  for (Uint8 g = 0; g < BAM_PHASES; g++)
+    for (Uint8 p = 0; p < 8; p++)
+    {
+      tick = ((g * BAM_PHASE_OFFSET) + (256 - (2 << p))) % BAM_FRAME_TICKS;
+      isBoundary[tick >> 3] |= _BV(tick & 7);
+    }
+
+  bamNumEvents = 0;
+  for (Uint8 t = 0; t < BAM_FRAME_TICKS; t++)
+    if (isBoundary[t >> 3] & _BV(t & 7))
+      bamEvTime[bamNumEvents++] = t;
+  for (Uint8 k = 0; k < bamNumEvents; k++)
+  {
+    tick = (k + 1 < bamNumEvents) ? bamEvTime[k + 1] : BAM_FRAME_TICKS;
+    bamEvTicks[k] = tick - bamEvTime[k];
+    bamOut[k][0] = bamOut[k][1] = bamOut[k][2] = 0;
+  }
+
+  cli();
+  bamEvent = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);  // CTC mode, clk/8 (0.5us counts)
+  TCNT1  = 0;
+  OCR1A  = ((Uint16)bamEvTicks[0] << BAM_TICK_SHIFT) - 1;
+  TIMSK1 = _BV(OCIE1A);
+  sei();
+  bamStatsStart = micros();
+}
+
+// Add port index, portIdx, as a BAM channel. Returns the channel index,
+// or -1 if there is no room.
+Int8 bamAddChan(Uint8 portIdx)
+{
+  PortDriver_t *drv = &portDrv[portIdx];
+  BamChan_t *ch;
+
+  if (bamNumChans >= BAM_MAX_CHANS)
     return -1;
-  return (port - 1);
+  ch = &bamChans[bamNumChans];
+  ch->portIdx = portIdx;
+  ch->portSel = (drv->outReg == &PORTB) ? 0 : (drv->outReg == &PORTC) ? 1 : 2;
+  ch->bitMask = drv->bitMask;
+  ch->value   = 0;
+  pwmConnect(drv->timer, false);
+  pinMode(portOutPin(portIdx), OUTPUT);
+  cli();
+  bamMask[ch->portSel] |= ch->bitMask;
+  sei();
+  bamDirty = true;
+  return bamNumChans++;
+}
+
+// Release all BAM channels. (Their pins keep their current levels.)
+void bamClearChans()
+{
+  cli();
+  bamMask[0] = bamMask[1] = bamMask[2] = 0;
+  sei();
+  for (Uint8 i = 0; i < MAX_PORTS; i++)
+    portDrv[i].bamIdx = -1;
+  bamNumChans = 0;
+  bamDirty = true;
+}
+
+// Recompute the port bits output during each BAM interval.
+void bamRebuild()
+{
+  Uint8 planeMask[BAM_PHASES];
+  Uint8 out[3];
+  BamChan_t *ch;
+
+  bamDirty = false;
+  for (Uint8 k = 0; k < bamNumEvents; k++)
+  {
+    for (Uint8 g = 0; g < BAM_PHASES; g++)
+      planeMask[g] = _BV(bamPlaneAt(bamEvTime[k], g));
+    out[0] = out[1] = out[2] = 0;
+    for (Uint8 c = 0; c < bamNumChans; c++)
+    {
+      ch = &bamChans[c];
+      if (ch->value & planeMask[c & (BAM_PHASES - 1)])
+        out[ch->portSel] |= ch->bitMask;
+    }
+    cli();
+    bamOut[k][0] = out[0];
+    bamOut[k][1] = out[1];
+    bamOut[k][2] = out[2];
+    sei();
+  }
+}
+
+// Timer1 compare: start the next BAM interval.
+ISR(TIMER1_COMPA_vect)
+{
+  Uint8 ev = bamEvent;
+  Uint8 counts;
+
+  PORTB = (PORTB & ~bamMask[0]) | bamOut[ev][0];
+  PORTC = (PORTC & ~bamMask[1]) | bamOut[ev][1];
+  PORTD = (PORTD & ~bamMask[2]) | bamOut[ev][2];
+  OCR1A = ((Uint16)bamEvTicks[ev] << BAM_TICK_SHIFT) - 1;
+  bamEvent = (ev + 1 < bamNumEvents) ? ev + 1 : 0;
+
+  // If this ISR was held off past the end of the interval (e.g. by the
+  // radio ISR), fire again right away instead of after a Timer1 wrap.
+  if (TCNT1 >= OCR1A)
+    TCNT1 = OCR1A - 1;
+
+  // Timer1 was cleared at the compare match, so TCNT1 is the time spent
+  // since then (interrupt latency + this ISR).
+  counts = TCNT1;
+  bamIsrCount++;
+  bamIsrTotal += counts;
+  if (counts > bamIsrMax)
+    bamIsrMax = counts;
+}
+
+// Print and reset the measured BAM ISR load.
+void showBamStats()
+{
+  unsigned long count, total, elapsed;
+  Uint8 maxCounts;
+
+  cli();
+  count     = bamIsrCount;
+  total     = bamIsrTotal;
+  maxCounts = bamIsrMax;
+  bamIsrCount = bamIsrTotal = 0;
+  bamIsrMax = 0;
+  sei();
+  elapsed = micros() - bamStatsStart;
+  bamStatsStart += elapsed;
+
+  logPrint(FLASH("Soft PWM: "));
+  logPrint(bamNumChans);
+  logPrint(FLASH(" chans, "));
+  logPrint(bamNumEvents);
+  logPrint(FLASH(" ISRs/frame, "));
+  logPrint(count);
+  logPrint(FLASH(" ISRs in "));
+  logPrint(elapsed / 1000);
+  logPrintln(FLASH("ms"));
+  logPrint(FLASH("  ISR avg "));
+  logPrint(count ? (total / 2) / count : 0);
+  logPrint(FLASH("us, max "));
+  logPrint(maxCounts / 2);
+  logPrint(FLASH("us, load "));
+  logPrint(elapsed ? (total * 50) / (elapsed / 100) : 0);
+  logPrintln(FLASH("/10000"));
+}
+#endif
+
+// Precompute the output registers of every port from portMap[]. The
+// timers themselves are left as configured by the Arduino core.
+void initPortDrivers()
+{
+  PortDriver_t *drv;
+  Int8 pin;
+
+  for (Uint8 i = 0; i < MAX_PORTS; i++)
+  {
+    drv = &portDrv[i];
+    pin = portOutPin(i);
+    drv->outReg  = portOutputRegister(digitalPinToPort(pin));
+    drv->bitMask = digitalPinToBitMask(pin);
+    drv->timer   = digitalPinToTimer(pin);
+    drv->bamIdx  = -1;
+    drv->valid   = false;
+    switch (portIsAnalog(i) ? drv->timer : NOT_ON_TIMER)
+    {
+      case TIMER0A:  drv->ocrReg = &OCR0A;   break;
+      case TIMER0B:  drv->ocrReg = &OCR0B;   break;
+#ifndef SOFT_PWM_ENABLED
+      // (With software PWM, Timer1 is used by the BAM engine.)
+      case TIMER1A:  drv->ocrReg = &OCR1AL;  break;
+      case TIMER1B:  drv->ocrReg = &OCR1BL;  break;
+#endif
+      case TIMER2A:  drv->ocrReg = &OCR2A;   break;
+      case TIMER2B:  drv->ocrReg = &OCR2B;   break;
+      default:       drv->ocrReg = NULL;     break;
+    }
+  }
+  #ifdef SOFT_PWM_ENABLED
+    bamInit();
+  #endif
 }
 
+// Mark the port(s) driven from pin as being in an unknown state, e.g.
+// after the pin was written to other than through portWrite().
+void invalidatePin(Int8 pin)
+{
+  for (Uint8 i = 0; i < MAX_PORTS; i++)
+    if (portOutPin(i) == pin)
+      portDrv[i].valid = false;
+}
 
-// Returns an adjusted PWM value (0..255) that provides a provides a
-// perceived linear LED brightness relationship relative to the
-// linearity assumed by lighting consoles generating DMX values in
-// the range 0..255.
-Uint8 linearLedValue(Uint8 dmx512Val)
+// Set the output of port index, portIdx, to value. Analog (PWM) ports take
+// value as a duty cycle (0..255); digital ports are on iff value != 0.
+// Nothing is written if the port already has that value.
+void portWrite(Uint8 portIdx, Uint8 value)
 {
-  // coefficients
-  double percentage = (double)dmx512Val/(double)255.0;
-  double a = 9.7758463166360387E-01;
-  double b = 5.5498961535023345E-00;
+  PortDriver_t *drv = &portDrv[portIdx];
+  Int8  conflictPort;
+  Uint8 oldSREG;
+  bool  pwm;
+
+  if (drv->valid && (drv->value == value))
+    return;
+
+  #ifdef SOFT_PWM_ENABLED
+    if (drv->bamIdx != -1)
+    {
+      bamChans[drv->bamIdx].value = value;
+      bamDirty = true;
+      drv->value = value;
+      drv->valid = true;
+      return;
+    }
+  #endif
+
+  // PWM is only needed for intermediate duty cycles; 0 and 255 are driven
+  // as plain digital levels (as analogWrite() does).
+  pwm = (drv->ocrReg != NULL) && (value != 0) && (value != 255);
+  if (pwm)
+  {
+    if (drv->timer == TIMER1A || drv->timer == TIMER1B)
+      *(drv->ocrReg + 1) = 0;  // 16-bit register: high byte first
+    *drv->ocrReg = value;
+  }
+
+  if (!drv->valid)
+  {
+    // First write since the port's state became unknown.
+    if (drv->ocrReg != NULL)
+      pinMode(portOutPin(portIdx), OUTPUT);
+    pwmConnect(drv->timer, pwm);
+
+    // A port sharing this port's pin no longer knows its pin's state.
+    conflictPort = portConflict(portIdx);
+    if (conflictPort != -1)
+      portDrv[conflictPort - 1].valid = false;
+  }
+  else if (drv->ocrReg != NULL)
+  {
+    // Only touch the timer when switching between PWM and fixed levels.
+    if (pwm != ((drv->value != 0) && (drv->value != 255)))
+      pwmConnect(drv->timer, pwm);
+  }
+
+  if (!pwm)
+  {
+    oldSREG = SREG;
+    cli();
+    if (value)
+      *drv->outReg |= drv->bitMask;
+    else
+      *drv->outReg &= ~drv->bitMask;
+    SREG = oldSREG;
+  }
 
-  return floor((a * exp(b*percentage) + 0.5)) - 1;
+  drv->value = value;
+  drv->valid = true;
 }
 
 
 AckCode_t handleCmdRun()
 {
-  DmxwNodeMapRecord_t *currNodeMap = NULL;
+  ActiveChan_t *chan;
   Uint8 value;
-  Int8 port;
-  Int8 pin;
 
-  if (bufSize != (MAX_DMXW_CHANS + 1))
+  if ( (rxSize != (MAX_DMXW_CHANS + 1)) &&
+       (rxSize != (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN)) &&
+       (rxSize != (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN + RUN_TB_LEN)) )
   {
     logPrintln(FLASH("CMD_RUN: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -360,53 +1000,44 @@ AckCode_t handleCmdRun()
     logPrint("RUN: [");
     for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
     {
-      logPrint(buffer[currReadPos + i]);
+      logPrint(rxBuf[currReadPos + i]);
       logPrint(" ");
     }
     logPrintln();
   #endif
 
-  for (Uint8 dmxwChan = 1; dmxwChan <= MAX_DMXW_CHANS; dmxwChan++)
+  #ifdef FX_ENABLED
+    // Effect parameters, for fxService()
+    for (Uint8 i = MAX_PORTS; i < NUM_NODE_PORTS; i++)
+      if (nodeMap[i].dmxwChan != 0)
+        nodeMap[i].value = rxBuf[nodeMap[i].dmxwChan];
+  #endif
+
+  // Only the mapped output channels are visited. (Their pin modes were
+  // set when activeChans[] was built.) portWrite() skips unchanged values.
+  for (Uint8 i = 0; i < numActiveChans; i++)
   {
-    //Serial.print("DMXW:"); Serial.print(dmxwChan);
-    currNodeMap = &nodeMap[dmxwChan - 1]; // Chan map for DMXW chan, dmxwChan
-    port = currNodeMap->port;  // Port assigned to dmxwChan
-    //Serial.print(", Port:");  Serial.print(port);
-    if (port > 0)
+    chan = &activeChans[i];
+    if ( (portOutPin(chan->portIdx) == PIN_LOCATE) && blinkState )
     {
-      pin = portMap[port - 1].outPin;
-      //Serial.print(", Pin:"); Serial.print(pin);
-      if ( (pin == PIN_LOCATE) && blinkState )
-      {
-        logPrint(FLASH("\n*** Warning: skipping pin "));
-        logPrint(PIN_LOCATE);
-        logPrintln(FLASH(" DMXW update. Pin currently used as 'Locator'"));
-        return ACK_OK;
-      }
-      if (pin != -1)
-      {
-        // We can write to the pin associated with the port
-        value = buffer[dmxwChan];
-        currReadPos++;  // Not really necessary, but good to keep it updated.
-        //Serial.print(", Value:"); Serial.print(value);
-        pinMode(pin, OUTPUT);
-        if (portMap[port - 1].isAnalog)
-        {
-          if (currNodeMap->isLogarithmic)
-            currNodeMap->value = linearLedValue(value);
-          else
-            currNodeMap->value = value;
-          analogWrite(pin, currNodeMap->value);
-        }
-        else
-        {
-          currNodeMap->value = (value != 0);
-          digitalWrite(pin, currNodeMap->value);
-        }
-      }
+      logPrint(FLASH("\n*** Warning: skipping pin "));
+      logPrint(PIN_LOCATE);
+      logPrintln(FLASH(" DMXW update. Pin currently used as 'Locator'"));
+      return ACK_OK;
     }
-    //Serial.println();
+    value = rxBuf[chan->dmxwChan];
+    if (chan->isDimmed)
+      value = curveValue(chan->curve, value);
+    else
+      value = (value != 0);
+    nodeMap[chan->portIdx].value = value;
+    #ifdef FX_ENABLED
+      if (fx.effect != FX_OFF)
+        continue;  // fxService() outputs the modulated level
+    #endif
+    portWrite(chan->portIdx, value);
   }
+  currReadPos += MAX_DMXW_CHANS;
   return ACK_OK;
 }
 
@@ -430,30 +1061,27 @@ AckCode_t handleCmdPong()
 
 AckCode_t handleCmdMap()
 {
-  Int8  dmxwChan    = buffer[currReadPos++];
-  Int8  port        = buffer[currReadPos++];
-  Uint8 logarithmic = buffer[currReadPos++];
+  Int8  dmxwChan    = rxBuf[currReadPos++];
+  Int8  port        = rxBuf[currReadPos++];
+  Uint8 curve       = rxBuf[currReadPos++];
   
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_MAP: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
   }
   
-  if (addNodeMap(dmxwChan, port, true, logarithmic))
-  {
-    pinMode(portMap[port - 1].outPin, OUTPUT);
+  if (addNodeMap(dmxwChan, port, true, curve))
     return ACK_OK;
-  }
 
   return ACK_EPORT; 
 }
 
 AckCode_t handleCmdMapR()
 {
-  Int8 dmxwChan = buffer[currReadPos++];
+  Int8 dmxwChan = rxBuf[currReadPos++];
   
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_MAPR: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -467,39 +1095,35 @@ AckCode_t handleCmdMapR()
 
 AckCode_t handleCmdClrAll()
 {
-  DmxwNodeMapRecord_t tmpRec;
-  
-  tmpRec.port     = -1;
-  tmpRec.isOutput = true;
-  tmpRec.value    = 0;
-  for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-    nodeMap[i] = tmpRec;
+  for (Uint8 i = 0; i < NUM_NODE_PORTS; i++)
+    nodeMap[i].dmxwChan = 0;
+  buildActiveChans();
   return ACK_OK;
 }
 
 AckCode_t handleCmdEcho()
 {
-  Int8 dmxwChan = buffer[currReadPos++];
+  Int8 dmxwChan = rxBuf[currReadPos++];
   Int8 portIdx;
 
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_ECHO: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
   }
 
-  portIdx = getPortMapIdxByDmxwChan(dmxwChan);
+  portIdx = findPortByDmxwChan(dmxwChan);
   if (portIdx == -1)
     return ACK_EPORT;
   bufSize = 0;
   buffer[bufSize++] = CMD_CHAN;
   buffer[bufSize++] = dmxwChan;
   buffer[bufSize++] = portIdx + 1;
-  buffer[bufSize++] = portMap[portIdx].outPin;
-  buffer[bufSize++] = portMap[portIdx].conflictPort;
-  buffer[bufSize++] = portMap[portIdx].isAnalog;
-  buffer[bufSize++] = nodeMap[dmxwChan - 1].value;
-  buffer[bufSize++] = nodeMap[dmxwChan - 1].isLogarithmic;
+  buffer[bufSize++] = portOutPin(portIdx);
+  buffer[bufSize++] = portConflict(portIdx);
+  buffer[bufSize++] = portIsAnalog(portIdx);
+  buffer[bufSize++] = nodeMap[portIdx].value;
+  buffer[bufSize++] = nodeMap[portIdx].flags & ~NODEMAP_OUTPUT;
   node = BROADCASTID;
   dataToSend = true;
   return ACK_OK;
@@ -511,9 +1135,25 @@ AckCode_t handleCmdChan()
   return ACK_ECMD;
 }
 
+// Turn the locator LED on or off.
+void setLocator(bool on)
+{
+  digitalWrite(PIN_LOCATE, on ? HIGH : LOW);
+  invalidatePin(PIN_LOCATE);
+  #ifdef SOFT_PWM_ENABLED
+    // The BAM ISR would overwrite the pin if it's used by a dimmed port.
+    for (Uint8 i = 0; i < bamNumChans; i++)
+      if (portOutPin(bamChans[i].portIdx) == PIN_LOCATE)
+      {
+        bamChans[i].value = on ? 255 : 0;
+        bamDirty = true;
+      }
+  #endif
+}
+
 AckCode_t handleCmdLoc()
 {
-  digitalWrite(PIN_LOCATE, HIGH);
+  setLocator(true);
   blinkState = 1;
   blinkTime = millis();
   return ACK_OK;
@@ -522,23 +1162,19 @@ AckCode_t handleCmdLoc()
 AckCode_t handleCmdOff()
 {
   blinkState = 0;
+  for (Uint8 i = 0; i < NUM_NODE_PORTS; i++)
+    nodeMap[i].value = 0;  // (Also stops any effect)
   for (Uint8 i = 0; i < MAX_PORTS; i++)
-  {
-    if (portMap[i].isAnalog)
-      analogWrite(portMap[i].outPin, 0);
-    else
-      digitalWrite(portMap[i].outPin, LOW);
-  }
+    portWrite(i, 0);
   return ACK_OK;
 }
 
 AckCode_t handleCmdPort()
 {
-  Uint8 port   = buffer[currReadPos++];
-  Uint8 value  = buffer[currReadPos++];
-  Int8  pin;
+  Uint8 port   = rxBuf[currReadPos++];
+  Uint8 value  = rxBuf[currReadPos++];
 
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_PORT: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -546,15 +1182,11 @@ AckCode_t handleCmdPort()
 
   if ( (port > 0) && (port <= MAX_PORTS) )
   {
-    pin = portMap[port - 1].outPin;
-    if ( (pin == PIN_LOCATE) && blinkState )
+    if ( (portOutPin(port - 1) == PIN_LOCATE) && blinkState )
       blinkState = -1;
       
     // We can write to the pin associated with the port
-    if (portMap[port - 1].isAnalog)
-      analogWrite(pin, value);
-    else
-      digitalWrite(pin, value);
+    portWrite(port - 1, value);
   }
   else
     return ACK_EPORT;
@@ -564,13 +1196,11 @@ AckCode_t handleCmdPort()
 
 AckCode_t handleCmdCtrl()
 {
-  Uint8 dmxwChan = buffer[currReadPos++];
-  Uint8 value    = buffer[currReadPos++];
+  Uint8 dmxwChan = rxBuf[currReadPos++];
+  Uint8 value    = rxBuf[currReadPos++];
   Int8  port;
-  Int8  pin;
-  DmxwNodeMapRecord_t *currNodeMap = NULL;
 
-  if (bufSize != currReadPos)
+  if (rxSize != currReadPos)
   {
     logPrintln(FLASH("CMD_CTRL: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -583,23 +1213,19 @@ AckCode_t handleCmdCtrl()
     return ACK_EDMXW;
   }
   
-  currNodeMap = &nodeMap[dmxwChan - 1]; // Chan map for DMXW chan, dmxwChan
-  port = currNodeMap->port;  // Port assigned to dmxwChan
-  if (port > 0)
+  port = findPortByDmxwChan(dmxwChan);  // Port assigned to dmxwChan
+  if (port >= MAX_PORTS)
   {
-    pin = portMap[port - 1].outPin;
-    if ( (pin == PIN_LOCATE) && blinkState )
+    nodeMap[port].value = value;  // FX port: picked up by fxService()
+  }
+  else if (port != -1)
+  {
+    if ( (portOutPin(port) == PIN_LOCATE) && blinkState )
       blinkState = -1;
       
-    if (pin != -1)
-    {
-      // We can write to the pin associated with the port
-      currNodeMap->value = value;
-      if (portMap[port - 1].isAnalog)
-        analogWrite(pin, value);
-      else
-        digitalWrite(pin, value);
-    }
+    // We can write to the pin associated with the port
+    nodeMap[port].value = value;
+    portWrite(port, value);
   }
   else
     return ACK_EPORT;
@@ -607,6 +1233,193 @@ AckCode_t handleCmdCtrl()
   return ACK_OK;
 }
 
+AckCode_t handleCmdCurve()
+{
+  Uint8 offset = rxBuf[currReadPos++];
+  Uint8 count  = rxSize - currReadPos;
+
+  if ( (rxSize < currReadPos) || (count == 0) ||
+       (count > CURVE_CHUNK_LEN) ||
+       ((Uint16)offset + count > CURVE_TABLE_LEN) )
+  {
+    logPrintln(FLASH("CMD_CURVE: Packet dropped--corrupted"));
+    return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
+  }
+
+  // The (slow) EEPROM writes are done from loop(), after the ACK is sent,
+  // by which time the radio may have overwritten the packet. CMD_CURVE
+  // has no reply, so park the (o, v1, ..., vk) chunk in the TX buffer.
+  bufSize = count + 1;
+  memcpy(buffer, &rxBuf[currReadPos - 1], bufSize);
+  saveCurve = true;
+  return ACK_OK;
+}
+
+#ifdef FX_ENABLED
+// Run the on-node effect: output the level of each active channel,
+// modulated by the effect's gain at the current point in its cycle. Called
+// every loop() pass, so the effect's timing is independent of the run
+// frames.
+void fxService()
+{
+  ActiveChan_t *chan;
+  unsigned long now = micros();
+  unsigned long step = now - fx.lastUs;
+  Uint8 effect = nodeMap[FX_PORT_EFFECT - 1].value / 10;
+  Uint8 rate   = nodeMap[FX_PORT_RATE - 1].value;
+  Uint8 depth  = nodeMap[FX_PORT_DEPTH - 1].value;
+  bool  newCycle = false;
+  Uint8 phase;
+  Uint8 gain = 255;
+  Uint8 level;
+
+  fx.lastUs = now;
+  if ( (nodeMap[FX_PORT_EFFECT - 1].dmxwChan == 0) || (effect >= NUM_FX) )
+    effect = FX_OFF;
+  if (effect != fx.effect)
+  {
+    // Start the new effect at the beginning of its cycle. (When effects
+    // are turned off, the outputs are returned to their levels once.)
+    fx.effect = effect;
+    fx.pos = 0;
+    fx.cycles = 0;
+    newCycle = true;
+  }
+  else if (effect == FX_OFF)
+    return;
+
+  if (step > FX_MAX_STEP_US)
+    step = FX_MAX_STEP_US;
+  fx.pos += rate * step;
+  while (fx.pos >= FX_CYCLE_LEN)
+  {
+    fx.pos -= FX_CYCLE_LEN;
+    fx.cycles++;
+    newCycle = true;
+  }
+  phase = fx.pos / (FX_CYCLE_LEN / 256);
+
+  if (depth == 0)
+    depth = (effect == FX_STROBE) ? 64 : ((effect == FX_FLICKER) ? 128 : 255);
+
+  for (Uint8 i = 0; i < numActiveChans; i++)
+  {
+    chan = &activeChans[i];
+    if ( (portOutPin(chan->portIdx) == PIN_LOCATE) && blinkState )
+      continue;
+    switch (effect)
+    {
+      case FX_STROBE:
+        gain = (phase < depth) ? 255 : 0;
+        break;
+      case FX_CHASE:
+        gain = (((fx.cycles % numActiveChans) == i) && (phase < depth)) ?
+               255 : 0;
+        break;
+      case FX_PULSE:
+        // Triangle wave, rounded off by the S-curve
+        gain = (phase < 128) ? (phase << 1) : ((255 - phase) << 1);
+        gain = 255 - (((Uint16)(255 - curveValue(CURVE_SCURVE, gain)) *
+                       depth) >> 8);
+        break;
+      case FX_FLICKER:
+        if (newCycle)
+          fx.dip[i] = random(depth + 1);
+        gain = 255 - fx.dip[i];
+        break;
+    }
+    level = nodeMap[chan->portIdx].value;
+    if (chan->isDimmed)
+      level = ((Uint16)level * gain + 255) >> 8;
+    else
+      level = level && (gain >= 128);
+    portWrite(chan->portIdx, level);  // (No-op if unchanged)
+  }
+}
+#endif
+
+// Measure the supply voltage (mV) by reading the internal 1.1V bandgap
+// reference against AVcc.
+Uint16 readVcc()
+{
+  Uint16 adc;
+
+  ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+  delay(2);                           // Let the reference settle
+  ADCSRA |= _BV(ADSC);
+  while (ADCSRA & _BV(ADSC))
+    ;
+  adc = ADC;
+  return adc ? 1125300UL / adc : 0;   // 1.1V * 1023 * 1000 / adc
+}
+
+// Store v, clamped to 16 bits, MSB first.
+Uint8 *putTelem16(Uint8 *p, unsigned long v)
+{
+  if (v > 0xFFFF)
+    v = 0xFFFF;
+  *p++ = v >> 8;
+  *p++ = v;
+  return p;
+}
+
+AckCode_t handleCmdTreq()
+{
+  Uint8 *p = &ackBuf[1];
+  Uint16 vcc;
+
+  if (rxSize != 1)
+  {
+    logPrintln(FLASH("CMD_TREQ: Packet dropped--corrupted"));
+    return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
+  }
+
+  vcc = readVcc() / 20;
+  *p++ = (vcc > 255) ? 255 : vcc;
+  *p++ = telem.rssiCount ? telem.rssiTotal / telem.rssiCount : 0;
+  *p++ = telem.rssiWorst;
+  p = putTelem16(p, telem.frames);
+  p = putTelem16(p, telem.missed);
+  p = putTelem16(p, telem.loopMax);
+  ackLen = p - ackBuf;
+
+  telem.rssiTotal = telem.rssiCount = telem.rssiWorst = 0;
+  telem.frames = telem.missed = telem.loopMax = 0;
+  return ACK_OK;
+}
+
+// Account for a packet from the gateway in the telemetry.
+void telemGatewayPkt()
+{
+  unsigned long now = millis();
+  Uint8 rssi = -radio.RSSI;
+  Uint8 period;
+  unsigned long gap;
+
+  telem.rssiTotal += rssi;
+  telem.rssiCount++;
+  if (rssi > telem.rssiWorst)
+    telem.rssiWorst = rssi;
+  if (command != CMD_RUN)
+    return;
+
+  telem.frames++;
+  if ( (rxSize >= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN)) &&
+       (telem.lastRun != 0) )
+  {
+    // Count the frame periods elapsed since the last run frame
+    period = rxBuf[1 + MAX_DMXW_CHANS];
+    gap = now - telem.lastRun;
+    if ( (period != 0) && (gap < TELEM_IDLE_MS) )
+    {
+      gap = (gap + period / 2) / period;
+      if (gap > 1)
+        telem.missed += gap - 1;
+    }
+  }
+  telem.lastRun = now;
+}
+
 AckCode_t handleCmdTest()
 {
   logPrintln(FLASH("Test command received. Nothing to do."));
@@ -615,7 +1428,7 @@ AckCode_t handleCmdTest()
 
 AckCode_t handleCmdSave()
 {
-  if (bufSize != 1)
+  if (rxSize != 1)
   {
     logPrintln(FLASH("CMD_SAVE: Packet dropped--corrupted"));
     return ACK_NULL;  // Buffer is corrupted. Drop the DMXW packet.
@@ -653,6 +1466,8 @@ AckCode_t handleNetRxMessage(Uint8 command)
     case CMD_OFF:    ret = handleCmdOff();       break;
     case CMD_PORT:   ret = handleCmdPort();      break;
     case CMD_CTRL:   ret = handleCmdCtrl();      break;
+    case CMD_CURVE:  ret = handleCmdCurve();     break;
+    case CMD_TREQ:   ret = handleCmdTreq();      break;
     case CMD_TEST:   ret = handleCmdTest();      break;
     case CMD_SAVE:   ret = handleCmdSave();      break;
     case CMD_UNDEF:  ret = handleCmdUndef();     break;
@@ -686,6 +1501,8 @@ void printCommand(Uint8 command)
     case CMD_OFF:    dbgPrint(FLASH("CMD_OFF"));     break;
     case CMD_PORT:   dbgPrint(FLASH("CMD_PORT"));    break;
     case CMD_CTRL:   dbgPrint(FLASH("CMD_CTRL"));    break;
+    case CMD_CURVE:  dbgPrint(FLASH("CMD_CURVE"));   break;
+    case CMD_TREQ:   dbgPrint(FLASH("CMD_TREQ"));    break;
     case CMD_TEST:   dbgPrint(FLASH("CMD_TEST"));    break;
     case CMD_SAVE:   dbgPrint(FLASH("CMD_SAVE"));    break;
     case CMD_UNDEF:  dbgPrint(FLASH("CMD_UNDEF"));   break;
@@ -700,9 +1517,9 @@ if (command != CMD_RUN)
   logPrint(FLASH("RX cmd["));
   logPrint(command);
   logPrint(FLASH("]  ["));
-  for (int i = 0; i < bufSize; i++)
+  for (int i = 0; i < rxSize; i++)
   {
-    logPrint(buffer[i]);
+    logPrint(rxBuf[i]);
     logPrint(FLASH("  "));
   }
   logPrintln(FLASH("]"));
@@ -729,7 +1546,8 @@ void printAckResult(Uint8 ackResult)
 }
 
 
-// Send a message to a node on the wireless network
+// Send a message to a node on the wireless network. The packet header is
+// written into the DMXW_HDR_LEN bytes of headroom in front of payload.
 AckCode_t sendBuffer(int dst, Uint8 *payload, int sendSize, bool requestAck)
 {
   long sentTime;
@@ -749,8 +1567,13 @@ AckCode_t sendBuffer(int dst, Uint8 *payload, int sendSize, bool requestAck)
 
   if (dst == BROADCASTID)
     requestAck = false;
+  payload -= DMXW_HDR_LEN;
+  sendSize += DMXW_HDR_LEN;
+  payload[0] = DMXW_HDR(0, txSeq++);
   for (byte i = 0; i <= TX_NUM_RETRIES; i++)
   { 
+    if (i > 0)
+      payload[0] |= DMXW_HDR_RETRY;
     radio.send(dst, payload, sendSize, requestAck);
     sentTime = millis();
     if (requestAck)
@@ -802,14 +1625,24 @@ void showSerialHelp()
   logPrintln(FLASH("  (spaces may replaces commas)"));
   logPrintln(FLASH("<x> in {1,...,512};  <d>,<n> in {1,...,20};"));
   logPrintln(FLASH("<p> in {1,...,16};   <v> in {0,...,255}"));
+  #ifdef FX_ENABLED
+    logPrintln(FLASH("  (map ports 17-19 to set the effect, rate & depth)"));
+  #endif
   logPrintln(FLASH("  d <d>, <v>        - Simulate receipt of value v for "
                                              "for DMXW channel #d."));
   logPrintln(FLASH("  free              - display free RAM"));
   logPrintln(FLASH("  h                 - Print this help text"));
-  logPrintln(FLASH("  n <d>, <p>, <l>   - Map DMXW chan d to port p, with "
-                                         "values to be scaled "));
-  logPrintln(FLASH("                       logarithmically if l=1"));
+  logPrintln(FLASH("  loop              - Show RX latency & MCU awake time."));
+  logPrintln(FLASH("  n <d>, <p>, <c>   - Map DMXW chan d to port p, with "
+                                         "values shaped by curve c"));
+  logPrintln(FLASH("                       (0=linear, 1=log, 2=gamma 2.2, "
+                                         "3=S-curve, 4=user)"));
+  logPrintln(FLASH("                       (add 128 to c to dim a digital "
+                                         "port)"));
   logPrintln(FLASH("  p                 - Display the Port Mapping."));
+  #ifdef SOFT_PWM_ENABLED
+    logPrintln(FLASH("  pwm               - Show software PWM ISR load."));
+  #endif
   logPrintln(FLASH("  r <d>             - Remove map for DMXW chan d."));
   logPrintln(FLASH("  s                 - Show DMXW channel mapping."));
   logPrintln(FLASH("  nodeid <n>        - Set Node Id to n, n in "
@@ -830,8 +1663,9 @@ void getSerialCommand()
   Uint8  port = 0;
   Uint8  val = 0;
   Uint8  dmxwChan = 0;
-  Uint8  logarithmic = 0;
+  Uint8  curve = 0;
   Uint8  idx = 0;
+  Int8   portIdx;
   bool   cmdToProcess = false;
   bool   cmdInvalid = false;
   DmxwNodeMapRecord_t *tmp;
@@ -898,12 +1732,14 @@ void getSerialCommand()
           logPrintln(FLASH("*** Chan # out of range"));
           break;
         }
-        nodeMap[dmxwChan - 1].value = val;
-        memset(buffer, 0, sizeof(buffer));
+        memset(buffer, 0, TXBUF_LEN);
         command = CMD_RUN;
         buffer[bufSize++] = command;
-        for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
-          buffer[bufSize++] = nodeMap[i].value;
+        for (Uint8 i = 0; i < NUM_NODE_PORTS; i++)
+          if (nodeMap[i].dmxwChan != 0)
+            buffer[nodeMap[i].dmxwChan] = nodeMap[i].value;
+        buffer[dmxwChan] = val;
+        bufSize += MAX_DMXW_CHANS;
         logPrint(FLASH("Buffer: Size["));
         logPrint(bufSize);
         logPrint(FLASH("]  ["));
@@ -913,13 +1749,26 @@ void getSerialCommand()
           logPrint(" ");
         }
         logPrintln("]");
+        rxBuf  = buffer;
+        rxSize = bufSize;
         handleNetRxMessage(command);
         logPrintln(FLASH("CMD_RUN command processed"));
         break;
         
       case 'f':
         if (strstr(serialBuffer, "free") != null)
+        {
           CheckRam();
+          // The per-channel map (4 bytes per DMXW channel) and the port
+          // table used to be held in RAM.
+          logPrint(FLASH("  Channel map: "));
+          logPrint(sizeof(nodeMap));
+          logPrint(FLASH(" bytes (was "));
+          logPrint(MAX_DMXW_CHANS * 4);
+          logPrint(FLASH("); port table: "));
+          logPrint(sizeof(portMap));
+          logPrintln(FLASH(" bytes in flash"));
+        }
         break;
          
       case 'h':
@@ -928,6 +1777,17 @@ void getSerialCommand()
         showSerialHelp();
         break;
         
+      case 'l':
+        if (strstr(serialBuffer, "loop") != null)
+        {
+          // loop
+          // Show the loop latency and awake time statistics
+          showLoopStats();
+        }
+        else
+          cmdInvalid = true;
+        break;
+
       case 'n':
         if (strstr(serialBuffer, "nodeid") != null)
         {
@@ -952,14 +1812,13 @@ void getSerialCommand()
         }
         else
         {
-          // n <d>, <p>
-          // Map DMXW chan d to port p.
+          // n <d>, <p>, <c>
+          // Map DMXW chan d to port p, using response curve c.
           dmxwChan    = serialParseInt();
           port        = serialParseInt();
-          logarithmic = serialParseInt();
-          if (addNodeMap(dmxwChan, port, true, logarithmic))
+          curve       = serialParseInt();
+          if (addNodeMap(dmxwChan, port, true, curve))
           {
-            pinMode(portMap[port - 1].outPin, OUTPUT);
             logPrint(FLASH("Channel "));
             logPrint(dmxwChan);
             logPrint(FLASH(" is mapped to port "));
@@ -973,6 +1832,15 @@ void getSerialCommand()
         break;
         
       case 'p':
+        #ifdef SOFT_PWM_ENABLED
+          if (strstr(serialBuffer, "pwm") != null)
+          {
+            // pwm
+            // Show the software PWM ISR load
+            showBamStats();
+            break;
+          }
+        #endif
         // p
         // Display the Port Mapping
         logPrintln();
@@ -982,12 +1850,12 @@ void getSerialCommand()
         for (Uint8 i = 0; i < MAX_PORTS; i++)
         {
           logPrint(i + 1); logPrint(tabChar);
-          logPrint(portMap[i].inPin); logPrint(tabChar);
-          logPrint(portMap[i].outPin); logPrint(tabChar);
-          if (portMap[i].conflictPort != -1)
-            logPrint(portMap[i].conflictPort);
+          logPrint(portInPin(i)); logPrint(tabChar);
+          logPrint(portOutPin(i)); logPrint(tabChar);
+          if (portConflict(i) != -1)
+            logPrint(portConflict(i));
           logPrint(tabChar); logPrint("  ");
-          logPrintln(portMap[i].isAnalog ? "Y" : "N");
+          logPrintln(portIsAnalog(i) ? "Y" : "N");
         }
         logPrintln(FLASH("----------------------------------------"));
         logPrintln();
@@ -1009,19 +1877,20 @@ void getSerialCommand()
         logPrintln();
         logPrint(FLASH("DMX Channel Mapping for Node #"));
         logPrintln(myNodeId);
-        logPrintln(FLASH("DMXW Chan\tPort\tOut Pin\tAnalog?\tLog?\tValue"));
-        logPrintln(FLASH("---------\t----\t-------\t-------\t----\t-----"));
+        logPrintln(FLASH("DMXW Chan\tPort\tOut Pin\tAnalog?\tCurve\tValue"));
+        logPrintln(FLASH("---------\t----\t-------\t-------\t-----\t-----"));
         for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
         {
-          if (nodeMap[i].port != -1)
+          portIdx = findPortByDmxwChan(i + 1);
+          if (portIdx != -1)
           {
-            port = nodeMap[i].port - 1;
+            port = portIdx;
             logPrint(i + 1); logPrint(tabChar); logPrint(tabChar);
             logPrint(port + 1); logPrint(tabChar);
-            logPrint(portMap[port].outPin); logPrint(tabChar);
-            logPrint(portMap[port].isAnalog ? "Y" : "N"); logPrint(tabChar);
-            logPrint(nodeMap[i].isLogarithmic ? "Y" : "N"); logPrint(tabChar);
-            logPrintln(nodeMap[i].value);
+            logPrint(portOutPin(port)); logPrint(tabChar);
+            logPrint(portIsAnalog(port) ? "Y" : "N"); logPrint(tabChar);
+            logPrint(nodeMap[port].flags & ~NODEMAP_OUTPUT); logPrint(tabChar);
+            logPrintln(nodeMap[port].value);
           }
         }
         logPrintln(FLASH("-----------------------------------------------------"));
@@ -1085,14 +1954,18 @@ void setup()
   radio.promiscuous(promiscuousMode);
   currReadPos = 0;
   for (Uint8 i = 0; i < RF69_MAX_DATA_LEN; i++)
-    buffer[i] = 0;
+    txPkt[i] = 0;
   
-  for (Uint8 i = 0; i < MAX_DMXW_CHANS; i++)
+  for (Uint8 i = 0; i < NUM_NODE_PORTS; i++)
   {
-    nodeMap[i].port = -1;
+    nodeMap[i].dmxwChan = 0;
   }
 
   resetCount = EEPROM.read(1023) + 1;
+
+  // The port drivers must be set up before EepromLoad() builds the
+  // active channels from them (and allocates their BAM channels).
+  initPortDrivers();
   
   // Check if we need to clear out EEPROM and start from scratch
   resetEeprom = (EEPROM.read(EEPROM_FW_ADDR) != FW_VERSION_c);
@@ -1101,6 +1974,7 @@ void setup()
     // Record new F/W version and start with blank mappings
     EEPROM.write(EEPROM_FW_ADDR, FW_VERSION_c);
     EEPROM.write(EEPROM_VALIDITY_ADDR, 0);  // dataIsValid = false;
+    EEPROM.write(EEPROM_CURVE_VALID_ADDR, 0);
     resetCount = 0;
   }
   else
@@ -1109,6 +1983,7 @@ void setup()
     EepromLoad();
   }
   EEPROM.write(1023, resetCount);
+  userCurveValid = (EEPROM.read(EEPROM_CURVE_VALID_ADDR) == 1);
 
   Serial.print(FLASH("\nDMX Wireless Network...\t\tNode #"));
   Serial.print(myNodeId);
@@ -1132,20 +2007,227 @@ void setup()
   #endif
   
   pinMode(9, OUTPUT);  
+  statsStart = micros();
+  #ifdef SCHED_LISTEN_ENABLED
+    sched.radioOn = true;
+    sched.radioOnSince = statsStart;
+  #endif
+}
+
+
+// Wait for the next event: a radio packet, a timer tick or a serial
+// character. With IDLE_SLEEP_ENABLED the MCU idle-sleeps until an
+// interrupt; otherwise it spins for LOOP_DELAY_US. Either way, the time
+// a radio packet is first seen is recorded in rxArrival.
+void waitForEvent()
+{
+  unsigned long start = micros();
+
+  #ifdef IDLE_SLEEP_ENABLED
+    // Check for pending events with interrupts disabled so that an event
+    // arriving after the check still wakes the MCU: the instruction after
+    // sei() is always executed before any pending interrupt is serviced.
+    bool pending;
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    pending = (RFM69::PAYLOADLEN != 0) || (Serial.available() > 0);
+    #ifdef SOFT_PWM_ENABLED
+      pending = pending || bamDirty;
+    #endif
+    if (!pending)
+    {
+      sleep_enable();
+      sei();
+      sleep_cpu();
+      sleep_disable();
+    }
+    sei();
+    if (RFM69::PAYLOADLEN != 0)
+      rxArrival = micros();
+  #else
+    while ((micros() - start) < LOOP_DELAY_US)
+      if ((rxArrival == 0) && (RFM69::PAYLOADLEN != 0))
+        rxArrival = micros();
+  #endif
+  idleTotal += micros() - start;
+}
+
+#ifdef SCHED_LISTEN_ENABLED
+// Turn the receiver on (continuous RX).
+void schedRadioOn()
+{
+  if (!sched.radioOn)
+  {
+    radio.receiveDone();  // Puts the radio back into RX mode
+    sched.radioOn = true;
+    sched.radioOnSince = micros();
+  }
+}
+
+// Put the radio to sleep.
+void schedRadioOff()
+{
+  if (sched.radioOn)
+  {
+    radio.sleep();
+    sched.radioOn = false;
+    sched.radioOnTotal += micros() - sched.radioOnSince;
+  }
+}
+
+// Stay in continuous RX for a while (e.g. the gateway is configuring us).
+void schedHold()
+{
+  sched.active = false;
+  sched.holdUntil = millis() + SCHED_HOLD_MS;
+  schedRadioOn();
+}
+
+// A run frame of pktLen bytes, carrying a schedule trailer of period,
+// period, and next frame due in nextIn ms, arrived at rxArrival. If poll
+// is set, a CMD_TREQ follows it.
+void schedRunFrame(Uint8 period, Uint8 nextIn, Uint8 pktLen, bool poll)
+{
+  unsigned long err;
+
+  if (sched.active)
+  {
+    // Track the arrival jitter (EWMA, weight 1/8) and size the guard
+    // time to cover it.
+    err = (rxArrival >= sched.nextFrame) ? rxArrival - sched.nextFrame
+                                         : sched.nextFrame - rxArrival;
+    if (err > 8000)
+      err = 8000;
+    sched.jitter = (7 * (unsigned long)sched.jitter + err) / 8;
+    sched.frames++;
+  }
+  sched.guard = SCHED_MIN_GUARD_US + 3 * sched.jitter;
+  if (sched.guard > (Uint16)period * 250)
+    sched.guard = (Uint16)period * 250;
+  sched.misses = 0;
+  sched.period = period;
+  sched.nextFrame = rxArrival + nextIn * 1000UL;
+  // (Encrypted payloads are padded to a multiple of 16 bytes.)
+  sched.wakeTime = sched.nextFrame - sched.guard - SCHED_RADIO_WAKE_US -
+                   (((pktLen + 15) & ~15) + SCHED_PKT_OVERHEAD) * 8 *
+                   SCHED_BIT_US;
+
+  if ((period == 0) || ((long)(millis() - sched.holdUntil) < 0))
+    return;
+  sched.active = true;
+  if (poll)
+  {
+    sched.pollWait = true;
+    sched.pollUntil = micros() + SCHED_POLL_US;
+  }
+  else
+    schedRadioOff();
+}
+
+// Turn the receiver on and off around the predicted run frame windows.
+void schedService()
+{
+  unsigned long now = micros();
+
+  if (!sched.active)
+    return;
+  if (!sched.radioOn)
+  {
+    if ((long)(now - sched.wakeTime) >= 0)
+      schedRadioOn();
+  }
+  else if (sched.pollWait)
+  {
+    if ((long)(now - sched.pollUntil) >= 0)
+    {
+      sched.pollWait = false;
+      schedRadioOff();
+    }
+  }
+  else if ( ((long)(now - sched.nextFrame) > (long)sched.guard) &&
+            (RFM69::PAYLOADLEN == 0) )
+  {
+    // The window closed without a run frame.
+    sched.lost++;
+    if (++sched.misses >= SCHED_MAX_MISSES)
+    {
+      sched.active = false;  // Listen continuously until the next frame
+      sched.fallbacks++;
+      return;
+    }
+    sched.nextFrame += sched.period * 1000UL;
+    sched.wakeTime  += sched.period * 1000UL;
+    schedRadioOff();
+  }
 }
+#endif
 
+// Print and reset the loop latency and awake-time statistics.
+void showLoopStats()
+{
+  unsigned long elapsed = micros() - statsStart;
+
+  logPrint(FLASH("RX-to-output latency: avg "));
+  logPrint(latencyCount ? latencyTotal / latencyCount : 0);
+  logPrint(FLASH("us, max "));
+  logPrint(latencyMax);
+  logPrint(FLASH("us ("));
+  logPrint(latencyCount);
+  logPrintln(FLASH(" pkts)"));
+  logPrint(FLASH("MCU awake: "));
+  #ifdef IDLE_SLEEP_ENABLED
+    logPrint(elapsed ? 100 - (idleTotal / (elapsed / 100)) : 100);
+  #else
+    logPrint(100);  // The LOOP_DELAY_US spin is awake time too
+  #endif
+  logPrint(FLASH("% of "));
+  logPrint(elapsed / 1000);
+  logPrintln(FLASH("ms"));
+  #ifdef SCHED_LISTEN_ENABLED
+    if (sched.radioOn)
+    {
+      sched.radioOnTotal += micros() - sched.radioOnSince;
+      sched.radioOnSince = micros();
+    }
+    logPrint(FLASH("Radio on: "));
+    logPrint(elapsed ? sched.radioOnTotal / (elapsed / 100) : 100);
+    logPrint(FLASH("%  Sched "));
+    logPrint(sched.active ? FLASH("on") : FLASH("off"));
+    logPrint(FLASH(", frames "));
+    logPrint(sched.frames);
+    logPrint(FLASH(", lost "));
+    logPrint(sched.lost);
+    logPrint(FLASH(", fallbacks "));
+    logPrint(sched.fallbacks);
+    logPrint(FLASH(", guard "));
+    logPrint(sched.guard);
+    logPrintln(FLASH("us"));
+    sched.radioOnTotal = 0;
+    sched.frames = sched.lost = sched.fallbacks = 0;
+  #endif
+
+  latencyTotal = latencyMax = latencyCount = 0;
+  idleTotal = 0;
+  statsStart += elapsed;
+}
 
 void loop()
 {
+  unsigned long loopStart = micros();
+
   handleInput = false;
   bufSize = 0;
   dataToSend = false;
   requestAck = true;
   ackBuf[0] = ACK_ERR;
+  ackLen = 1;
   
   // Handle incoming messages.
   if (radio.receiveDone())
   {
+    if (rxArrival == 0)
+      rxArrival = micros();
     // Determine if the message is aimed at us.
     dstNodeId = radio.TARGETID;
     srcNodeId = radio.SENDERID;
@@ -1153,14 +2235,15 @@ void loop()
     if ( ( (dstNodeId == myNodeId) && (dstNodeId > NODEID_UNDEF) ) ||
          ( (dstNodeId == BROADCASTID) && (srcNodeId == GATEWAYID) ) )
     {
-      if ( (radio.DATA[0] == srcNodeId) && (radio.DATA[1] == dstNodeId))
+      if ( (radio.DATALEN > DMXW_HDR_LEN) && DMXW_HDR_OK(radio.DATA[0]) )
       {
-        bufSize = radio.DATALEN - 2;
-        if (bufSize <= (MAX_DMXW_CHANS + 1))
+        rxSize = radio.DATALEN - DMXW_HDR_LEN;
+        if (rxSize <= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN + RUN_TB_LEN))
         {
           handleInput = true;
           ackRequested = radio.ACK_REQUESTED;
-          memcpy(buffer, (const void *)&radio.DATA[2], bufSize);
+          rxHdr = radio.DATA[0];
+          rxBuf = (const Uint8 *)&radio.DATA[DMXW_HDR_LEN];
         }
         else
         {
@@ -1169,14 +2252,10 @@ void loop()
       }
       else
       {
-//JVS??
-        bufSize = radio.DATALEN - 2;
-        memcpy(buffer, (const void *)&radio.DATA[2], bufSize);
-//
-        logPrint(FLASH("*** RX corrupt pkt; dropped. ["));
-        for (int i = 0; i < bufSize; i++)
+        logPrint(FLASH("*** RX bad pkt header; dropped. ["));
+        for (int i = 0; i < radio.DATALEN; i++)
         {
-          logPrint(buffer[i]);
+          logPrint(radio.DATA[i]);
           logPrint(FLASH("  "));
         }
         logPrintln(FLASH("]"));
@@ -1191,8 +2270,8 @@ void loop()
       dbgPrint(dstNodeId);
       dbgPrintln(FLASH(")"));
 //JVS??  vvv
-/*        bufSize = radio.DATALEN - 2;
-        memcpy(buffer, (const void *)&radio.DATA[2], 30);
+/*        bufSize = radio.DATALEN - DMXW_HDR_LEN;
+        memcpy(buffer, (const void *)&radio.DATA[DMXW_HDR_LEN], 30);
 */
       logPrintln(FLASH(" ... ignored (pkt not for me)"));
 /*
@@ -1232,20 +2311,61 @@ logPrintln("]");
     {
       rxTime = millis();
       currReadPos = 0;
-      command = buffer[currReadPos++];
+      command = rxBuf[currReadPos++];
 
       dbgPrint(FLASH("Cmd["));
       printCommand(command);
       dbgPrint("] ");
       rxCount++;
-      ackBuf[0] = (Uint8) handleNetRxMessage(command);
+      if ( ackRequested && (srcNodeId == GATEWAYID) &&
+           (rxHdr & DMXW_HDR_RETRY) && (DMXW_HDR_SEQ(rxHdr) == lastGwSeq) )
+      {
+        // A retransmission of the command just handled: our ACK was lost.
+        // Re-send the ACK, but don't execute the command a second time.
+        dbgPrint(FLASH("(dup) "));
+        ackBuf[0] = lastAckCode;
+        ackLen = lastAckLen;
+      }
+      else
+      {
+        ackBuf[0] = (Uint8) handleNetRxMessage(command);
+      }
+      if (srcNodeId == GATEWAYID)
+      {
+        lastGwSeq = DMXW_HDR_SEQ(rxHdr);
+        lastAckCode = ackBuf[0];
+        lastAckLen = ackLen;
+        telemGatewayPkt();
+      }
+      #ifdef SCHED_LISTEN_ENABLED
+        if (command == CMD_RUN)
+        {
+          if (rxSize >= (MAX_DMXW_CHANS + 1 + RUN_SCHED_LEN))
+            schedRunFrame(rxBuf[1 + MAX_DMXW_CHANS],
+                          rxBuf[2 + MAX_DMXW_CHANS], radio.DATALEN,
+                          (rxHdr & DMXW_HDR_POLL) != 0);
+        }
+        else if (command == CMD_TREQ)
+          sched.pollUntil = micros();  // Polled; sleep once the ACK is out
+        else
+          schedHold();
+      #endif
+      if (rxArrival != 0)
+      {
+        // RX-to-output latency
+        unsigned long latency = micros() - rxArrival;
+        latencyTotal += latency;
+        latencyCount++;
+        if (latency > latencyMax)
+          latencyMax = latency;
+      }
 
       dbgPrint(FLASH("  Result["));
       printAckResult(ackBuf[0]);
       dbgPrintln("]");
       if (ackRequested)
       {
-        radio.sendACK(ackBuf, 1);
+        radio.sendACK(ackBuf, ackLen);
         dbgPrint(FLASH("ACK sent["));
         dbgPrint(millis() - rxTime);
         dbgPrintln("]");
@@ -1257,22 +2377,47 @@ logPrintln("]");
     getSerialCommand();
   #endif
 
+  #ifdef FX_ENABLED
+    fxService();
+  #endif
+
+  #ifdef SOFT_PWM_ENABLED
+    if (bamDirty)
+      bamRebuild();
+  #endif
+
   if (saveMappings)
   {
     saveMappings = false;
     EepromSave();
   }
+
+  if (saveCurve)
+  {
+    // buffer[] holds the (o, v1, ..., vk) chunk saved by handleCmdCurve().
+    // The chunk at offset 0 starts a new upload, so the table is invalid
+    // until the chunk holding its last entry has been written.
+    saveCurve = false;
+    if (buffer[0] == 0)
+    {
+      EEPROM.update(EEPROM_CURVE_VALID_ADDR, 0);
+      userCurveValid = false;
+    }
+    for (Uint8 i = 1; i < bufSize; i++)
+      EEPROM.update(EEPROM_CURVE_ADDR + buffer[0] + (i - 1), buffer[i]);
+    if ((Uint16)buffer[0] + (bufSize - 1) == CURVE_TABLE_LEN)
+    {
+      EEPROM.update(EEPROM_CURVE_VALID_ADDR, 1);
+      userCurveValid = true;
+    }
+  }
   
   if (dataToSend)
   {
 //JVS??
-    if ((bufSize + 2) <= RF69_MAX_DATA_LEN)
+    if (bufSize <= TXBUF_LEN)
     {
       ackTime = millis();
-      memmove(&buffer[2], buffer, bufSize);
-      bufSize += 2;
-      buffer[0] = myNodeId;
-      buffer[1] = node;
       ackBuf[0] = sendBuffer(node, buffer, bufSize, requestAck);
       dbgPrint(FLASH(" RxAck["));
       dbgPrint(millis() - ackTime);
@@ -1299,11 +2444,15 @@ logPrintln("]");
     {
       blinkTime = lastTime;
       blinkState = -blinkState;
-      if (blinkState == 1)
-        digitalWrite(PIN_LOCATE, HIGH);
-      else
-        digitalWrite(PIN_LOCATE, LOW);
+      setLocator(blinkState == 1);
     }
   }
-  delayMicroseconds(2000);
+  #ifdef SCHED_LISTEN_ENABLED
+    schedService();
+  #endif
+  loopStart = micros() - loopStart;
+  if (loopStart > telem.loopMax)
+    telem.loopMax = loopStart;
+  rxArrival = 0;
+  waitForEvent();
 }
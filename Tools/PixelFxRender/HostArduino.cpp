@@ -0,0 +1,202 @@
+/******************************************************************************
+ * HostArduino.cpp
+ *
+ * Host implementations of the stub Arduino core and libraries (stubs/).
+ ******************************************************************************/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <RFM69.h>
+#include <Adafruit_NeoPixel.h>
+
+unsigned long hostMicros = 0;    // Host clock: micros(), and millis() / 1000
+bool          hostVerbose = false;
+
+HardwareSerial Serial;
+EEPROMClass    EEPROM;
+
+volatile uint8_t  SREG, ADMUX, ADCSRA, ADCL, ADCH;
+volatile uint16_t ADC;
+
+// Heap bounds (avr-libc), for the sketches' CheckRam()
+int   __bss_end;
+void *__brkval;
+
+static uint8_t       eeprom[1024];
+static bool          eepromErased = false;
+static unsigned long randState = 1;
+static uint8_t       portReg;
+
+
+unsigned long millis()               { return hostMicros / 1000; }
+unsigned long micros()               { return hostMicros; }
+void delay(unsigned long ms)         { hostMicros += ms * 1000; }
+void delayMicroseconds(unsigned int us)  { hostMicros += us; }
+
+// The same sequence on every run (for comparable renders)
+long random(long howBig)
+{
+  if (howBig <= 0)
+    return 0;
+  randState = randState * 1103515245UL + 12345UL;
+  return (long)((randState >> 16) & 0x7FFF) % howBig;
+}
+
+long random(long howSmall, long howBig)
+{
+  if (howSmall >= howBig)
+    return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed)  { randState = seed ? seed : 1; }
+
+void pinMode(uint8_t, uint8_t)       { }
+void digitalWrite(uint8_t, uint8_t)  { }
+int  digitalRead(uint8_t)            { return LOW; }
+void analogWrite(uint8_t, int)       { }
+int  analogRead(uint8_t)             { return 0; }
+uint8_t digitalPinToPort(uint8_t)    { return 0; }
+uint8_t digitalPinToBitMask(uint8_t pin)  { return 1 << (pin & 7); }
+volatile uint8_t *portOutputRegister(uint8_t)  { return &portReg; }
+void cli()                           { }
+void sei()                           { }
+
+
+size_t Print::print(const char *s)
+{
+  if (!hostVerbose)
+    return 0;
+  fputs(s, stdout);
+  return strlen(s);
+}
+
+size_t Print::print(char c)
+{
+  return hostVerbose ? (putchar(c), 1) : 0;
+}
+
+size_t Print::print(unsigned char n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base)
+{
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+  if ( (base == DEC) && (n < 0) )
+    return print('-') + print((unsigned long)-n, base);
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+
+  *p = '\0';
+  do
+  {
+    *--p = "0123456789ABCDEF"[n % base];
+    n /= base;
+  } while (n != 0);
+  return print(p);
+}
+
+size_t Print::print(double n, int digits)
+{
+  char buf[32];
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+size_t Print::println()
+{
+  return print("\r\n");
+}
+
+size_t Print::write(uint8_t c)
+{
+  return print((char)c);
+}
+
+size_t Print::write(const uint8_t *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    write(buf[i]);
+  return len;
+}
+
+
+uint8_t EEPROMClass::read(int addr)
+{
+  if (!eepromErased)
+  {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    eepromErased = true;
+  }
+  return eeprom[addr & (sizeof(eeprom) - 1)];
+}
+
+void EEPROMClass::write(int addr, uint8_t val)
+{
+  read(addr);  // (Erase on first use)
+  eeprom[addr & (sizeof(eeprom) - 1)] = val;
+}
+
+
+volatile uint8_t RFM69::DATA[RF69_MAX_DATA_LEN + 1];
+volatile uint8_t RFM69::DATALEN, RFM69::SENDERID, RFM69::TARGETID;
+volatile uint8_t RFM69::PAYLOADLEN, RFM69::ACK_REQUESTED, RFM69::ACK_RECEIVED;
+volatile int16_t RFM69::RSSI;
+
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, uint8_t, neoPixelType type)
+{
+  numLEDs   = n;
+  numBytes  = n * 3;
+  pixels    = (uint8_t *)calloc(numBytes ? numBytes : 1, 1);
+  rOffset   = (type >> 4) & 0x03;
+  gOffset   = (type >> 2) & 0x03;
+  bOffset   = type & 0x03;
+  hostShows = 0;
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel()
+{
+  free(pixels);
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g,
+                                      uint8_t b)
+{
+  if (n < numLEDs)
+  {
+    pixels[n * 3 + rOffset] = r;
+    pixels[n * 3 + gOffset] = g;
+    pixels[n * 3 + bOffset] = b;
+  }
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c)
+{
+  setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const
+{
+  if (n >= numLEDs)
+    return 0;
+  return Color(pixels[n * 3 + rOffset], pixels[n * 3 + gOffset],
+               pixels[n * 3 + bOffset]);
+}
@@ -0,0 +1,35 @@
+/* HostFx.h */
+#ifndef HostFx_h
+#define HostFx_h
+
+/*************************************************************************
+ * The renderer's view of the sketches built for the host: each is driven
+ * through a few glue functions, compiled along with it (NodeFx.cpp,
+ * TesterFx.cpp), so that the renderer needn't see the sketches' globals.
+ *************************************************************************/
+
+#include <stdint.h>
+
+#define HOST_FX_ARGS  7       // Effect arguments (Arg #1 - #7)
+
+extern unsigned long hostMicros;  // Host clock (see stubs/Arduino.h)
+extern bool          hostVerbose;
+
+// Pixel strip node (DMXW_Node_Pixel_Strip): strip output 1, with its
+// block of ports set to the given [Delay], effect and arguments.
+void        nodeInit(uint16_t leds);
+void        nodeSetEffect(uint8_t effect, uint8_t delay, const uint8_t *args);
+int         nodeNumEffects();
+bool        nodeHasEffect(uint8_t effect);
+const char *nodeEffectName(uint8_t effect);
+bool        nodeService();    // Run the effect; true if it rendered a frame
+void        nodeShow();
+uint16_t    nodeNumPixels();
+void        nodePixel(uint16_t n, uint8_t *rgb);
+
+// Tester (DMXW_Tester__output_processor): its pixel strip test pattern.
+void        testerInit(uint16_t leds, uint8_t delay);
+bool        testerService();  // Run RainbowFxIter(); true if it rendered
+void        testerPixel(uint16_t n, uint8_t *rgb);
+
+#endif
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * NodeFx.cpp
+ *
+ * The pixel strip node sketch, built for the host, and the renderer's glue
+ * to it (see HostFx.h). The sketch is compiled unchanged; the prototypes
+ * the Arduino IDE would generate for it are generated by the Makefile.
+ ******************************************************************************/
+
+#include <Arduino.h>
+#include <RFM69.h>
+#include <EEPROM.h>
+#include <Adafruit_NeoPixel.h>
+#include "DMXWNet.h"
+#include "DMXW_Node_Pixel_Strip.protos.h"
+#include "DMXW_Node_Pixel_Strip.ino"
+#include "HostFx.h"
+
+
+// Configure the node as if from its serial console and EEPROM (one strip
+// output of leds pixels, its block of ports mapped to DMXW channels 1 - 9)
+// and start it up.
+void nodeInit(uint16_t leds)
+{
+  ledStripCtrlPin = NEO_PIN;
+  ledStripFreq    = 8;
+  ledStripWiring  = 1;
+  ledStripLen     = leds;
+  for (Uint8 i = 0; i < PIXEL_BLOCK_PORTS; i++)
+  {
+    nodeMap[i].dmxwChan = i + 1;
+    nodeMap[i].flags    = CURVE_LINEAR;
+  }
+  EepromSave();
+  EEPROM.write(EEPROM_FW_ADDR, FW_VERSION_c);
+  setup();
+}
+
+// Set output 1's block of ports, as a run frame would.
+void nodeSetEffect(uint8_t effect, uint8_t delay, const uint8_t *args)
+{
+  nodeMap[0].value = delay;
+  nodeMap[1].value = effect * 10;
+  for (Uint8 i = 0; i < HOST_FX_ARGS; i++)
+    nodeMap[2 + i].value = args[i];
+  outs[0]->stripParamChange = true;
+  disableEffects = false;
+}
+
+int nodeNumEffects()
+{
+  return NUM_STRIP_FX;
+}
+
+bool nodeHasEffect(uint8_t effect)
+{
+  return (effect < NUM_STRIP_FX) &&
+         (pgm_read_word(&fxTable[effect].render) != NULL);
+}
+
+const char *nodeEffectName(uint8_t effect)
+{
+  return (effect < NUM_STRIP_FX) ? fxTable[effect].name : "";
+}
+
+bool nodeService()
+{
+  unsigned long frames = fxFrames;
+
+  stripService(0);
+  return fxFrames != frames;
+}
+
+void nodeShow()
+{
+  stripShow();
+}
+
+uint16_t nodeNumPixels()
+{
+  return outs[0]->stripPix;
+}
+
+// Pixel n as the strip would show it, { r, g, b }.
+void nodePixel(uint16_t n, uint8_t *rgb)
+{
+  const Uint8 *pixel = &outs[0]->strip->getPixels()[n * 3];
+
+  rgb[0] = pixel[pixOffsRed];
+  rgb[1] = pixel[pixOffsGreen];
+  rgb[2] = pixel[pixOffsBlue];
+}
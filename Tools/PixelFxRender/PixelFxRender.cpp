@@ -0,0 +1,236 @@
+/******************************************************************************
+ * PixelFxRender
+ *
+ * Offline renderer and benchmark for the pixel effects: the pixel strip
+ * node's effects (DMXW_Node_Pixel_Strip) and the tester's pixel strip
+ * test pattern (RainbowFxIter() in DMXW_Tester__output_processor), built
+ * for a Linux host against stub Arduino and NeoPixel libraries (stubs/).
+ * Effects can be previewed and profiled without flashing a node.
+ *
+ * Usage:
+ *   PixelFxRender [-e <effect>] [-d <delay>] [-a <a1>,...,<a7>]
+ *                 [-l <leds>] [-n <frames>] [-t <ms>] [-o <prefix>]
+ *                 [-z <zoom>] [-v]
+ *   PixelFxRender -b [-l <leds>] [-n <frames>] [-t <ms>]
+ *
+ *     -e  Effect # (as Port 2 / 10: 1 = Colour Wipe, ..., 7 = Twinkle), or
+ *         0 for the tester's rainbow. (Default 2, Rainbow.)
+ *     -d  [Delay], ms per effect step (Port 1). (Default 20.)
+ *     -a  Effect arguments #1 - #7 (Ports 3 - 9). (Default 255,255,255.)
+ *     -l  Strip length, LEDs. (Default 60.)
+ *     -n  # of frames to run. (Default 200.)
+ *     -t  Time between frames, ms (the node's loop() rate). (Default 10.)
+ *     -o  Write each frame to <prefix>NNNN.ppm: one row of LEDs, each a
+ *         <zoom> x <zoom> pixel block. (E.g. for ffmpeg -i <prefix>%04d.ppm)
+ *     -z  Zoom. (Default 8.)
+ *     -v  Show the node's console output.
+ *     -b  Benchmark: run every effect, and report the render time of each.
+ *
+ * Render times are measured with the host's clock around the effect
+ * service call (stripService() for the node, including its effect clock
+ * and render budget bookkeeping), over the frames that rendered, and
+ * reported per frame and per LED. They're for comparing effects and
+ * catching regressions: a 16 MHz AVR is roughly two orders of magnitude
+ * slower, and the host's int is 32 bits wide where the AVR's is 16.
+ *
+ * The node is built as configured in its sketch; the palette framebuffer
+ * (PALETTE_FB_ENABLED) drives the strip from AVR assembler, so must be
+ * left disabled.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include "HostFx.h"
+
+#define DEF_EFFECT    2
+#define DEF_DELAY    20
+#define DEF_LEDS     60
+#define DEF_FRAMES  200
+#define DEF_TICK_MS  10
+#define DEF_ZOOM      8
+#define MAX_LEDS    255   // The node's library pixel buffer limit
+
+typedef struct render_t {
+  int           effect;         // Node effect #, or 0 for the tester's
+  uint8_t       delay;
+  uint8_t       args[HOST_FX_ARGS];
+  uint16_t      leds;
+  unsigned long frames;
+  unsigned long tickMs;
+  const char   *prefix;         // Frame images (NULL = none)
+  int           zoom;
+} Render_t;
+
+typedef struct renderStats_t {
+  unsigned long rendered;       // Frames rendered
+  double        totalUs;        // Time spent rendering them
+} RenderStats_t;
+
+
+static void usage()
+{
+  fprintf(stderr,
+    "Usage: PixelFxRender [-e effect] [-d delay] [-a a1,...,a7] [-l leds]\n"
+    "                     [-n frames] [-t ms] [-o prefix] [-z zoom] [-v]\n"
+    "       PixelFxRender -b [-l leds] [-n frames] [-t ms]\n");
+  exit(2);
+}
+
+static const char *effectName(int effect)
+{
+  return (effect == 0) ? "Tester Rainbow" : nodeEffectName(effect);
+}
+
+// Write the strip's pixels as a PPM image.
+static bool writeFrame(const Render_t *r, unsigned long frame)
+{
+  char     path[1024];
+  uint8_t  rgb[3];
+  uint16_t leds = (r->effect == 0) ? r->leds : nodeNumPixels();
+  FILE    *f;
+
+  snprintf(path, sizeof(path), "%s%04lu.ppm", r->prefix, frame);
+  f = fopen(path, "wb");
+  if (f == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", leds * r->zoom, r->zoom);
+  for (int y = 0; y < r->zoom; y++)
+    for (uint16_t n = 0; n < leds; n++)
+    {
+      if (r->effect == 0)
+        testerPixel(n, rgb);
+      else
+        nodePixel(n, rgb);
+      for (int x = 0; x < r->zoom; x++)
+        fwrite(rgb, 1, 3, f);
+    }
+  fclose(f);
+  return true;
+}
+
+// Run the effect for r->frames loop() passes, r->tickMs apart on the host
+// clock, timing the frames it renders.
+static bool render(const Render_t *r, RenderStats_t *stats)
+{
+  std::chrono::steady_clock::time_point start;
+  bool rendered;
+
+  stats->rendered = 0;
+  stats->totalUs  = 0;
+  for (unsigned long frame = 0; frame < r->frames; frame++)
+  {
+    hostMicros += r->tickMs * 1000;
+    start = std::chrono::steady_clock::now();
+    rendered = (r->effect == 0) ? testerService() : nodeService();
+    if (rendered)
+    {
+      stats->totalUs += std::chrono::duration<double, std::micro>(
+                          std::chrono::steady_clock::now() - start).count();
+      stats->rendered++;
+    }
+    if (r->effect != 0)
+      nodeShow();
+    if ( (r->prefix != NULL) && !writeFrame(r, frame) )
+      return false;
+  }
+  return true;
+}
+
+static void report(const Render_t *r, const RenderStats_t *stats)
+{
+  double perFrame = stats->rendered ? stats->totalUs / stats->rendered : 0;
+
+  printf("%-24s %8lu %10.2f %10.1f\n", effectName(r->effect),
+         stats->rendered, perFrame, (perFrame * 1000) / r->leds);
+}
+
+int main(int argc, char *argv[])
+{
+  Render_t      r;
+  RenderStats_t stats;
+  bool          bench = false;
+  char         *arg;
+  int           opt;
+
+  memset(&r, 0, sizeof(r));
+  r.effect = DEF_EFFECT;
+  r.delay  = DEF_DELAY;
+  r.args[0] = r.args[1] = r.args[2] = 255;
+  r.leds   = DEF_LEDS;
+  r.frames = DEF_FRAMES;
+  r.tickMs = DEF_TICK_MS;
+  r.zoom   = DEF_ZOOM;
+
+  while ((opt = getopt(argc, argv, "e:d:a:l:n:t:o:z:vb")) != -1)
+  {
+    switch (opt)
+    {
+      case 'e': r.effect = atoi(optarg);            break;
+      case 'd': r.delay  = atoi(optarg);            break;
+      case 'l': r.leds   = atoi(optarg);            break;
+      case 'n': r.frames = strtoul(optarg, NULL, 0); break;
+      case 't': r.tickMs = strtoul(optarg, NULL, 0); break;
+      case 'o': r.prefix = optarg;                  break;
+      case 'z': r.zoom   = atoi(optarg);            break;
+      case 'v': hostVerbose = true;                 break;
+      case 'b': bench = true;                       break;
+      case 'a':
+        memset(r.args, 0, sizeof(r.args));
+        arg = strtok(optarg, ",");
+        for (int i = 0; (i < HOST_FX_ARGS) && (arg != NULL); i++)
+        {
+          r.args[i] = atoi(arg);
+          arg = strtok(NULL, ",");
+        }
+        break;
+      default:
+        usage();
+    }
+  }
+  if ( (optind < argc) || (r.leds < 1) || (r.leds > MAX_LEDS) ||
+       (r.zoom < 1) || (r.tickMs < 1) )
+    usage();
+
+  // (The node and tester keep their state in globals: set each up once.)
+  nodeInit(r.leds);
+  testerInit(r.leds, r.delay);
+
+  if (bench)
+  {
+    r.prefix = NULL;
+    printf("%d LEDs, %lu loop() passes %lums apart, [Delay] %d\n",
+           r.leds, r.frames, r.tickMs, r.delay);
+    printf("%-24s %8s %10s %10s\n", "Effect", "Frames", "us/frame",
+           "ns/LED");
+    for (r.effect = 0; r.effect < nodeNumEffects(); r.effect++)
+    {
+      if ( (r.effect != 0) && !nodeHasEffect(r.effect) )
+        continue;
+      if (r.effect != 0)
+        nodeSetEffect(r.effect, r.delay, r.args);
+      render(&r, &stats);
+      report(&r, &stats);
+    }
+    return 0;
+  }
+
+  if ( (r.effect < 0) ||
+       ( (r.effect != 0) && !nodeHasEffect(r.effect) ) )
+  {
+    fprintf(stderr, "Unknown effect: %d\n", r.effect);
+    return 1;
+  }
+  if (r.effect != 0)
+    nodeSetEffect(r.effect, r.delay, r.args);
+  if (!render(&r, &stats))
+    return 1;
+  printf("%-24s %8s %10s %10s\n", "Effect", "Frames", "us/frame", "ns/LED");
+  report(&r, &stats);
+  return 0;
+}
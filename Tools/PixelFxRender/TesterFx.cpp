@@ -0,0 +1,58 @@
+/******************************************************************************
+ * TesterFx.cpp
+ *
+ * The tester's output processor sketch, built for the host, and the
+ * renderer's glue to it (see HostFx.h). The sketch is compiled unchanged,
+ * in its own namespace (its names would clash with the node's).
+ ******************************************************************************/
+
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+#include <RFM69_DMX.h>
+#include <EEPROM.h>
+#include <Adafruit_NeoPixel.h>
+#include "HostFx.h"
+
+namespace tester
+{
+  #include "DmxwDefs.h"
+  #include "TesterDefs.h"
+  #include "DMXW_Tester__output_processor.protos.h"
+  #include "DMXW_Tester__output_processor.ino"
+
+  int   __bss_end;  // (Heap bounds, for CheckRam(), declared in the
+  void *__brkval;   //   sketch's namespace)
+}
+
+static tester::uint16 rainbowState;  // RainbowFxIter() state
+
+
+// Set up the onboard pixel strip test, as OutputChannels() does when it
+// starts.
+void testerInit(uint16_t leds, uint8_t delay)
+{
+  tester::s_NumPixels = leds;
+  tester::s_FxDelay   = delay;
+  tester::s_pStrip    = new Adafruit_NeoPixel(leds, CHAN5_PWM_PIN,
+                                              NEO_KHZ400);
+  tester::s_pStrip->begin();
+  tester::s_pPixels   = tester::s_pStrip->getPixels();
+  rainbowState = 0;
+}
+
+bool testerService()
+{
+  unsigned long shows = tester::s_pStrip->hostShows;
+
+  tester::RainbowFxIter(&rainbowState);
+  return tester::s_pStrip->hostShows != shows;
+}
+
+void testerPixel(uint16_t n, uint8_t *rgb)
+{
+  const uint8_t *pixel = &tester::s_pPixels[n * LEDS_PER_PIX];
+
+  rgb[0] = pixel[PIX_OFFS_RED];
+  rgb[1] = pixel[PIX_OFFS_GREEN];
+  rgb[2] = pixel[PIX_OFFS_BLUE];
+}
@@ -0,0 +1,39 @@
+# protos.awk
+#
+# Print the prototypes of an Arduino sketch's functions, as the Arduino IDE
+# generates them, so that the sketch builds as plain C++: a definition
+# starts at the beginning of a line with the function's return type, and
+# its parameter list (which may run over several lines) is followed by the
+# opening brace on a line of its own.
+
+function parens(s,    t)
+{
+  t = s
+  return gsub(/\(/, "", t) - gsub(/\)/, "", s)
+}
+
+/^\{[ \t]*($|\/\/)/ {
+  if ( (sig ~ /^[A-Za-z_][A-Za-z0-9_ \t*&]*[ \t*&]+[A-Za-z_][A-Za-z0-9_]*[ \t]*\(.*\)[ \t]*$/) &&
+       (sig !~ /^(typedef|struct|union|enum|class|else|if|for|while|switch|return)[ \t(]/) )
+    print sig ";"
+}
+
+{
+  if (open > 0)
+  {
+    # Parameter list continued
+    line = $0
+    sub(/^[ \t]+/, "", line)
+    sig = sig " " line
+    open += parens($0)
+  }
+  else if ($0 ~ /^[A-Za-z_]/)
+  {
+    sig  = $0
+    open = parens($0)
+  }
+  else
+    sig = ""
+  if (open < 0)
+    open = 0
+}
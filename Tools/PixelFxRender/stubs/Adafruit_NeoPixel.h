@@ -0,0 +1,49 @@
+/* Adafruit_NeoPixel.h (host stub) */
+#ifndef ADAFRUIT_NEOPIXEL_H
+#define ADAFRUIT_NEOPIXEL_H
+
+#include <Arduino.h>
+
+/*************************************************************************
+ * The library's pixel buffer, without a strip: show() just counts the
+ * frames sent (hostShows). The colour order in the buffer follows the
+ * type flags, as in the library.
+ *************************************************************************/
+
+#define NEO_RGB     ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_RBG     ((0 << 6) | (0 << 4) | (2 << 2) | (1))
+#define NEO_GRB     ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800  0x0000
+#define NEO_KHZ400  0x0100
+
+typedef uint16_t neoPixelType;
+
+class Adafruit_NeoPixel
+{
+public:
+  Adafruit_NeoPixel(uint16_t n, uint8_t pin = 6,
+                    neoPixelType type = NEO_GRB + NEO_KHZ800);
+  ~Adafruit_NeoPixel();
+
+  void      begin()                     { }
+  void      show()                      { hostShows++; }
+  void      setPin(uint8_t)             { }
+  void      setBrightness(uint8_t)      { }
+  void      clear()                     { memset(pixels, 0, numBytes); }
+  void      setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  void      setPixelColor(uint16_t n, uint32_t c);
+  uint32_t  getPixelColor(uint16_t n) const;
+  uint8_t  *getPixels() const           { return pixels; }
+  uint16_t  numPixels() const           { return numLEDs; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+    { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+
+  unsigned long hostShows;              // Frames "sent" (host only)
+
+private:
+  uint16_t  numLEDs, numBytes;
+  uint8_t  *pixels;
+  uint8_t   rOffset, gOffset, bOffset;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/* Arduino.h (host stub) */
+#ifndef Arduino_h
+#define Arduino_h
+
+/*************************************************************************
+ * Just enough of the Arduino core to build the sketches' effect code on
+ * a Linux host (see PixelFxRender.cpp). Time comes from the host clock,
+ * hostMicros, which the renderer steps from frame to frame; the I/O
+ * calls do nothing, and Serial output goes to stdout only if
+ * hostVerbose.
+ *************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+typedef uint8_t  byte;
+typedef bool     boolean;
+typedef uint16_t word;
+
+#define null  NULL
+#define HIGH  1
+#define LOW   0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define A0    14
+
+#define DEC  10
+#define HEX  16
+#define BIN   2
+
+// Flash: the host keeps it all in RAM. pgm_read_word() is typed, so that
+// the function pointers kept in flash tables (read as words on the AVR)
+// survive on a 64-bit host.
+#define PROGMEM
+#define PSTR(x)               (x)
+#define F(x)                  (x)
+typedef char __FlashStringHelper;
+#define pgm_read_byte(p)      (*(const uint8_t *)(p))
+#define pgm_read_word(p)      (*(p))
+#define pgm_read_dword(p)     (*(p))
+#define memcpy_P              memcpy
+#define strcpy_P              strcpy
+#define strlen_P              strlen
+
+#define _BV(b)                (1u << (b))
+#define bit(b)                (1ul << (b))
+#define lowByte(w)            ((uint8_t)((w) & 0xFF))
+#define highByte(w)           ((uint8_t)((w) >> 8))
+#define min(a, b)             ((a) < (b) ? (a) : (b))
+#define max(a, b)             ((a) > (b) ? (a) : (b))
+#define constrain(x, a, b)    ((x) < (a) ? (a) : ((x) > (b) ? (b) : (x)))
+
+// Host clock and console
+extern unsigned long hostMicros;
+extern bool          hostVerbose;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+int  analogRead(uint8_t pin);
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+volatile uint8_t *portOutputRegister(uint8_t port);
+
+void cli();
+void sei();
+#define noInterrupts()  cli()
+#define interrupts()    sei()
+
+// Registers touched outside the effects (e.g. the supply voltage reading)
+extern volatile uint8_t  SREG, ADMUX, ADCSRA, ADCL, ADCH;
+extern volatile uint16_t ADC;
+#define REFS0  6
+#define MUX3   3
+#define MUX2   2
+#define MUX1   1
+#define ADSC   6
+#define ADEN   7
+
+class Print
+{
+public:
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(unsigned char n, int base = DEC);
+  size_t print(int n, int base = DEC);
+  size_t print(unsigned int n, int base = DEC);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+  size_t println();
+  template <typename T> size_t println(T x)
+    { return print(x) + println(); }
+  template <typename T> size_t println(T x, int base)
+    { return print(x, base) + println(); }
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buf, size_t len);
+};
+
+class Stream : public Print
+{
+public:
+  int  available()                           { return 0; }
+  int  read()                                { return -1; }
+  int  peek()                                { return -1; }
+  void flush()                               { }
+  void setTimeout(unsigned long)             { }
+  long parseInt()                            { return 0; }
+  size_t readBytesUntil(char, char *, size_t) { return 0; }
+};
+
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long)  { }
+  void end()                 { }
+  operator bool()            { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
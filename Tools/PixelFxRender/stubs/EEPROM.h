@@ -0,0 +1,17 @@
+/* EEPROM.h (host stub) */
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+// 1K of EEPROM, in RAM (erased: all 0xFF)
+struct EEPROMClass
+{
+  uint8_t read(int addr);
+  void    write(int addr, uint8_t val);
+  void    update(int addr, uint8_t val)  { write(addr, val); }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,38 @@
+/* RFM69.h (host stub) */
+#ifndef RFM69_h
+#define RFM69_h
+
+#include <Arduino.h>
+
+// A radio that never receives anything, and drops what it's sent.
+#define RF69_MAX_DATA_LEN  61
+#define RF69_433MHZ        43
+#define RF69_868MHZ        86
+#define RF69_915MHZ        91
+
+class RFM69
+{
+public:
+  static volatile uint8_t DATA[RF69_MAX_DATA_LEN + 1];
+  static volatile uint8_t DATALEN, SENDERID, TARGETID, PAYLOADLEN;
+  static volatile uint8_t ACK_REQUESTED, ACK_RECEIVED;
+  static volatile int16_t RSSI;
+
+  bool initialize(uint8_t, uint8_t, uint8_t = 1)        { return true; }
+  void encrypt(const char *)                            { }
+  void promiscuous(bool)                                { }
+  void setHighPower(bool = true)                        { }
+  bool receiveDone()                                    { return false; }
+  bool ACKReceived(uint8_t)                             { return false; }
+  bool ACKRequested()                                   { return false; }
+  void sendACK(const void * = 0, uint8_t = 0)           { }
+  void send(uint8_t, const void *, uint8_t, bool = false) { }
+  bool sendWithRetry(uint8_t, const void *, uint8_t,
+                     uint8_t = 2, uint8_t = 40)         { return false; }
+  bool canSend()                                        { return true; }
+  int16_t readRSSI(bool = false)                        { return 0; }
+  void receiveBegin()                                   { }
+  void sleep()                                          { }
+};
+
+#endif
@@ -0,0 +1,9 @@
+/* RFM69_DMX.h (host stub) */
+#ifndef RFM69_DMX_h
+#define RFM69_DMX_h
+
+#include <RFM69.h>
+
+#define MAX_DATA_LEN  RF69_MAX_DATA_LEN
+
+#endif
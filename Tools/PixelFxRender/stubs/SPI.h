@@ -0,0 +1,2 @@
+/* SPI.h (host stub) */
+#include <Arduino.h>
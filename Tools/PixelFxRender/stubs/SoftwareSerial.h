@@ -0,0 +1,17 @@
+/* SoftwareSerial.h (host stub) */
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h
+
+#include <Arduino.h>
+
+class SoftwareSerial : public Stream
+{
+public:
+  SoftwareSerial(int, int)   { }
+  void begin(long)           { }
+  bool listen()              { return true; }
+  bool isListening()         { return true; }
+  bool overflow()            { return false; }
+};
+
+#endif
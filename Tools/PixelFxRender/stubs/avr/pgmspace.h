@@ -0,0 +1,2 @@
+/* avr/pgmspace.h (host stub) */
+#include <Arduino.h>